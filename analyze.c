@@ -0,0 +1,353 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+#include "SDL_thread.h"
+#include "SDL_atomic.h"
+
+#include "types.h"
+#include "snake.h"
+#include "replay.h"
+#include "hist.h"
+#include "os.h"
+#include "wire.h"
+
+// scans a directory of replays on all cores and boils them down to a few statistics
+// every replay is mapped, not read, and replayed through the simulation since a replay only holds the inputs,
+// each thread counts into its own stats and heatmap which are only merged once everything is done
+
+
+// grids of every size are scaled onto one heatmap so replays from different grids can be summed up
+#define HEATMAP_SIZE 64
+#define MAX_THREADS 256
+
+enum death_cause {
+    // ran into its own body
+    DEATH_BODY,
+    // ran into the last tail piece, which is still there on the tick it would have moved away
+    DEATH_TAIL,
+    // turned straight back into its neck, only bots can do that
+    DEATH_NECK,
+    // the replay ended with the snake alive, game quit or cut off
+    DEATH_NONE,
+    N_DEATH_CAUSES
+};
+
+static const char *death_cause_names[N_DEATH_CAUSES] = {
+    "body", "tail", "neck", "alive at end"
+};
+
+struct stats {
+    // plain array of counters, merged with one straight loop the compiler vectorizes
+    u32 heatmap[HEATMAP_SIZE * HEATMAP_SIZE];
+
+    u64 games, unreadable, mismatched;
+    // games on a map are left out, nothing here has the map to play them on
+    u64 on_map;
+    u64 ticks, total_score;
+    u64 causes[N_DEATH_CAUSES];
+
+    struct hist scores;
+    struct hist survival;
+    struct hist ticks_to_food;
+};
+
+struct scan {
+    char **paths;
+    u32 n_paths;
+    SDL_atomic_t next_path;
+
+    struct stats *thread_stats[MAX_THREADS];
+};
+
+
+static u64 now_ns(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
+
+    return counter / freq * 1000000000 + counter % freq * 1000000000 / freq;
+}
+
+static enum death_cause classify_death(const struct snake *snake, struct vec2 dir) {
+    struct vec2 pos = move_in_bounded_direction(snake->head->pos, dir, snake->bound_x, snake->bound_y);
+
+    if (VEC2S_EQUAL(pos, snake->tail->pos))
+	return DEATH_TAIL;
+
+    for (const struct snake_piece *walk = snake->tail; walk->next; walk = walk->next)
+	if (walk->next == snake->head)
+	    return VEC2S_EQUAL(pos, walk->pos) ? DEATH_NECK : DEATH_BODY;
+
+    return DEATH_BODY;
+}
+
+static void analyze_replay(struct stats *stats, const struct replay *replay) {
+    struct snake snake;
+    replay_start(replay, &snake);
+
+    // 16.16 fixed point scale from grid cells to heatmap cells
+    u32 scale_x = ((u64) HEATMAP_SIZE << 16) / replay->bound_x;
+    u32 scale_y = ((u64) HEATMAP_SIZE << 16) / replay->bound_y;
+
+    enum death_cause cause = DEATH_NONE;
+    u32 last_food = 0;
+    u32 tick;
+
+    for (tick = 0; tick < replay->ticks; tick++) {
+	struct vec2 dir = replay_direction(replay, tick);
+	u32 score = snake.score;
+
+	snake.direction = dir;
+	move_snake(&snake);
+
+	if (snake.died) {
+	    cause = classify_death(&snake, dir);
+	    tick++;
+	    break;
+	}
+
+	u32 hx = (u64) snake.head->pos.x * scale_x >> 16;
+	u32 hy = (u64) snake.head->pos.y * scale_y >> 16;
+	stats->heatmap[hy * HEATMAP_SIZE + hx]++;
+
+	if (snake.score != score) {
+	    hist_add(&stats->ticks_to_food, tick + 1 - last_food);
+	    last_food = tick + 1;
+	}
+    }
+
+    if (tick != replay->ticks || snake.score != replay->score)
+	stats->mismatched++;
+
+    stats->games++;
+    stats->ticks += tick;
+    stats->total_score += snake.score;
+    stats->causes[cause]++;
+    hist_add(&stats->scores, snake.score);
+    hist_add(&stats->survival, tick);
+
+    free_snake(&snake);
+}
+
+static int scan_thread(void *data) {
+    struct scan *scan = data;
+
+    struct stats *stats = calloc(1, sizeof(*stats));
+    assert(stats);
+
+    while (true) {
+	u32 i = SDL_AtomicAdd(&scan->next_path, 1);
+	if (i >= scan->n_paths)
+	    break;
+
+	struct os_mapped_file map;
+	if (!os_map_file(scan->paths[i], &map)) {
+	    stats->unreadable++;
+	    continue;
+	}
+
+	struct replay replay;
+	if (!replay_parse(&replay, map.data, map.size))
+	    stats->unreadable++;
+	else if (replay.map_hash)
+	    stats->on_map++;
+	else
+	    analyze_replay(stats, &replay);
+
+	os_unmap_file(&map);
+    }
+
+    // the thread index is handed out by the order threads finish, stats only get summed so that is fine
+    static SDL_atomic_t finished;
+    scan->thread_stats[SDL_AtomicAdd(&finished, 1)] = stats;
+
+    return 0;
+}
+
+static void merge_stats(struct stats *dst, const struct stats *src) {
+    for (u32 i=0; i<HEATMAP_SIZE * HEATMAP_SIZE; i++)
+	dst->heatmap[i] += src->heatmap[i];
+
+    dst->games += src->games;
+    dst->unreadable += src->unreadable;
+    dst->mismatched += src->mismatched;
+    dst->on_map += src->on_map;
+    dst->ticks += src->ticks;
+    dst->total_score += src->total_score;
+
+    for (u32 i=0; i<N_DEATH_CAUSES; i++)
+	dst->causes[i] += src->causes[i];
+
+    hist_merge(&dst->scores, &src->scores);
+    hist_merge(&dst->survival, &src->survival);
+    hist_merge(&dst->ticks_to_food, &src->ticks_to_food);
+}
+
+static void print_percentiles(FILE *out, const char *name, const struct hist *hist) {
+    fprintf(out, "%-14s mean %.2f  p10 %llu  p50 %llu  p90 %llu  p99 %llu  max %llu\n", name, hist_mean(hist),
+	    (unsigned long long) hist_percentile(hist, 0.1),
+	    (unsigned long long) hist_percentile(hist, 0.5),
+	    (unsigned long long) hist_percentile(hist, 0.9),
+	    (unsigned long long) hist_percentile(hist, 0.99),
+	    (unsigned long long) hist->max);
+}
+
+static void print_summary(FILE *out, const struct stats *stats, u32 n_files, f64 seconds) {
+    fprintf(out, "%u files, %llu games, %llu unreadable, %llu not matching their recorded result, "
+	    "%llu played on a map\n",
+	    n_files, (unsigned long long) stats->games, (unsigned long long) stats->unreadable,
+	    (unsigned long long) stats->mismatched, (unsigned long long) stats->on_map);
+    fprintf(out, "%llu ticks replayed in %.2fs (%.0f games/s, %.0f ticks/s)\n",
+	    (unsigned long long) stats->ticks, seconds, stats->games / seconds, stats->ticks / seconds);
+
+    if (!stats->games)
+	return;
+
+    print_percentiles(out, "score", &stats->scores);
+    print_percentiles(out, "survival", &stats->survival);
+    print_percentiles(out, "ticks to food", &stats->ticks_to_food);
+
+    fprintf(out, "death causes:");
+    for (u32 i=0; i<N_DEATH_CAUSES; i++)
+	fprintf(out, "  %s %.1f%%", death_cause_names[i], 100.0 * stats->causes[i] / stats->games);
+    fprintf(out, "\n");
+}
+
+// raw counts for merging runs later plus a greyscale picture for looking at
+static bool write_heatmap(const struct stats *stats, const char *dir) {
+    char path[1024];
+
+    snprintf(path, sizeof(path), "%s/heatmap.bin", dir);
+    FILE *file = fopen(path, "wb");
+    if (!file)
+	return false;
+
+    u8 buf[4 * HEATMAP_SIZE * HEATMAP_SIZE];
+    for (u32 i=0; i<HEATMAP_SIZE * HEATMAP_SIZE; i++)
+	put_u32(buf + 4 * i, stats->heatmap[i]);
+
+    bool ok = fwrite(buf, 1, sizeof(buf), file) == sizeof(buf);
+    if (fclose(file) != 0 || !ok)
+	return false;
+
+    u32 max = 1;
+    for (u32 i=0; i<HEATMAP_SIZE * HEATMAP_SIZE; i++)
+	if (stats->heatmap[i] > max)
+	    max = stats->heatmap[i];
+
+    snprintf(path, sizeof(path), "%s/heatmap.pgm", dir);
+    file = fopen(path, "wb");
+    if (!file)
+	return false;
+
+    fprintf(file, "P5 %u %u 255\n", HEATMAP_SIZE, HEATMAP_SIZE);
+
+    // square root so the rarely visited cells do not all come out black
+    u8 pixels[HEATMAP_SIZE * HEATMAP_SIZE];
+    for (u32 i=0; i<HEATMAP_SIZE * HEATMAP_SIZE; i++)
+	pixels[i] = 255 * SDL_sqrt((f64) stats->heatmap[i] / max);
+
+    ok = fwrite(pixels, 1, sizeof(pixels), file) == sizeof(pixels);
+
+    return fclose(file) == 0 && ok;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s DIR [options]\n"
+	    "  --threads N    worker threads (default: cpu count)\n"
+	    "  --out DIR      write summary.txt, heatmap.bin and heatmap.pgm into DIR\n",
+	    prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2)
+	usage(argv[0]);
+
+    const char *dir = argv[1];
+    const char *out_dir = NULL;
+    u32 n_threads = SDL_GetCPUCount();
+
+    for (int i=2; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--threads") == 0)
+	    n_threads = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--out") == 0)
+	    out_dir = val;
+	else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    if (n_threads == 0)
+	n_threads = 1;
+    if (n_threads > MAX_THREADS)
+	n_threads = MAX_THREADS;
+
+    struct scan scan = {0};
+
+    scan.paths = os_list_dir(dir, ".snkr", &scan.n_paths);
+    if (!scan.paths) {
+	fprintf(stderr, "unable to read %s\n", dir);
+	return EXIT_FAILURE;
+    }
+
+    SDL_Thread *threads[MAX_THREADS];
+    u64 start = now_ns();
+
+    for (u32 i=0; i<n_threads; i++) {
+	threads[i] = SDL_CreateThread(scan_thread, "scan", &scan);
+	if (!threads[i]) {
+	    fprintf(stderr, "unable to create thread: %s\n", SDL_GetError());
+	    return EXIT_FAILURE;
+	}
+    }
+
+    for (u32 i=0; i<n_threads; i++)
+	SDL_WaitThread(threads[i], NULL);
+
+    struct stats *total = calloc(1, sizeof(*total));
+    assert(total);
+
+    for (u32 i=0; i<n_threads; i++) {
+	merge_stats(total, scan.thread_stats[i]);
+	free(scan.thread_stats[i]);
+    }
+
+    f64 seconds = (now_ns() - start) / 1e9;
+
+    print_summary(stdout, total, scan.n_paths, seconds);
+
+    if (out_dir) {
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/summary.txt", out_dir);
+
+	FILE *file = fopen(path, "w");
+	bool ok = file != NULL;
+	if (file) {
+	    print_summary(file, total, scan.n_paths, seconds);
+	    ok = fclose(file) == 0;
+	}
+
+	if (!ok || !write_heatmap(total, out_dir)) {
+	    fprintf(stderr, "unable to write the summary into %s\n", out_dir);
+	    return EXIT_FAILURE;
+	}
+    }
+
+    os_free_paths(scan.paths);
+    free(total);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+
+#include "types.h"
+#include "snake.h"
+#include "scripts.h"
+
+// a stress test of scripted opponents, see scripts.h
+//
+// thousands of agents, every one a game of its own and a script, all resumed one after the other each tick on
+// a single thread, a dead agent starts a new game right away so the arena stays full
+// agents of one kind sit next to each other, so the dispatch in script_resume goes the same way for long runs
+
+
+#define MAX_KINDS N_SCRIPT_KINDS
+
+struct kind_stats {
+    u32 agents;
+    u64 games, total_score, total_ticks;
+};
+
+struct arena {
+    u32 n_agents;
+    struct snake *snakes;
+    struct script *scripts;
+    // ticks the current game of every agent has lasted
+    u32 *ages;
+
+    u32 grid_x, grid_y;
+    u64 next_seed;
+
+    struct kind_stats stats[MAX_KINDS];
+};
+
+
+static u64 now_ns(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
+
+    return counter / freq * 1000000000 + counter % freq * 1000000000 / freq;
+}
+
+static void start_agent(struct arena *arena, u32 i, enum script_kind kind) {
+    init_snake(&arena->snakes[i], arena->grid_x, arena->grid_y, arena->next_seed++);
+    script_start(&arena->scripts[i], kind);
+    arena->ages[i] = 0;
+}
+
+static void run_tick(struct arena *arena) {
+    for (u32 i=0; i<arena->n_agents; i++) {
+	struct snake *snake = &arena->snakes[i];
+	struct script *script = &arena->scripts[i];
+
+	snake->direction = script_resume(script, snake);
+
+	// a script that clears the board finishes its game like a dead one
+	bool cleared = eats_last_free_cell(snake);
+	if (!cleared)
+	    move_snake(snake);
+	arena->ages[i]++;
+
+	if (snake->died || cleared) {
+	    struct kind_stats *stats = &arena->stats[script->kind];
+	    stats->games++;
+	    stats->total_score += snake->score;
+	    stats->total_ticks += arena->ages[i];
+
+	    enum script_kind kind = script->kind;
+	    free_snake(snake);
+	    start_agent(arena, i, kind);
+	}
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s [options]\n"
+	    "  --agents N        scripted agents in the arena (default 10000)\n"
+	    "  --ticks N         ticks to run (default 1000)\n"
+	    "  --grid WxH        grid of every agent's game (default 20x20)\n"
+	    "  --scripts A,B,... scripts to split the agents between (default: all of them)\n"
+	    "  --seed N          the first game is seeded with N, every new one with the next number (default 1)\n",
+	    prog);
+    fprintf(stderr, "scripts:");
+    for (u32 i=0; i<N_SCRIPT_KINDS; i++)
+	fprintf(stderr, " %s", script_names[i]);
+    fprintf(stderr, "\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    struct arena arena = {0};
+    arena.n_agents = 10000;
+    arena.grid_x = arena.grid_y = 20;
+    arena.next_seed = 1;
+    u32 ticks = 1000;
+
+    enum script_kind kinds[MAX_KINDS];
+    u32 n_kinds = 0;
+
+    for (int i=1; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--agents") == 0)
+	    arena.n_agents = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--ticks") == 0)
+	    ticks = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--seed") == 0)
+	    arena.next_seed = strtoull(val, NULL, 10);
+	else if (strcmp(arg, "--grid") == 0) {
+	    char *end;
+	    arena.grid_x = strtoul(val, &end, 10);
+	    if (*end != 'x')
+		usage(argv[0]);
+	    arena.grid_y = strtoul(end+1, NULL, 10);
+	} else if (strcmp(arg, "--scripts") == 0) {
+	    char names[256];
+	    snprintf(names, sizeof(names), "%s", val);
+
+	    for (char *name = strtok(names, ","); name; name = strtok(NULL, ",")) {
+		u32 k = 0;
+		while (k < N_SCRIPT_KINDS && strcmp(script_names[k], name) != 0)
+		    k++;
+
+		if (k == N_SCRIPT_KINDS || n_kinds == MAX_KINDS) {
+		    fprintf(stderr, "unknown script %s\n", name);
+		    usage(argv[0]);
+		}
+		kinds[n_kinds++] = k;
+	    }
+	} else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    if (n_kinds == 0)
+	for (u32 k=0; k<N_SCRIPT_KINDS; k++)
+	    kinds[n_kinds++] = k;
+
+    if (arena.n_agents == 0 || arena.grid_x < 4 || arena.grid_y < 4)
+	usage(argv[0]);
+
+    arena.snakes = calloc(arena.n_agents, sizeof(*arena.snakes));
+    arena.scripts = calloc(arena.n_agents, sizeof(*arena.scripts));
+    arena.ages = calloc(arena.n_agents, sizeof(*arena.ages));
+    assert(arena.snakes && arena.scripts && arena.ages);
+
+    // an even share of the agents for every kind, in one block each
+    for (u32 i=0; i<arena.n_agents; i++) {
+	enum script_kind kind = kinds[(u64) i * n_kinds / arena.n_agents];
+	start_agent(&arena, i, kind);
+	arena.stats[kind].agents++;
+    }
+
+    u64 start = now_ns();
+
+    for (u32 t=0; t<ticks; t++)
+	run_tick(&arena);
+
+    u64 elapsed = now_ns() - start;
+    u64 agent_ticks = (u64) arena.n_agents * ticks;
+
+    printf("%u agents on %ux%u for %u ticks: %llu agent ticks in %.1fms, %.1fns each, %.2fms per arena tick\n",
+	    arena.n_agents, arena.grid_x, arena.grid_y, ticks, (unsigned long long) agent_ticks, elapsed / 1e6,
+	    (f64) elapsed / agent_ticks, elapsed / 1e6 / ticks);
+    printf("a script is %u bytes on top of its game\n\n", (u32) sizeof(struct script));
+
+    // games still going count too, the calm scripts can outlive the whole run
+    u64 live_score[MAX_KINDS] = {0};
+    for (u32 i=0; i<arena.n_agents; i++)
+	live_score[arena.scripts[i].kind] += arena.snakes[i].score;
+
+    printf("%-10s %8s %10s %10s %12s %12s\n", "script", "agents", "games over", "avg score", "avg survival",
+	    "score alive");
+    for (u32 k=0; k<N_SCRIPT_KINDS; k++) {
+	const struct kind_stats *stats = &arena.stats[k];
+	if (stats->agents == 0)
+	    continue;
+
+	printf("%-10s %8u %10llu %10.2f %12.1f %12.2f\n", script_names[k], stats->agents,
+		(unsigned long long) stats->games,
+		stats->games ? (f64) stats->total_score / stats->games : 0.0,
+		stats->games ? (f64) stats->total_ticks / stats->games : 0.0,
+		(f64) live_score[k] / stats->agents);
+    }
+
+    for (u32 i=0; i<arena.n_agents; i++)
+	free_snake(&arena.snakes[i]);
+    free(arena.snakes);
+    free(arena.scripts);
+    free(arena.ages);
+
+    return EXIT_SUCCESS;
+}
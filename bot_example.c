@@ -0,0 +1,165 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+
+#include "types.h"
+#include "snake.h"
+#include "bots.h"
+#include "botproto.h"
+#include "net.h"
+
+// minimal external bot for bothost, decodes every state and answers with the greedy bot's move
+// also the reference for anyone writing a bot in another language, see botproto.h for the format
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+	fprintf(stderr, "usage: %s ADDRESS [NAME]\n", argv[0]);
+	return EXIT_FAILURE;
+    }
+
+    const char *name = argc > 2 ? argv[2] : "example";
+    u8 name_len = strlen(name) < BOT_MAX_NAME ? strlen(name) : BOT_MAX_NAME;
+
+    if (!net_init()) {
+	fprintf(stderr, "unable to initialize sockets\n");
+	return EXIT_FAILURE;
+    }
+
+    net_socket sock = net_connect(argv[1]);
+    if (sock == NET_INVALID_SOCKET) {
+	fprintf(stderr, "unable to connect to %s: %s\n", argv[1], net_error());
+	return EXIT_FAILURE;
+    }
+
+    u8 hello[BOT_HELLO_HEADER_SIZE + BOT_MAX_NAME];
+    put_u32(hello, BOT_MAGIC);
+    put_u16(hello + 4, BOT_VERSION);
+    hello[6] = name_len;
+    memcpy(hello + BOT_HELLO_HEADER_SIZE, name, name_len);
+
+    if (!net_send_all(sock, hello, BOT_HELLO_HEADER_SIZE + name_len, -1)) {
+	fprintf(stderr, "unable to send hello: %s\n", net_error());
+	return EXIT_FAILURE;
+    }
+
+    u32 cap = 1 << 16;
+    u8 *buf = malloc(cap);
+    assert(buf);
+    u32 len = 0;
+
+    u32 bound_x = 0, bound_y = 0;
+    u32 games = 0;
+
+    while (true) {
+	// consume every complete message in the buffer before reading more
+	u32 used = 0;
+	bool closed = false;
+
+	while (true) {
+	    u8 *msg = buf + used;
+	    u32 avail = len - used;
+
+	    if (bound_x == 0) {
+		if (avail < BOT_WELCOME_SIZE)
+		    break;
+
+		if (get_u32(msg) != BOT_MAGIC || get_u16(msg + 4) != BOT_VERSION) {
+		    fprintf(stderr, "bad welcome\n");
+		    return EXIT_FAILURE;
+		}
+
+		bound_x = get_u16(msg + 6);
+		bound_y = get_u16(msg + 8);
+		printf("playing %ux%u with a %uus move budget\n", bound_x, bound_y, get_u32(msg + 10));
+
+		used += BOT_WELCOME_SIZE;
+		continue;
+	    }
+
+	    if (avail < 1)
+		break;
+
+	    if (msg[0] == BOT_MSG_GAME_OVER) {
+		if (avail < BOT_GAME_OVER_SIZE)
+		    break;
+
+		printf("game %u over, score %u\n", ++games, get_u32(msg + 8));
+		used += BOT_GAME_OVER_SIZE;
+		continue;
+	    }
+
+	    if (msg[0] != BOT_MSG_STATE) {
+		fprintf(stderr, "unknown message %u\n", msg[0]);
+		return EXIT_FAILURE;
+	    }
+
+	    if (avail < BOT_STATE_HEADER_SIZE)
+		break;
+
+	    // the length sizes the wait for the rest of the state, so it is checked before anything else
+	    u32 length = get_u32(msg + 16);
+	    if (length == 0 || length > bot_max_length(bound_x, bound_y)) {
+		fprintf(stderr, "bad state\n");
+		return EXIT_FAILURE;
+	    }
+
+	    if (avail < bot_state_size(length))
+		break;
+
+	    struct snake snake;
+	    u32 tick;
+	    if (!decode_bot_state(msg, avail, bound_x, bound_y, &snake, &tick)) {
+		fprintf(stderr, "bad state\n");
+		return EXIT_FAILURE;
+	    }
+
+	    u8 move[BOT_MOVE_SIZE];
+	    put_u32(move, tick);
+	    move[4] = direction_index(bot_greedy(&snake));
+
+	    used += bot_state_size(snake.length);
+	    free_snake(&snake);
+
+	    if (!net_send_all(sock, move, sizeof(move), -1)) {
+		closed = true;
+		break;
+	    }
+	}
+
+	memmove(buf, buf + used, len - used);
+	len -= used;
+
+	if (closed)
+	    break;
+
+	// a state can be bigger than what is left, grow until it fits
+	if (len == cap) {
+	    cap *= 2;
+	    buf = realloc(buf, cap);
+	    assert(buf);
+	}
+
+	s32 n = net_recv(sock, buf + len, cap - len);
+	if (n == NET_WOULD_BLOCK) {
+	    bool ready;
+	    net_poll_readable(&sock, 1, &ready, -1);
+	    continue;
+	}
+	if (n <= 0)
+	    break;
+
+	len += n;
+    }
+
+    printf("host closed the connection after %u games\n", games);
+
+    net_close(sock);
+    free(buf);
+
+    return EXIT_SUCCESS;
+}
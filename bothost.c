@@ -0,0 +1,438 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+
+#include "types.h"
+#include "snake.h"
+#include "botproto.h"
+#include "hist.h"
+#include "net.h"
+
+// hosts external bot processes, every bot plays its own game and all games advance in lockstep
+// a bot gets the state each tick and has move_budget_us to answer, otherwise it keeps its last direction
+// nothing here ever blocks on a single bot: sockets are non-blocking and waiting is a poll bounded by the deadline
+
+
+#define MAX_BOTS 256
+
+struct bot {
+    net_socket sock;
+    char name[BOT_MAX_NAME + 1];
+    bool connected;
+
+    struct snake snake;
+    u64 next_seed;
+    u32 games;
+    u64 total_score;
+    u32 best_score;
+
+    // tick of the state we are waiting on an answer for
+    u32 tick;
+    bool answered;
+    u64 sent_at;
+
+    // partial move messages survive between polls
+    u8 recv_buf[64];
+    u32 recv_len;
+
+    struct hist response_us;
+    u64 moves, timeouts, stale, invalid;
+};
+
+struct host {
+    u32 n_bots;
+    struct bot bots[MAX_BOTS];
+
+    u32 bound_x, bound_y;
+    u64 budget_us;
+    u32 games_per_bot;
+};
+
+
+static u64 now_us(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
+
+    return counter / freq * 1000000 + counter % freq * 1000000 / freq;
+}
+
+static void disconnect(struct bot *bot, const char *why) {
+    if (!bot->connected)
+	return;
+
+    fprintf(stderr, "bot %s disconnected: %s\n", bot->name, why);
+
+    net_close(bot->sock);
+    bot->connected = false;
+}
+
+// reads exactly len bytes, giving up after timeout_ms, only used while bots are joining
+static bool recv_exact(net_socket sock, u8 *buf, u32 len, u32 timeout_ms) {
+    u64 deadline = now_us() + (u64) timeout_ms * 1000;
+
+    while (len > 0) {
+	s32 n = net_recv(sock, buf, len);
+
+	if (n > 0) {
+	    buf += n;
+	    len -= n;
+	    continue;
+	}
+	if (n != NET_WOULD_BLOCK)
+	    return false;
+
+	u64 now = now_us();
+	if (now >= deadline)
+	    return false;
+
+	bool ready;
+	if (net_poll_readable(&sock, 1, &ready, (deadline - now + 999) / 1000) < 0)
+	    return false;
+    }
+
+    return true;
+}
+
+static bool accept_bot(struct host *host, net_socket listener, struct bot *bot) {
+    net_socket sock;
+
+    while ((sock = net_accept(listener)) == NET_INVALID_SOCKET) {
+	bool ready;
+	if (net_poll_readable(&listener, 1, &ready, -1) < 0)
+	    return false;
+    }
+
+    u8 hello[BOT_HELLO_HEADER_SIZE + BOT_MAX_NAME];
+
+    if (!recv_exact(sock, hello, BOT_HELLO_HEADER_SIZE, 5000) ||
+	    get_u32(hello) != BOT_MAGIC || get_u16(hello + 4) != BOT_VERSION || hello[6] > BOT_MAX_NAME ||
+	    !recv_exact(sock, hello + BOT_HELLO_HEADER_SIZE, hello[6], 5000)) {
+	fprintf(stderr, "rejected a connection with a bad hello\n");
+	net_close(sock);
+	return false;
+    }
+
+    memset(bot, 0, sizeof(*bot));
+    bot->sock = sock;
+    bot->connected = true;
+    memcpy(bot->name, hello + BOT_HELLO_HEADER_SIZE, hello[6]);
+    bot->name[hello[6]] = 0;
+
+    u8 welcome[BOT_WELCOME_SIZE];
+    put_u32(welcome, BOT_MAGIC);
+    put_u16(welcome + 4, BOT_VERSION);
+    put_u16(welcome + 6, host->bound_x);
+    put_u16(welcome + 8, host->bound_y);
+    put_u32(welcome + 10, host->budget_us);
+
+    if (!net_send_all(sock, welcome, sizeof(welcome), 1000)) {
+	disconnect(bot, "unable to send welcome");
+	return false;
+    }
+
+    printf("bot %s joined\n", bot->name);
+
+    return true;
+}
+
+static void send_state(struct host *host, struct bot *bot, u32 tick, u8 *buf) {
+    u32 size = encode_bot_state(&bot->snake, tick, buf);
+
+    bot->tick = tick;
+    bot->answered = false;
+    bot->sent_at = now_us();
+
+    // a bot that does not even drain its socket within the budget is as good as gone
+    if (!net_send_all(bot->sock, buf, size, host->budget_us / 1000 + 1))
+	disconnect(bot, "send failed");
+}
+
+static void handle_move(struct bot *bot, const u8 *msg, u64 now, u64 budget_us) {
+    u32 tick = get_u32(msg);
+    u8 dir = msg[4];
+
+    if (tick != bot->tick || bot->answered) {
+	bot->stale++;
+	return;
+    }
+
+    u64 elapsed = now - bot->sent_at;
+
+    bot->answered = true;
+    bot->moves++;
+    hist_add(&bot->response_us, elapsed);
+
+    // the poll wakeup can be late, so an answer is only good if it made it within the budget
+    if (elapsed > budget_us) {
+	bot->timeouts++;
+	return;
+    }
+
+    // same rule as the keyboard, no turning back into yourself
+    struct vec2 new_dir = directions[dir & 3];
+    if (dir > 3 || (new_dir.x == -bot->snake.direction.x && new_dir.y == -bot->snake.direction.y)) {
+	bot->invalid++;
+	return;
+    }
+
+    bot->snake.direction = new_dir;
+}
+
+static void read_moves(struct bot *bot, u64 budget_us) {
+    while (bot->connected) {
+	s32 n = net_recv(bot->sock, bot->recv_buf + bot->recv_len, sizeof(bot->recv_buf) - bot->recv_len);
+
+	if (n == NET_WOULD_BLOCK)
+	    break;
+	if (n <= 0) {
+	    disconnect(bot, n == NET_CLOSED ? "closed" : net_error());
+	    break;
+	}
+
+	bot->recv_len += n;
+
+	u64 now = now_us();
+	u32 used = 0;
+	while (bot->recv_len - used >= BOT_MOVE_SIZE) {
+	    handle_move(bot, bot->recv_buf + used, now, budget_us);
+	    used += BOT_MOVE_SIZE;
+	}
+
+	memmove(bot->recv_buf, bot->recv_buf + used, bot->recv_len - used);
+	bot->recv_len -= used;
+    }
+}
+
+// waits for every connected bot to answer or for the deadline, whichever comes first
+static void collect_moves(struct host *host, u64 deadline) {
+    net_socket socks[MAX_BOTS];
+    struct bot *waiting[MAX_BOTS];
+    bool ready[MAX_BOTS];
+
+    while (true) {
+	u32 n = 0;
+	for (u32 i=0; i<host->n_bots; i++) {
+	    struct bot *bot = &host->bots[i];
+
+	    if (bot->connected && !bot->answered && !bot->snake.died) {
+		socks[n] = bot->sock;
+		waiting[n] = bot;
+		n++;
+	    }
+	}
+
+	u64 now = now_us();
+	if (n == 0 || now >= deadline)
+	    break;
+
+	// poll only has ms resolution, answers are still timed against the exact deadline below
+	s32 timeout_ms = (deadline - now + 999) / 1000;
+	if (net_poll_readable(socks, n, ready, timeout_ms) < 0) {
+	    fprintf(stderr, "poll: %s\n", net_error());
+	    break;
+	}
+
+	for (u32 i=0; i<n; i++)
+	    if (ready[i])
+		read_moves(waiting[i], host->budget_us);
+    }
+
+    for (u32 i=0; i<host->n_bots; i++) {
+	struct bot *bot = &host->bots[i];
+
+	if (!bot->connected || bot->snake.died)
+	    continue;
+
+	if (!bot->answered)
+	    bot->timeouts++;
+    }
+}
+
+static void print_report(const struct host *host, u32 ticks, f64 seconds) {
+    printf("%u ticks in %.2fs (%.0f ticks/s), move budget %lluus\n",
+	    ticks, seconds, ticks / seconds, (unsigned long long) host->budget_us);
+
+    printf("%-16s %6s %9s %6s %9s %8s %6s %8s %8s %8s %8s\n",
+	    "bot", "games", "avg score", "best", "moves", "timeouts", "stale", "p50 us", "p90 us", "p99 us", "max us");
+
+    for (u32 i=0; i<host->n_bots; i++) {
+	const struct bot *bot = &host->bots[i];
+
+	printf("%-16s %6u %9.2f %6u %9llu %8llu %6llu %8llu %8llu %8llu %8llu\n",
+		bot->name, bot->games, bot->games ? (f64) bot->total_score / bot->games : 0.0, bot->best_score,
+		(unsigned long long) bot->moves, (unsigned long long) bot->timeouts, (unsigned long long) bot->stale,
+		(unsigned long long) hist_percentile(&bot->response_us, 0.5),
+		(unsigned long long) hist_percentile(&bot->response_us, 0.9),
+		(unsigned long long) hist_percentile(&bot->response_us, 0.99),
+		(unsigned long long) bot->response_us.max);
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s [options]\n"
+	    "  --listen ADDR    tcp:PORT, tcp:HOST:PORT or unix:PATH (default tcp:5555)\n"
+	    "  --bots N         bots to wait for before starting (default 1)\n"
+	    "  --games N        games every bot plays (default 10)\n"
+	    "  --budget-us N    time a bot has to answer a state (default 5000)\n"
+	    "  --tick-ms N      minimum tick period, 0 runs as fast as the bots answer (default 0)\n"
+	    "  --grid WxH       grid size (default 20x20)\n"
+	    "  --seed N         base seed (default: time)\n",
+	    prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    const char *address = "tcp:5555";
+    u32 tick_ms = 0;
+    u64 seed = time(NULL);
+
+    struct host *host = calloc(1, sizeof(*host));
+    assert(host);
+
+    host->n_bots = 1;
+    host->games_per_bot = 10;
+    host->budget_us = 5000;
+    host->bound_x = GRID_WIDTH;
+    host->bound_y = GRID_HEIGHT;
+
+    for (int i=1; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--listen") == 0)
+	    address = val;
+	else if (strcmp(arg, "--bots") == 0)
+	    host->n_bots = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--games") == 0)
+	    host->games_per_bot = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--budget-us") == 0)
+	    host->budget_us = strtoull(val, NULL, 10);
+	else if (strcmp(arg, "--tick-ms") == 0)
+	    tick_ms = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--seed") == 0)
+	    seed = strtoull(val, NULL, 10);
+	else if (strcmp(arg, "--grid") == 0) {
+	    if (sscanf(val, "%ux%u", &host->bound_x, &host->bound_y) != 2)
+		usage(argv[0]);
+	} else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    if (host->n_bots == 0 || host->n_bots > MAX_BOTS || host->games_per_bot == 0 || host->budget_us == 0 ||
+	    host->bound_x == 0 || host->bound_y == 0 || host->bound_x > 0xFFFF || host->bound_y > 0xFFFF)
+	usage(argv[0]);
+
+    if (!net_init()) {
+	fprintf(stderr, "unable to initialize sockets\n");
+	return EXIT_FAILURE;
+    }
+
+    net_socket listener = net_listen(address);
+    if (listener == NET_INVALID_SOCKET) {
+	fprintf(stderr, "unable to listen on %s: %s\n", address, net_error());
+	return EXIT_FAILURE;
+    }
+
+    printf("waiting for %u bot%s on %s\n", host->n_bots, host->n_bots == 1 ? "" : "s", address);
+
+    for (u32 i=0; i<host->n_bots; ) {
+	if (accept_bot(host, listener, &host->bots[i]))
+	    i++;
+    }
+
+    // every bot gets the same sequence of seeds so their scores are comparable
+    for (u32 i=0; i<host->n_bots; i++) {
+	struct bot *bot = &host->bots[i];
+	bot->next_seed = seed;
+	init_snake(&bot->snake, host->bound_x, host->bound_y, bot->next_seed++);
+    }
+
+    u8 *buf = malloc(bot_state_size(bot_max_length(host->bound_x, host->bound_y)));
+    assert(buf);
+
+    u64 start = now_us();
+    u32 tick = 0;
+
+    while (true) {
+	u64 tick_start = now_us();
+
+	bool any_playing = false;
+	for (u32 i=0; i<host->n_bots; i++) {
+	    struct bot *bot = &host->bots[i];
+
+	    if (bot->connected && !bot->snake.died) {
+		send_state(host, bot, tick, buf);
+		any_playing = true;
+	    }
+	}
+
+	if (!any_playing)
+	    break;
+
+	collect_moves(host, tick_start + host->budget_us);
+
+	for (u32 i=0; i<host->n_bots; i++) {
+	    struct bot *bot = &host->bots[i];
+
+	    if (!bot->connected || bot->snake.died)
+		continue;
+
+	    // a cleared board ends the game like dying does, the move itself would never return
+	    if (eats_last_free_cell(&bot->snake))
+		bot->snake.died = true;
+	    else
+		move_snake(&bot->snake);
+
+	    if (!bot->snake.died)
+		continue;
+
+	    bot->games++;
+	    bot->total_score += bot->snake.score;
+	    if (bot->snake.score > bot->best_score)
+		bot->best_score = bot->snake.score;
+
+	    u32 size = encode_bot_game_over(tick, bot->snake.score, buf);
+	    if (!net_send_all(bot->sock, buf, size, host->budget_us / 1000 + 1))
+		disconnect(bot, "send failed");
+
+	    if (bot->games < host->games_per_bot) {
+		free_snake(&bot->snake);
+		init_snake(&bot->snake, host->bound_x, host->bound_y, bot->next_seed++);
+	    }
+	}
+
+	tick++;
+
+	if (tick_ms) {
+	    u64 elapsed = now_us() - tick_start;
+	    if (elapsed < (u64) tick_ms * 1000)
+		SDL_Delay(((u64) tick_ms * 1000 - elapsed) / 1000);
+	}
+    }
+
+    print_report(host, tick, (now_us() - start) / 1e6);
+
+    for (u32 i=0; i<host->n_bots; i++) {
+	if (host->bots[i].connected)
+	    net_close(host->bots[i].sock);
+	free_snake(&host->bots[i].snake);
+    }
+
+    net_close(listener);
+    free(buf);
+    free(host);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "botproto.h"
+
+
+u32 bot_state_size(u32 length) {
+    assert(length > 0);
+
+    return BOT_STATE_HEADER_SIZE + (length - 1 + 3) / 4;
+}
+
+u32 bot_max_length(u32 bound_x, u32 bound_y) {
+    u64 n_cells = (u64) bound_x * bound_y;
+
+    if (n_cells < INITIAL_SNAKE_LEN)
+	return INITIAL_SNAKE_LEN;
+
+    // a length past this would overflow bot_state_size
+    return n_cells < UINT32_MAX - 3 ? n_cells : UINT32_MAX - 3;
+}
+
+// direction of the step from a to its neighbour b, accounting for the wrap around
+static u32 step_index(struct vec2 a, struct vec2 b) {
+    if (b.x == a.x)
+	return (b.y == a.y + 1 || (b.y == 0 && a.y != 1)) ? 1 : 0;
+
+    return (b.x == a.x + 1 || (b.x == 0 && a.x != 1)) ? 3 : 2;
+}
+
+u32 encode_bot_state(const struct snake *snake, u32 tick, u8 *buf) {
+    assert(snake);
+    assert(buf);
+
+    buf[0] = BOT_MSG_STATE;
+    buf[1] = direction_index(snake->direction);
+    put_u16(buf + 2, snake->food_pos.x);
+    put_u16(buf + 4, snake->food_pos.y);
+    put_u16(buf + 6, snake->tail->pos.x);
+    put_u16(buf + 8, snake->tail->pos.y);
+    put_u16(buf + 10, 0);
+    put_u32(buf + 12, tick);
+    put_u32(buf + 16, snake->length);
+
+    u32 size = bot_state_size(snake->length);
+    u8 *steps = buf + BOT_STATE_HEADER_SIZE;
+    memset(steps, 0, size - BOT_STATE_HEADER_SIZE);
+
+    u32 i = 0;
+    for (const struct snake_piece *walk = snake->tail; walk->next; walk = walk->next, i++)
+	steps[i / 4] |= step_index(walk->pos, walk->next->pos) << (i % 4 * 2);
+
+    return size;
+}
+
+u32 encode_bot_game_over(u32 tick, u32 score, u8 *buf) {
+    assert(buf);
+
+    buf[0] = BOT_MSG_GAME_OVER;
+    buf[1] = 0;
+    put_u16(buf + 2, 0);
+    put_u32(buf + 4, tick);
+    put_u32(buf + 8, score);
+
+    return BOT_GAME_OVER_SIZE;
+}
+
+bool decode_bot_state(const u8 *buf, u32 len, u32 bound_x, u32 bound_y, struct snake *snake, u32 *tick) {
+    assert(buf);
+    assert(snake);
+
+    if (len < BOT_STATE_HEADER_SIZE || buf[0] != BOT_MSG_STATE || buf[1] > 3)
+	return false;
+
+    u32 length = get_u32(buf + 16);
+    if (length == 0 || length > bot_max_length(bound_x, bound_y) || len < bot_state_size(length))
+	return false;
+
+    memset(snake, 0, sizeof(*snake));
+
+    snake->bound_x = bound_x;
+    snake->bound_y = bound_y;
+    snake->direction = directions[buf[1]];
+    snake->food_pos.x = get_u16(buf + 2);
+    snake->food_pos.y = get_u16(buf + 4);
+    *tick = get_u32(buf + 12);
+
+    struct vec2 pos = { .x = get_u16(buf + 6), .y = get_u16(buf + 8) };
+
+    // the cells end up in the occupancy bitmap, so they have to be on the grid
+    if (pos.x >= bound_x || pos.y >= bound_y || snake->food_pos.x >= bound_x || snake->food_pos.y >= bound_y)
+	return false;
+
+    const u8 *steps = buf + BOT_STATE_HEADER_SIZE;
+
+    for (u32 i=0; i<length; i++) {
+	struct snake_piece *piece = malloc(sizeof(*piece));
+	assert(piece);
+
+	if (i > 0)
+	    pos = move_in_bounded_direction(pos, directions[(steps[(i-1) / 4] >> ((i-1) % 4 * 2)) & 3], bound_x, bound_y);
+
+	piece->pos = pos;
+	piece->next = NULL;
+	piece->prev = snake->head;
+
+	if (snake->head)
+	    snake->head->next = piece;
+	else
+	    snake->tail = piece;
+	snake->head = piece;
+    }
+
+    snake->length = length;
+    init_occupancy(snake);
+
+    return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "snake.h"
+#include "wire.h"
+
+// wire format between bothost and external bot processes, every integer is little endian
+//
+// bot -> host once after connecting
+//   hello:     u32 magic, u16 version, u8 name_len, name_len bytes of name
+// host -> bot once the game is about to start
+//   welcome:   u32 magic, u16 version, u16 bound_x, u16 bound_y, u32 move_budget_us
+// host -> bot every tick
+//   state:     u8 type, u8 direction, u16 food_x, u16 food_y, u16 tail_x, u16 tail_y, u16 0, u32 tick, u32 length
+//              followed by length-1 two bit steps (direction_index) walking from the tail to the head,
+//              four to a byte starting at the low bits
+//   game over: u8 type, u8 0, u16 0, u32 tick, u32 score
+// bot -> host answering a state
+//   move:      u32 tick, u8 direction
+//
+// a move for any tick other than the last state sent is stale and gets dropped
+
+#define BOT_MAGIC 0x424B4E53
+#define BOT_VERSION 1
+
+#define BOT_MSG_STATE 1
+#define BOT_MSG_GAME_OVER 2
+
+#define BOT_HELLO_HEADER_SIZE 7
+#define BOT_WELCOME_SIZE 14
+#define BOT_STATE_HEADER_SIZE 20
+#define BOT_GAME_OVER_SIZE 12
+#define BOT_MOVE_SIZE 5
+
+#define BOT_MAX_NAME 31
+
+
+// bytes a state message for a snake of this length takes
+u32 bot_state_size(u32 length);
+
+// the longest snake a state can hold on the grid, the starting body is stacked on grids with fewer cells than it
+// has pieces
+u32 bot_max_length(u32 bound_x, u32 bound_y);
+
+// buf must hold bot_state_size(snake->length) bytes, returns the bytes written
+u32 encode_bot_state(const struct snake *snake, u32 tick, u8 *buf);
+
+u32 encode_bot_game_over(u32 tick, u32 score, u8 *buf);
+
+// rebuilds snake from a complete state message, snake must not hold any pieces
+// returns false if the message is malformed
+bool decode_bot_state(const u8 *buf, u32 len, u32 bound_x, u32 bound_y, struct snake *snake, u32 *tick);
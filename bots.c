@@ -0,0 +1,281 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bots.h"
+#include "pattern.h"
+
+
+const struct bot_info builtin_bots[] = {
+    { "greedy", bot_greedy },
+    { "random", bot_random },
+    { "lookahead", bot_lookahead },
+    { "pattern", bot_pattern },
+};
+
+const u32 n_builtin_bots = sizeof(builtin_bots) / sizeof(builtin_bots[0]);
+
+const struct bot_info *find_bot(const char *name) {
+    assert(name);
+
+    for (u32 i=0; i<n_builtin_bots; i++)
+	if (strcmp(builtin_bots[i].name, name) == 0)
+	    return &builtin_bots[i];
+
+    return NULL;
+}
+
+
+static bool is_reverse(const struct snake *snake, struct vec2 dir) {
+    return dir.x == -snake->direction.x && dir.y == -snake->direction.y;
+}
+
+// distance from a to b along one axis of the torus, or of the plain grid when it has walls
+static u32 wrapped_distance(s32 a, s32 b, u32 bound, bool walls) {
+    u32 d = abs(a - b);
+
+    return walls || d < bound - d ? d : bound - d;
+}
+
+static u32 food_distance(const struct snake *snake, struct vec2 pos) {
+    return wrapped_distance(pos.x, snake->food_pos.x, snake->bound_x, snake->walls) +
+	wrapped_distance(pos.y, snake->food_pos.y, snake->bound_y, snake->walls);
+}
+
+struct vec2 bot_greedy(const struct snake *snake) {
+    assert(snake);
+
+    struct vec2 best = snake->direction;
+    u32 best_score = ~0u;
+
+    for (u32 i=0; i<4; i++) {
+	struct vec2 dir = directions[i];
+
+	// turning around is never allowed
+	if (is_reverse(snake, dir))
+	    continue;
+
+	struct vec2 pos;
+	if (!next_head_pos(snake, dir, &pos))
+	    continue;
+
+	u32 score = food_distance(snake, pos);
+
+	// a move into the body is only taken when every move is
+	if (cell_occupied(snake, pos))
+	    score += snake->bound_x + snake->bound_y;
+
+	if (score < best_score) {
+	    best_score = score;
+	    best = dir;
+	}
+    }
+
+    return best;
+}
+
+struct vec2 bot_random(const struct snake *snake) {
+    assert(snake);
+
+    struct vec2 safe[3];
+    u32 n_safe = 0;
+
+    for (u32 i=0; i<4; i++) {
+	struct vec2 dir = directions[i];
+
+	if (is_reverse(snake, dir))
+	    continue;
+
+	struct vec2 pos;
+	if (next_head_pos(snake, dir, &pos) && !cell_occupied(snake, pos))
+	    safe[n_safe++] = dir;
+    }
+
+    if (n_safe == 0)
+	return snake->direction;
+
+    // the game's generator is not ours to touch, so the state itself is the randomness
+    u32 h = snake->head->pos.x * 73856093u ^ snake->head->pos.y * 19349663u ^ snake->length * 83492791u ^
+	snake->food_pos.x * 2654435761u ^ snake->food_pos.y;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+
+    return safe[h % n_safe];
+}
+
+
+// flood fill in a window around the head, big enough to tell a pocket from open space without touching the whole grid
+#define LOOKAHEAD_WINDOW 32
+#define LOOKAHEAD_LIMIT 128
+
+struct window {
+    struct vec2 origin;
+    u32 w, h;
+    u32 bits[LOOKAHEAD_WINDOW];
+};
+
+static bool window_local(const struct window *win, const struct snake *snake, struct vec2 pos, u32 *x, u32 *y) {
+    u32 dx = (pos.x - win->origin.x + snake->bound_x) % snake->bound_x;
+    u32 dy = (pos.y - win->origin.y + snake->bound_y) % snake->bound_y;
+
+    if (dx >= win->w || dy >= win->h)
+	return false;
+
+    *x = dx;
+    *y = dy;
+    return true;
+}
+
+// the cell one step from pos in dir, false if that is off the grid and the grid has walls, like next_head_pos
+static bool step_from(const struct snake *snake, struct vec2 pos, struct vec2 dir, struct vec2 *next) {
+    if (!snake->walls) {
+	*next = move_in_bounded_direction(pos, dir, snake->bound_x, snake->bound_y);
+	return true;
+    }
+
+    next->x = pos.x + dir.x;
+    next->y = pos.y + dir.y;
+
+    return (u32) next->x < snake->bound_x && (u32) next->y < snake->bound_y;
+}
+
+// number of free cells reachable from start, stops counting at LOOKAHEAD_LIMIT
+// the window is filled from the occupancy bitmap, so obstacles block the fill the same as the body does
+static u32 reachable(const struct snake *snake, struct vec2 start) {
+    struct window win;
+    memset(&win, 0, sizeof(win));
+
+    win.w = snake->bound_x < LOOKAHEAD_WINDOW ? snake->bound_x : LOOKAHEAD_WINDOW;
+    win.h = snake->bound_y < LOOKAHEAD_WINDOW ? snake->bound_y : LOOKAHEAD_WINDOW;
+
+    s32 origin_x = start.x - (s32) win.w / 2;
+    s32 origin_y = start.y - (s32) win.h / 2;
+
+    // a grid with walls does not wrap, so neither does the window
+    if (snake->walls) {
+	if (origin_x < 0)
+	    origin_x = 0;
+	if (origin_x > (s32) (snake->bound_x - win.w))
+	    origin_x = snake->bound_x - win.w;
+	if (origin_y < 0)
+	    origin_y = 0;
+	if (origin_y > (s32) (snake->bound_y - win.h))
+	    origin_y = snake->bound_y - win.h;
+    }
+
+    win.origin.x = (origin_x + (s32) snake->bound_x) % snake->bound_x;
+    win.origin.y = (origin_y + (s32) snake->bound_y) % snake->bound_y;
+
+    for (u32 y=0; y<win.h; y++) {
+	for (u32 x=0; x<win.w; x++) {
+	    struct vec2 pos = { (win.origin.x + x) % snake->bound_x, (win.origin.y + y) % snake->bound_y };
+	    if (cell_occupied(snake, pos))
+		win.bits[y] |= 1u << x;
+	}
+    }
+
+    struct vec2 stack[LOOKAHEAD_WINDOW * LOOKAHEAD_WINDOW];
+    u32 top = 0, count = 0;
+
+    u32 x = 0, y = 0;
+    window_local(&win, snake, start, &x, &y);
+    if (win.bits[y] & (1u << x))
+	return 0;
+
+    win.bits[y] |= 1u << x;
+    stack[top++] = start;
+
+    while (top > 0 && count < LOOKAHEAD_LIMIT) {
+	struct vec2 pos = stack[--top];
+	count++;
+
+	for (u32 i=0; i<4; i++) {
+	    struct vec2 next;
+
+	    // there is nothing past a wall to count
+	    if (!step_from(snake, pos, directions[i], &next))
+		continue;
+
+	    // leaving the window into a free cell counts as open space, the fill just does not follow it
+	    if (!window_local(&win, snake, next, &x, &y)) {
+		if (!cell_occupied(snake, next))
+		    count++;
+		continue;
+	    }
+
+	    if (win.bits[y] & (1u << x))
+		continue;
+
+	    win.bits[y] |= 1u << x;
+	    stack[top++] = next;
+	}
+    }
+
+    return count;
+}
+
+struct vec2 bot_lookahead(const struct snake *snake) {
+    assert(snake);
+
+    struct vec2 best = snake->direction;
+    u32 best_room = 0;
+    u32 best_distance = ~0u;
+
+    // enough room means the snake could fit its whole body, capped by what the fill can count
+    u32 enough = snake->length < LOOKAHEAD_LIMIT ? snake->length : LOOKAHEAD_LIMIT;
+
+    for (u32 i=0; i<4; i++) {
+	struct vec2 dir = directions[i];
+
+	if (is_reverse(snake, dir))
+	    continue;
+
+	struct vec2 pos;
+	if (!next_head_pos(snake, dir, &pos))
+	    continue;
+
+	u32 room = cell_occupied(snake, pos) ? 0 : reachable(snake, pos);
+	if (room > enough)
+	    room = enough;
+
+	u32 distance = food_distance(snake, pos);
+
+	if (room > best_room || (room == best_room && room > 0 && distance < best_distance)) {
+	    best = dir;
+	    best_room = room;
+	    best_distance = distance;
+	}
+    }
+
+    return best;
+}
+
+
+struct vec2 bot_pattern(const struct snake *snake) {
+    assert(snake);
+
+    u8 entry = pattern_lookup(pattern_key(snake));
+
+    struct vec2 best = snake->direction;
+    u32 best_score = ~0u;
+
+    for (u32 move=MOVE_LEFT; move<=MOVE_RIGHT; move++) {
+	struct vec2 dir = relative_direction(snake->direction, move);
+
+	struct vec2 pos;
+	if (!next_head_pos(snake, dir, &pos))
+	    continue;
+
+	// a better class always wins, the food only decides between moves of the same class
+	u32 class = pattern_move_class(entry, move);
+	u32 score = (PATTERN_OPEN - class) * (snake->bound_x + snake->bound_y + 1) + food_distance(snake, pos);
+
+	if (score < best_score) {
+	    best_score = score;
+	    best = dir;
+	}
+    }
+
+    return best;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "snake.h"
+
+// a bot picks the next direction for the snake without moving it
+// bots are pure functions of the snake so a game is reproducible from its seed and can run on any thread
+typedef struct vec2 (*bot_fn)(const struct snake *snake);
+
+struct bot_info {
+    const char *name;
+    bot_fn decide;
+};
+
+// heads for the food along the shortest wrapped distance, never into its own body if it can help it
+struct vec2 bot_greedy(const struct snake *snake);
+
+// any move that does not kill it right away, picked by hashing the state
+struct vec2 bot_random(const struct snake *snake);
+
+// like greedy, but first rules out moves into pockets smaller than the snake can fit in
+struct vec2 bot_lookahead(const struct snake *snake);
+
+// looks up what the cells around the head say about each move, then heads for the food among the best ones
+struct vec2 bot_pattern(const struct snake *snake);
+
+extern const struct bot_info builtin_bots[];
+extern const u32 n_builtin_bots;
+
+// NULL if there is no bot with that name
+const struct bot_info *find_bot(const char *name);
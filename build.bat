@@ -1 +1,15 @@
-gcc -Wall -Werror main.c -o main -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
+gcc -Wall -Werror main.c draw.c rewind.c snake.c replay.c map.c os.c hist.c bots.c pattern.c jobs.c scores.c dsp.c spectrum.c hint.c -o main -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
+gcc -Wall -Werror server.c checkpoint.c os.c snake.c bots.c pattern.c -o server -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
+gcc -Wall -Werror bothost.c botproto.c net.c hist.c snake.c -o bothost -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2 -lws2_32
+gcc -Wall -Werror bot_example.c botproto.c net.c snake.c bots.c pattern.c -o bot_example -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2 -lws2_32
+gcc -Wall -Werror shard.c os.c net.c hist.c snake.c bots.c pattern.c -o shard -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2 -lws2_32
+gcc -Wall -Werror tournament.c os.c replay.c recorder.c scores.c snake.c bots.c pattern.c -o tournament -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
+gcc -Wall -Werror analyze.c replay.c os.c hist.c snake.c -o analyze -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
+gcc -Wall -Werror watch.c term.c os.c replay.c snake.c bots.c pattern.c -o watch -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
+gcc -Wall -Werror export.c video.c draw.c replay.c snake.c -o export -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
+gcc -Wall -Werror fuzz.c snake.c bots.c pattern.c replay.c -o fuzz -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
+gcc -Wall -Werror verify.c snake.c snake_ref.c bots.c pattern.c replay.c -o verify -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
+gcc -Wall -Werror mazegen.c map.c os.c -o mazegen -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
+gcc -Wall -Werror patgen.c pattern.c snake.c -o patgen -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
+gcc -Wall -Werror leaderboard.c scores.c replay.c os.c snake.c -o leaderboard -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
+gcc -Wall -Werror arena.c scripts.c snake.c -o arena -Iinclude -LC:\Users\vlad\Desktop\sdl2 -lSDL2main -lSDL2
@@ -0,0 +1,320 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "checkpoint.h"
+#include "wire.h"
+
+
+// gives up on the round being written, the checkpoint from before stays
+static void discard_round(struct checkpoint_writer *writer) {
+    if (writer->file)
+	fclose(writer->file);
+    remove(writer->tmp_path);
+
+    writer->file = NULL;
+    writer->written = 0;
+}
+
+static void write_record(struct checkpoint_writer *writer, const struct checkpoint_record *record) {
+    // left over from a round that failed
+    if (record->round <= (u32) SDL_AtomicGet(&writer->done_round))
+	return;
+
+    bool ok = true;
+
+    if (!writer->file) {
+	writer->file = fopen(writer->tmp_path, "wb");
+	writer->file_round = record->round;
+	writer->written = 0;
+
+	u8 header[CHECKPOINT_HEADER_SIZE] = {0};
+	put_u32(header, CHECKPOINT_MAGIC);
+	put_u16(header + 4, CHECKPOINT_VERSION);
+	put_u32(header + 8, record->round);
+	put_u32(header + 12, writer->n_records);
+
+	ok = writer->file && fwrite(header, 1, sizeof(header), writer->file) == sizeof(header);
+    }
+
+    assert(!writer->file || writer->file_round == record->round);
+
+    u8 size[4];
+    put_u32(size, record->size);
+
+    ok = ok && fwrite(size, 1, sizeof(size), writer->file) == sizeof(size) &&
+	fwrite(record->data, 1, record->size, writer->file) == record->size;
+
+    if (ok && ++writer->written < writer->n_records)
+	return;
+
+    ok = ok && os_sync_file(writer->file);
+
+    if (ok) {
+	ok = fclose(writer->file) == 0 && os_replace_file(writer->tmp_path, writer->path);
+	writer->file = NULL;
+	writer->written = 0;
+    }
+
+    if (!ok) {
+	fprintf(stderr, "unable to write checkpoint round %u to %s\n", record->round, writer->path);
+	discard_round(writer);
+    }
+
+    // a failed round counts as done too, the next one tries again from scratch
+    SDL_AtomicSet(&writer->done_round, record->round);
+}
+
+static int writer_main(void *data) {
+    struct checkpoint_writer *writer = data;
+
+    SDL_LockMutex(writer->lock);
+
+    while (true) {
+	while (!writer->queue && !writer->stop)
+	    SDL_CondWait(writer->wake, writer->lock);
+
+	struct checkpoint_record *records = writer->queue;
+	writer->queue = NULL;
+	bool stop = writer->stop;
+
+	SDL_UnlockMutex(writer->lock);
+
+	// the queue is a stack, the order of rooms within a round does not matter
+	while (records) {
+	    struct checkpoint_record *record = records;
+	    records = record->next;
+
+	    write_record(writer, record);
+	    free(record);
+	}
+
+	SDL_LockMutex(writer->lock);
+
+	if (stop && !writer->queue)
+	    break;
+    }
+
+    SDL_UnlockMutex(writer->lock);
+
+    if (writer->file)
+	discard_round(writer);
+
+    return 0;
+}
+
+bool checkpoint_writer_start(struct checkpoint_writer *writer, const char *path, u32 n_records, u32 first_round) {
+    assert(writer);
+    assert(path);
+    assert(n_records > 0);
+
+    memset(writer, 0, sizeof(*writer));
+    snprintf(writer->path, sizeof(writer->path), "%s", path);
+    snprintf(writer->tmp_path, sizeof(writer->tmp_path), "%s.tmp", path);
+    writer->n_records = n_records;
+
+    SDL_AtomicSet(&writer->round, first_round);
+    SDL_AtomicSet(&writer->done_round, first_round);
+
+    writer->lock = SDL_CreateMutex();
+    writer->wake = SDL_CreateCond();
+    if (!writer->lock || !writer->wake)
+	return false;
+
+    writer->thread = SDL_CreateThread(writer_main, "checkpoint", writer);
+
+    return writer->thread != NULL;
+}
+
+void checkpoint_writer_stop(struct checkpoint_writer *writer) {
+    assert(writer);
+
+    SDL_LockMutex(writer->lock);
+    writer->stop = true;
+    SDL_CondSignal(writer->wake);
+    SDL_UnlockMutex(writer->lock);
+
+    SDL_WaitThread(writer->thread, NULL);
+
+    SDL_DestroyCond(writer->wake);
+    SDL_DestroyMutex(writer->lock);
+}
+
+bool checkpoint_start_round(struct checkpoint_writer *writer) {
+    assert(writer);
+
+    u32 round = SDL_AtomicGet(&writer->round);
+    if ((u32) SDL_AtomicGet(&writer->done_round) != round)
+	return false;
+
+    SDL_AtomicSet(&writer->round, round + 1);
+
+    return true;
+}
+
+struct checkpoint_record *checkpoint_record_alloc(struct checkpoint_writer *writer, u32 size) {
+    assert(writer);
+
+    struct checkpoint_record *record = malloc(sizeof(*record) + size);
+    assert(record);
+
+    record->next = NULL;
+    record->round = SDL_AtomicGet(&writer->round);
+    record->size = size;
+
+    return record;
+}
+
+void checkpoint_submit(struct checkpoint_writer *writer, struct checkpoint_record *record) {
+    assert(writer);
+    assert(record);
+
+    SDL_LockMutex(writer->lock);
+    record->next = writer->queue;
+    writer->queue = record;
+    SDL_CondSignal(writer->wake);
+    SDL_UnlockMutex(writer->lock);
+}
+
+
+u32 checkpoint_snake_size(const struct snake *snake) {
+    assert(snake);
+
+    return CHECKPOINT_SNAKE_HEADER_SIZE + snake->length * 4;
+}
+
+u8 *checkpoint_put_snake(u8 *buf, const struct snake *snake) {
+    assert(buf);
+    assert(snake);
+
+    buf[0] = direction_index(snake->direction);
+    buf[1] = snake->died;
+    put_u16(buf + 2, 0);
+    put_u16(buf + 4, snake->food_pos.x);
+    put_u16(buf + 6, snake->food_pos.y);
+    put_u32(buf + 8, snake->score);
+    put_u64(buf + 12, snake->rng.state);
+    put_u32(buf + 20, snake->pending_growth);
+    put_u32(buf + 24, snake->length);
+
+    u8 *out = buf + CHECKPOINT_SNAKE_HEADER_SIZE;
+    for (const struct snake_piece *walk = snake->tail; walk; walk = walk->next, out += 4) {
+	put_u16(out, walk->pos.x);
+	put_u16(out + 2, walk->pos.y);
+    }
+
+    return out;
+}
+
+const u8 *checkpoint_get_snake(const u8 *buf, const u8 *end, u32 bound_x, u32 bound_y, const struct rules *rules,
+			       struct snake *snake) {
+    assert(buf && end);
+    assert(rules);
+    assert(snake);
+
+    if (end - buf < CHECKPOINT_SNAKE_HEADER_SIZE || buf[0] > 3)
+	return NULL;
+
+    u32 length = get_u32(buf + 24);
+    if (length == 0 || (u64) (end - buf - CHECKPOINT_SNAKE_HEADER_SIZE) < (u64) length * 4)
+	return NULL;
+
+    memset(snake, 0, sizeof(*snake));
+
+    snake->bound_x = bound_x;
+    snake->bound_y = bound_y;
+    snake->direction = directions[buf[0]];
+    snake->died = buf[1];
+    snake->food_pos.x = get_u16(buf + 4);
+    snake->food_pos.y = get_u16(buf + 6);
+    snake->score = get_u32(buf + 8);
+    snake->rng.state = get_u64(buf + 12);
+
+    if ((u32) snake->food_pos.x >= bound_x || (u32) snake->food_pos.y >= bound_y)
+	return NULL;
+
+    const u8 *in = buf + CHECKPOINT_SNAKE_HEADER_SIZE;
+    bool fits = true;
+
+    for (u32 i=0; i<length; i++, in += 4) {
+	struct snake_piece *piece = malloc(sizeof(*piece));
+	assert(piece);
+
+	piece->pos.x = get_u16(in);
+	piece->pos.y = get_u16(in + 2);
+	piece->next = NULL;
+	piece->prev = snake->head;
+
+	if ((u32) piece->pos.x >= bound_x || (u32) piece->pos.y >= bound_y ||
+		(rules->obstacles && cell_bit(rules->obstacles, bound_x, piece->pos)))
+	    fits = false;
+
+	if (snake->head)
+	    snake->head->next = piece;
+	else
+	    snake->tail = piece;
+	snake->head = piece;
+    }
+
+    snake->length = length;
+
+    if (!fits) {
+	free_snake(snake);
+	return NULL;
+    }
+
+    resume_rules(snake, rules);
+    snake->pending_growth = get_u32(buf + 20);
+
+    return in;
+}
+
+
+bool checkpoint_open(struct checkpoint_reader *reader, const char *path) {
+    assert(reader);
+    assert(path);
+
+    memset(reader, 0, sizeof(*reader));
+
+    if (!os_map_file(path, &reader->map))
+	return false;
+
+    const u8 *header = reader->map.data;
+
+    if (reader->map.size < CHECKPOINT_HEADER_SIZE || get_u32(header) != CHECKPOINT_MAGIC ||
+	    get_u16(header + 4) != CHECKPOINT_VERSION) {
+	os_unmap_file(&reader->map);
+	return false;
+    }
+
+    reader->round = get_u32(header + 8);
+    reader->n_records = get_u32(header + 12);
+    reader->pos = CHECKPOINT_HEADER_SIZE;
+
+    return true;
+}
+
+const u8 *checkpoint_next(struct checkpoint_reader *reader, u32 *size) {
+    assert(reader);
+    assert(size);
+
+    if (reader->map.size - reader->pos < 4)
+	return NULL;
+
+    *size = get_u32(reader->map.data + reader->pos);
+    if (reader->map.size - reader->pos - 4 < *size)
+	return NULL;
+
+    const u8 *record = reader->map.data + reader->pos + 4;
+    reader->pos += 4 + (u64) *size;
+
+    return record;
+}
+
+void checkpoint_close(struct checkpoint_reader *reader) {
+    assert(reader);
+
+    os_unmap_file(&reader->map);
+    memset(reader, 0, sizeof(*reader));
+}
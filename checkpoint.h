@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+#include "SDL_atomic.h"
+
+#include "types.h"
+#include "snake.h"
+#include "os.h"
+
+// checkpoints of long running rooms, taken while they keep ticking
+//
+// a room is copied into a record of bytes by its own worker right after one of its ticks, a few microseconds
+// for a small room, and the record goes to a writer thread that does the file io and the fsync
+// rooms come up for their copy one at a time as their ticks come round, so a round of checkpoints is spread
+// over a tick period and ticking never waits on the disk
+//
+// every round goes to a temporary file that replaces the checkpoint once all rooms are in it,
+// a crash in the middle of a round leaves the previous round in place
+//
+// layout, little endian:
+//   u32 magic, u16 version, u16 0, u32 round, u32 records, then every record as u32 size and size bytes
+// a snake inside a record, see checkpoint_put_snake:
+//   u8 direction index, u8 died, u16 0, u16 food x, u16 food y, u32 score, u64 rng state, u32 pending growth,
+//   u32 length, then u16 x and u16 y of every piece from the tail to the head
+
+#define CHECKPOINT_MAGIC 0x434B4E53
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_HEADER_SIZE 16
+#define CHECKPOINT_SNAKE_HEADER_SIZE 28
+
+struct checkpoint_record {
+    struct checkpoint_record *next;
+    u32 round;
+    u32 size;
+    u8 data[];
+};
+
+struct checkpoint_writer {
+    char path[1024], tmp_path[1024];
+    // records that make up a round
+    u32 n_records;
+
+    SDL_Thread *thread;
+
+    // records handed over and not written yet, protected by lock
+    SDL_mutex *lock;
+    SDL_cond *wake;
+    struct checkpoint_record *queue;
+    bool stop;
+
+    // the round records are taken for, and the last one that is completely on disk
+    SDL_atomic_t round;
+    SDL_atomic_t done_round;
+
+    // private to the writer thread
+    FILE *file;
+    u32 file_round;
+    u32 written;
+};
+
+// starts the writer thread, rounds go to path and count on from first_round
+bool checkpoint_writer_start(struct checkpoint_writer *writer, const char *path, u32 n_records, u32 first_round);
+
+// writes what was handed over, a round that is not complete by then is thrown away
+void checkpoint_writer_stop(struct checkpoint_writer *writer);
+
+// starts the next round, false while the last one is still not on disk
+bool checkpoint_start_round(struct checkpoint_writer *writer);
+
+static inline u32 checkpoint_round(struct checkpoint_writer *writer) {
+    return SDL_AtomicGet(&writer->round);
+}
+
+// a record for the current round with room for size bytes, handed to checkpoint_submit once filled
+struct checkpoint_record *checkpoint_record_alloc(struct checkpoint_writer *writer, u32 size);
+
+// never waits on the disk, only on the short lock around the queue
+void checkpoint_submit(struct checkpoint_writer *writer, struct checkpoint_record *record);
+
+
+u32 checkpoint_snake_size(const struct snake *snake);
+
+// returns the end of what was written
+u8 *checkpoint_put_snake(u8 *buf, const struct snake *snake);
+
+// rebuilds a snake playing under rules, returns the end of what was read or NULL if it is cut short or does not
+// fit on the grid
+const u8 *checkpoint_get_snake(const u8 *buf, const u8 *end, u32 bound_x, u32 bound_y, const struct rules *rules,
+			       struct snake *snake);
+
+
+// a checkpoint on disk, read through a mapping
+struct checkpoint_reader {
+    struct os_mapped_file map;
+    u32 round;
+    u32 n_records;
+    u64 pos;
+};
+
+bool checkpoint_open(struct checkpoint_reader *reader, const char *path);
+
+// the next record, NULL when there are no more or the file is cut short
+const u8 *checkpoint_next(struct checkpoint_reader *reader, u32 *size);
+
+void checkpoint_close(struct checkpoint_reader *reader);
@@ -0,0 +1,18 @@
+#pragma once
+
+// stackless coroutines in the style of protothreads
+//
+// a coroutine is a plain function that keeps where it left off in a u16 of its own, CO_YIELD returns a value
+// and the next call jumps straight back behind it through one switch
+// nothing but that u16 survives a yield, so everything a coroutine needs across ticks lives in its frame next
+// to it, which is also all a coroutine costs
+//
+// the macros are the switch, so a coroutine cannot yield from inside a switch of its own, and only one
+// CO_YIELD fits on a line
+
+#define CO_BEGIN(line) switch (line) { case 0:
+
+#define CO_YIELD(line, value) do { (line) = __LINE__; return (value); case __LINE__:; } while (0)
+
+// running off the end starts the coroutine over on the next call
+#define CO_END(line, value) } (line) = 0; return (value)
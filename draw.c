@@ -0,0 +1,83 @@
+#include <assert.h>
+
+#include "draw.h"
+
+
+bool draw_walls_to_surface(const u64 *walls, u32 width, u32 height, SDL_Surface *surface) {
+    assert(walls);
+    assert(surface);
+
+    if (SDL_FillRect(surface, NULL, 0xFFFFFF) < 0)
+	return false;
+
+    u32 *pixels = (u32 *) surface->pixels;
+    u32 gray = SDL_MapRGB(surface->format, 0x80, 0x80, 0x80);
+
+    // the bits are in pixel order already, mostly empty words are skipped whole
+    u64 n_cells = (u64) width * height;
+    for (u64 word = 0; word < (n_cells + 63) / 64; word++) {
+	for (u64 bits = walls[word]; bits; bits &= bits - 1)
+	    pixels[word * 64 + __builtin_ctzll(bits)] = gray;
+    }
+
+    return true;
+}
+
+bool draw_snake_to_surface(const struct snake *snake, SDL_Surface *background, SDL_Surface *surface) {
+    assert(snake);
+    assert(surface);
+
+    if (background) {
+	if (SDL_BlitSurface(background, NULL, surface, NULL) < 0)
+	    return false;
+    } else if (SDL_FillRect(surface, NULL, 0xFFFFFF)  < 0) {
+	return false;
+    }
+
+    u32 *pixels = (u32 *) surface->pixels;
+
+    for (struct snake_piece *walk = snake->tail; walk; walk = walk->next) {
+	u32 pixel_idx = walk->pos.y * snake->bound_x + walk->pos.x;
+
+	pixels[pixel_idx] = 0;
+    }
+
+    u32 food_pixel_idx = snake->food_pos.y * snake->bound_x + snake->food_pos.x;
+    pixels[food_pixel_idx] = 0;
+
+    return true;
+}
+
+void draw_path_to_surface(const struct vec2 *cells, u32 n_cells, u32 width, SDL_Surface *surface) {
+    assert(cells || n_cells == 0);
+    assert(surface);
+
+    u32 *pixels = (u32 *) surface->pixels;
+    u32 green = SDL_MapRGB(surface->format, 0x60, 0xC0, 0x60);
+
+    for (u32 i=0; i<n_cells; i++)
+	pixels[cells[i].y * width + cells[i].x] = green;
+}
+
+bool draw_spectrum_to_surface(const f32 *heights, u32 n_bars, SDL_Surface *surface) {
+    assert(heights);
+    assert(surface);
+
+    u32 key = SDL_MapRGB(surface->format, 0xFF, 0x00, 0xFF);
+    u32 blue = SDL_MapRGB(surface->format, 0x30, 0x70, 0xD0);
+
+    if (SDL_FillRect(surface, NULL, key) < 0 || SDL_SetColorKey(surface, SDL_TRUE, key) < 0)
+	return false;
+
+    // bars from the bottom up, with a column of gap to the right of each
+    u32 bar_width = surface->w / n_bars;
+    for (u32 b=0; b<n_bars; b++) {
+	s32 h = heights[b] * surface->h;
+
+	SDL_Rect bar = { b * bar_width, surface->h - h, bar_width > 1 ? bar_width - 1 : 1, h };
+	if (h > 0 && SDL_FillRect(surface, &bar, blue) < 0)
+	    return false;
+    }
+
+    return true;
+}
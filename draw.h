@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SDL.h"
+
+#include "types.h"
+#include "snake.h"
+
+// one pixel per grid cell, white background with the snake and the food in black
+// the surface has to be bound_x by bound_y with 32 bit pixels, returns false if SDL fails to clear it
+// background is the static layer from draw_walls_to_surface, or NULL for a level without walls
+bool draw_snake_to_surface(const struct snake *snake, SDL_Surface *background, SDL_Surface *surface);
+
+// the walls of a map in gray on white, meant to be drawn once per level and kept as the background
+// of every frame instead of going over the whole map again each time
+bool draw_walls_to_surface(const u64 *walls, u32 width, u32 height, SDL_Surface *surface);
+
+// cells in green over a frame drawn by draw_snake_to_surface, width is the grid's
+void draw_path_to_surface(const struct vec2 *cells, u32 n_cells, u32 width, SDL_Surface *surface);
+
+// bars of heights from 0 to 1 in blue, everything else in a color key so the surface can be blitted over a frame
+// the surface should be a multiple of n_bars wide
+bool draw_spectrum_to_surface(const f32 *heights, u32 n_bars, SDL_Surface *surface);
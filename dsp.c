@@ -0,0 +1,167 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "dsp.h"
+
+
+#define DEFAULT_CUTOFF_HZ 500
+#define DEFAULT_DUCK_PERCENT 40
+
+// how long each ramp takes to go all the way
+#define MUFFLE_RAMP_MS 150
+#define DUCK_ATTACK_MS 20
+#define DUCK_RELEASE_MS 250
+#define LIMITER_RELEASE_MS 100
+
+// peaks are kept below this, a little under full scale
+#define LIMITER_THRESHOLD 0.9f
+
+// state below this is a denormal on the way to zero, and denormals are slow on x86
+#define DENORMAL 1e-15f
+
+void dsp_params_init(struct dsp_params *params) {
+    assert(params);
+
+    SDL_AtomicSet(&params->muffled, 0);
+    SDL_AtomicSet(&params->cutoff_hz, DEFAULT_CUTOFF_HZ);
+    SDL_AtomicSet(&params->duck_percent, DEFAULT_DUCK_PERCENT);
+}
+
+void dsp_init(struct dsp *dsp, u32 freq, u32 channels) {
+    assert(dsp);
+    assert(freq > 0);
+    assert(channels > 0 && channels <= DSP_MAX_CHANNELS);
+
+    memset(dsp, 0, sizeof(*dsp));
+
+    dsp->freq = freq;
+    dsp->channels = channels;
+
+    dsp->wet = 0;
+    dsp->music_gain = 1;
+    dsp->limiter_gain = 1;
+}
+
+// the rbj cookbook low-pass with a q of 1/sqrt(2), so there is no bump at the cutoff
+static void set_cutoff(struct dsp *dsp, u32 hz) {
+    if (hz < 20)
+	hz = 20;
+    if (hz > dsp->freq / 2 - 1)
+	hz = dsp->freq / 2 - 1;
+
+    if (hz == dsp->cutoff_hz)
+	return;
+    dsp->cutoff_hz = hz;
+
+    f64 w = 2 * M_PI * hz / dsp->freq;
+    f64 alpha = sin(w) / (2 * M_SQRT1_2);
+    f64 a0 = 1 + alpha;
+
+    dsp->b0 = (1 - cos(w)) / 2 / a0;
+    dsp->b1 = (1 - cos(w)) / a0;
+    dsp->b2 = dsp->b0;
+    dsp->a1 = -2 * cos(w) / a0;
+    dsp->a2 = (1 - alpha) / a0;
+}
+
+// where a ramp that takes ramp_ms from 0 to 1 gets from value in the given number of frames
+static f32 ramp_towards(const struct dsp *dsp, f32 value, f32 target, u32 ramp_ms, u32 frames) {
+    f32 step = (f32) frames * 1000 / ((f32) dsp->freq * ramp_ms);
+
+    if (value < target)
+	return value + step < target ? value + step : target;
+    else
+	return value - step > target ? value - step : target;
+}
+
+void dsp_process(struct dsp *dsp, struct dsp_params *params, const s16 *music, const s16 *sfx, s16 *out, u32 frames) {
+    assert(dsp);
+    assert(params);
+    assert(music && out);
+    assert(frames <= DSP_MAX_FRAMES);
+
+    if (frames == 0)
+	return;
+
+    u32 channels = dsp->channels;
+    u32 samples = frames * channels;
+    f32 *mix = dsp->mix;
+
+    // read once, the whole block works with the same values
+    bool muffled = SDL_AtomicGet(&params->muffled);
+    set_cutoff(dsp, SDL_AtomicGet(&params->cutoff_hz));
+    f32 duck = SDL_AtomicGet(&params->duck_percent) / 100.0f;
+
+    // straight loops over the whole block, no branches, so the compiler can vectorize them
+    for (u32 i=0; i<samples; i++)
+	mix[i] = music[i] * (1.0f / 32768);
+
+    // the filter always runs while it is fading in or out, the dry signal is crossfaded against it
+    f32 wet_end = ramp_towards(dsp, dsp->wet, muffled ? 1 : 0, MUFFLE_RAMP_MS, frames);
+
+    if (dsp->wet > 0 || wet_end > 0) {
+	f32 wet = dsp->wet, wet_step = (wet_end - dsp->wet) / frames;
+
+	for (u32 i=0; i<frames; i++, wet += wet_step) {
+	    for (u32 c=0; c<channels; c++) {
+		f32 x = mix[i * channels + c];
+		f32 y = dsp->b0 * x + dsp->z1[c];
+
+		dsp->z1[c] = dsp->b1 * x - dsp->a1 * y + dsp->z2[c];
+		dsp->z2[c] = dsp->b2 * x - dsp->a2 * y;
+
+		mix[i * channels + c] = x + wet * (y - x);
+	    }
+	}
+
+	for (u32 c=0; c<channels; c++) {
+	    if (fabsf(dsp->z1[c]) < DENORMAL)
+		dsp->z1[c] = 0;
+	    if (fabsf(dsp->z2[c]) < DENORMAL)
+		dsp->z2[c] = 0;
+	}
+    } else {
+	// fully dry, the next time it fades in it starts from silence
+	memset(dsp->z1, 0, sizeof(dsp->z1));
+	memset(dsp->z2, 0, sizeof(dsp->z2));
+    }
+
+    dsp->wet = wet_end;
+
+    // ducking, quick to make room and slow to give it back
+    f32 gain_target = sfx ? duck : 1;
+    f32 gain_end = ramp_towards(dsp, dsp->music_gain, gain_target,
+	    gain_target < dsp->music_gain ? DUCK_ATTACK_MS : DUCK_RELEASE_MS, frames);
+
+    f32 gain = dsp->music_gain, gain_step = (gain_end - dsp->music_gain) / frames;
+    for (u32 i=0; i<frames; i++, gain += gain_step)
+	for (u32 c=0; c<channels; c++)
+	    mix[i * channels + c] *= gain;
+
+    dsp->music_gain = gain_end;
+
+    if (sfx)
+	for (u32 i=0; i<samples; i++)
+	    mix[i] += sfx[i] * (1.0f / 32768);
+
+    // the limiter drops its gain at once when a frame would go over the threshold and recovers slowly,
+    // which also means nothing can clip on the way back to 16 bits
+    f32 limit = dsp->limiter_gain;
+    f32 release = 1000.0f / ((f32) dsp->freq * LIMITER_RELEASE_MS);
+
+    for (u32 i=0; i<frames; i++) {
+	f32 peak = 0;
+	for (u32 c=0; c<channels; c++)
+	    peak = fmaxf(peak, fabsf(mix[i * channels + c]));
+
+	limit = fminf(limit + release, 1);
+	if (peak * limit > LIMITER_THRESHOLD)
+	    limit = LIMITER_THRESHOLD / peak;
+
+	for (u32 c=0; c<channels; c++)
+	    out[i * channels + c] = (s16) (mix[i * channels + c] * limit * 32767);
+    }
+
+    dsp->limiter_gain = limit;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SDL_atomic.h"
+
+#include "types.h"
+
+// the effects between the mixer and the device: music -> low-pass -> ducking -> + sfx -> limiter
+//
+// the low-pass muffles the music while the game is paused, the ducking makes room for sound effects and the
+// limiter keeps the sum from clipping
+// everything runs on floats in blocks of a whole callback, coefficients and targets are worked out once per
+// block and then ramped linearly across it so nothing clicks when they change
+//
+// the game thread only touches dsp_params, the audio thread reads them once per block
+
+#define DSP_MAX_CHANNELS 8
+#define DSP_MAX_FRAMES 4096
+
+struct dsp_params {
+    // 1 engages the low-pass
+    SDL_atomic_t muffled;
+    SDL_atomic_t cutoff_hz;
+    // music volume in percent while a sound effect plays
+    SDL_atomic_t duck_percent;
+};
+
+// the audio thread's side, it owns all of it
+struct dsp {
+    u32 freq, channels;
+
+    // low-pass biquad, transposed direct form II, one state per channel
+    f32 b0, b1, b2, a1, a2;
+    u32 cutoff_hz;
+    f32 z1[DSP_MAX_CHANNELS], z2[DSP_MAX_CHANNELS];
+
+    // where the ramps ended on the last block
+    f32 wet, music_gain, limiter_gain;
+
+    f32 mix[DSP_MAX_FRAMES * DSP_MAX_CHANNELS];
+};
+
+void dsp_params_init(struct dsp_params *params);
+
+void dsp_init(struct dsp *dsp, u32 freq, u32 channels);
+
+// mixes frames of music and sfx, both interleaved 16 bit, into out, sfx can be NULL when none plays
+// frames is at most DSP_MAX_FRAMES
+void dsp_process(struct dsp *dsp, struct dsp_params *params, const s16 *music, const s16 *sfx, s16 *out, u32 frames);
@@ -0,0 +1,262 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+
+#include "types.h"
+#include "snake.h"
+#include "replay.h"
+#include "draw.h"
+#include "video.h"
+
+// renders a replay offscreen into a y4m video or a gif as fast as it can
+// frames are drawn the same way the game draws them and scaled up, the simulation hands them to
+// an encoder thread through a small ring of frame buffers which are reused for the whole export,
+// so the simulation only ever waits when the encoder is QUEUE_FRAMES frames behind
+
+
+#define QUEUE_FRAMES 8
+
+struct frame_queue {
+    u8 *frames[QUEUE_FRAMES];
+
+    // frames[head] to frames[head + count - 1] are waiting for the encoder, the rest are free
+    u32 head, count;
+    bool done;
+
+    SDL_mutex *lock;
+    SDL_cond *changed;
+};
+
+struct encoder {
+    struct frame_queue *queue;
+    struct video_writer *video;
+    bool ok;
+};
+
+
+static void fatal(const char *msg) {
+    fprintf(stderr, "%s: %s\n", msg, SDL_GetError());
+    exit(EXIT_FAILURE);
+}
+
+// the next free buffer, waits if the encoder has every one of them
+static u8 *queue_acquire(struct frame_queue *queue) {
+    SDL_LockMutex(queue->lock);
+    while (queue->count == QUEUE_FRAMES)
+	SDL_CondWait(queue->changed, queue->lock);
+    u8 *frame = queue->frames[(queue->head + queue->count) % QUEUE_FRAMES];
+    SDL_UnlockMutex(queue->lock);
+
+    return frame;
+}
+
+// hands the buffer from queue_acquire to the encoder
+static void queue_submit(struct frame_queue *queue) {
+    SDL_LockMutex(queue->lock);
+    queue->count++;
+    SDL_CondSignal(queue->changed);
+    SDL_UnlockMutex(queue->lock);
+}
+
+// the oldest frame waiting, or NULL once the queue is done and empty
+static u8 *queue_peek(struct frame_queue *queue) {
+    SDL_LockMutex(queue->lock);
+    while (queue->count == 0 && !queue->done)
+	SDL_CondWait(queue->changed, queue->lock);
+    u8 *frame = queue->count ? queue->frames[queue->head] : NULL;
+    SDL_UnlockMutex(queue->lock);
+
+    return frame;
+}
+
+// gives the frame from queue_peek back to the simulation
+static void queue_release(struct frame_queue *queue) {
+    SDL_LockMutex(queue->lock);
+    queue->head = (queue->head + 1) % QUEUE_FRAMES;
+    queue->count--;
+    SDL_CondSignal(queue->changed);
+    SDL_UnlockMutex(queue->lock);
+}
+
+static void queue_finish(struct frame_queue *queue) {
+    SDL_LockMutex(queue->lock);
+    queue->done = true;
+    SDL_CondSignal(queue->changed);
+    SDL_UnlockMutex(queue->lock);
+}
+
+static int encoder_thread(void *data) {
+    struct encoder *encoder = data;
+
+    u8 *frame;
+    while ((frame = queue_peek(encoder->queue))) {
+	// keep draining after an error so the simulation does not wait forever
+	if (encoder->ok && !video_write_frame(encoder->video, frame))
+	    encoder->ok = false;
+
+	queue_release(encoder->queue);
+    }
+
+    return 0;
+}
+
+// the scaled frame in palette indices, anything that is not the white background is black
+static void convert_frame(const SDL_Surface *surface, u8 *frame) {
+    for (s32 y=0; y<surface->h; y++) {
+	const u32 *line = (const u32 *) ((const u8 *) surface->pixels + y * surface->pitch);
+	u8 *out = frame + y * surface->w;
+
+	for (s32 x=0; x<surface->w; x++)
+	    out[x] = (line[x] & 0xFFFFFF) == 0xFFFFFF ? VIDEO_WHITE : VIDEO_BLACK;
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s REPLAY OUT [options]\n"
+	    "  OUT ends in .y4m or .gif\n"
+	    "  --scale N     pixels per grid cell (default 16)\n"
+	    "  --fps N       frames per second of the video, one tick per frame (default 20, the game's speed)\n"
+	    "  --from N      first tick to export (default 0)\n"
+	    "  --to N        tick to stop at (default: the end of the replay)\n",
+	    prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3)
+	usage(argv[0]);
+
+    const char *replay_path = argv[1];
+    const char *out_path = argv[2];
+    u32 scale = 16;
+    u32 fps = 20;
+    u32 from = 0, to = ~0u;
+
+    for (int i=3; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--scale") == 0)
+	    scale = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--fps") == 0)
+	    fps = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--from") == 0)
+	    from = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--to") == 0)
+	    to = strtoul(val, NULL, 10);
+	else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    if (scale == 0 || fps == 0)
+	usage(argv[0]);
+
+    struct replay replay;
+    if (!replay_load(&replay, replay_path)) {
+	fprintf(stderr, "unable to load replay %s\n", replay_path);
+	return EXIT_FAILURE;
+    }
+
+    if (replay.map_hash) {
+	fprintf(stderr, "%s was played on a map, only the game itself plays it back with --map\n", replay_path);
+	return EXIT_FAILURE;
+    }
+
+    if (to > replay.ticks)
+	to = replay.ticks;
+    if (from > to)
+	from = to;
+
+    u32 width = replay.bound_x * scale, height = replay.bound_y * scale;
+
+    struct video_writer video;
+    if (!video_open(&video, out_path, width, height, fps)) {
+	fprintf(stderr, "unable to create %s, it has to end in .y4m or .gif\n", out_path);
+	return EXIT_FAILURE;
+    }
+
+    SDL_Surface *grid_surface = SDL_CreateRGBSurfaceWithFormat(0, replay.bound_x, replay.bound_y, 32,
+	    SDL_PIXELFORMAT_RGB888);
+    SDL_Surface *scaled_surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGB888);
+    if (!grid_surface || !scaled_surface)
+	fatal("SDL_CreateRGBSurfaceWithFormat");
+
+    struct frame_queue queue = {0};
+    queue.lock = SDL_CreateMutex();
+    queue.changed = SDL_CreateCond();
+    if (!queue.lock || !queue.changed)
+	fatal("SDL_CreateMutex");
+
+    for (u32 i=0; i<QUEUE_FRAMES; i++) {
+	queue.frames[i] = malloc(width * height);
+	assert(queue.frames[i]);
+    }
+
+    struct encoder encoder = { &queue, &video, true };
+    SDL_Thread *thread = SDL_CreateThread(encoder_thread, "encoder", &encoder);
+    if (!thread)
+	fatal("SDL_CreateThread");
+
+    u64 start = SDL_GetPerformanceCounter();
+
+    struct snake snake;
+    replay_start(&replay, &snake);
+
+    // one frame for the state before every tick in [from, to] and one for the final state
+    for (u32 tick=0; tick<=to && !snake.died; tick++) {
+	if (tick >= from) {
+	    if (!draw_snake_to_surface(&snake, NULL, grid_surface))
+		fatal("SDL_FillRect");
+	    if (SDL_BlitScaled(grid_surface, NULL, scaled_surface, NULL) < 0)
+		fatal("SDL_BlitScaled");
+
+	    convert_frame(scaled_surface, queue_acquire(&queue));
+	    queue_submit(&queue);
+	}
+
+	if (tick == to)
+	    break;
+
+	snake.direction = replay_direction(&replay, tick);
+	move_snake(&snake);
+    }
+
+    queue_finish(&queue);
+    SDL_WaitThread(thread, NULL);
+
+    f64 seconds = (f64) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    u64 frames = video.frames;
+
+    if (!video_close(&video) || !encoder.ok) {
+	fprintf(stderr, "unable to write %s\n", out_path);
+	return EXIT_FAILURE;
+    }
+
+    // realtime is the game's own speed of 20 ticks a second
+    printf("%llu frames of %ux%u in %.2fs, %.0fx realtime\n", (unsigned long long) frames, width, height,
+	    seconds, seconds > 0 ? frames / 20.0 / seconds : 0.0);
+
+    for (u32 i=0; i<QUEUE_FRAMES; i++)
+	free(queue.frames[i]);
+    SDL_DestroyCond(queue.changed);
+    SDL_DestroyMutex(queue.lock);
+    SDL_FreeSurface(scaled_surface);
+    SDL_FreeSurface(grid_surface);
+    free_snake(&snake);
+    replay_free(&replay);
+
+    return EXIT_SUCCESS;
+}
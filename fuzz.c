@@ -0,0 +1,380 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+
+#include "types.h"
+#include "snake.h"
+#include "bots.h"
+#include "replay.h"
+
+// hunts for the ticks that take longest in the simulation, the ones that only show up after hours of play
+// e.g. next_food_pos drawing cell after cell on an almost full board
+//
+// an input is a grid size, a seed and a steering sequence:
+//   u8 bound_x - 4, u8 bound_y - 4 (both mod 61, so 4 to 64), u64 seed,
+//   then two bits per tick: 0 lets the greedy bot decide, 1 turns left, 2 turns right, 3 goes straight
+// once the input runs out the greedy bot plays on, so every input can grow a long snake
+//
+// the standalone driver keeps the inputs with the most expensive worst tick and mutates those,
+// cost is counted in cells looked at so it does not depend on timer noise
+// built with -DFUZZ_LIBFUZZER and clang -fsanitize=fuzzer it is a plain libFuzzer target instead, e.g.
+//   clang -O2 -DFUZZ_LIBFUZZER -fsanitize=fuzzer fuzz.c snake.c bots.c replay.c -Iinclude -lSDL2 -o fuzz_lf
+//
+// any input whose worst tick goes over the budget is saved as a replay, as is any input that fills the board,
+// which next_food_pos cannot handle: replaying a hang_ replay never finishes
+
+
+#define INPUT_HEADER_SIZE 10
+#define MAX_INPUT_SIZE 4096
+#define CORPUS_SIZE 64
+
+struct run_result {
+    // cells looked at by the most expensive tick, and the tick itself
+    u64 worst_cost;
+    u32 worst_tick;
+    u64 worst_tick_ns;
+
+    u32 ticks;
+    u32 length;
+    bool full;
+};
+
+struct input {
+    u8 data[MAX_INPUT_SIZE];
+    u32 size;
+    struct run_result result;
+};
+
+static u32 max_ticks = 20000;
+static u64 budget_ns = 100000;
+static const char *out_dir = ".";
+
+
+static u64 now_ns(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
+
+    return counter / freq * 1000000000 + counter % freq * 1000000000 / freq;
+}
+
+static struct vec2 steer(const struct snake *snake, u32 choice) {
+    struct vec2 dir = snake->direction;
+
+    switch (choice) {
+	case 1:
+	    return (struct vec2){ dir.y, -dir.x };
+	case 2:
+	    return (struct vec2){ -dir.y, dir.x };
+	case 3:
+	    return dir;
+	default:
+	    return bot_greedy(snake);
+    }
+}
+
+// how many cells next_food_pos drew before it found a free one, found by drawing the same numbers again
+static u32 food_attempts(struct rng rng, const struct snake *snake) {
+    u32 attempts = 0;
+    struct vec2 pos;
+
+    do {
+	pos.x = uniform_u32(&rng, snake->bound_x);
+	pos.y = uniform_u32(&rng, snake->bound_y);
+	attempts++;
+    } while (!VEC2S_EQUAL(pos, snake->food_pos));
+
+    return attempts;
+}
+
+// plays the input, recording the directions into replay if it is not NULL
+static void run_input(const u8 *data, u32 size, struct run_result *result, struct replay *replay) {
+    memset(result, 0, sizeof(*result));
+
+    if (size < INPUT_HEADER_SIZE)
+	return;
+
+    u32 bound_x = 4 + data[0] % 61;
+    u32 bound_y = 4 + data[1] % 61;
+    u64 seed = 0;
+    for (u32 i=0; i<8; i++)
+	seed |= (u64) data[2 + i] << (i * 8);
+
+    struct snake snake;
+    init_snake(&snake, bound_x, bound_y, seed);
+
+    if (replay)
+	replay_init(replay, bound_x, bound_y, seed, "fuzz");
+
+    const u8 *steps = data + INPUT_HEADER_SIZE;
+    u32 n_steps = (size - INPUT_HEADER_SIZE) * 4;
+
+    u32 tick;
+    for (tick = 0; tick < max_ticks && !snake.died; tick++) {
+	u32 choice = tick < n_steps ? (steps[tick / 4] >> (tick % 4 * 2)) & 3 : 0;
+	snake.direction = steer(&snake, choice);
+
+	if (replay)
+	    replay_record(replay, snake.direction);
+
+	// eating the last free cell would leave next_food_pos looking forever
+	struct vec2 next = move_in_bounded_direction(snake.head->pos, snake.direction, bound_x, bound_y);
+	if (VEC2S_EQUAL(next, snake.food_pos) && snake.length + 1 >= bound_x * bound_y) {
+	    result->full = true;
+	    break;
+	}
+
+	struct rng rng = snake.rng;
+	u32 score = snake.score;
+
+	u64 start = now_ns();
+	move_snake(&snake);
+	u64 ns = now_ns() - start;
+
+	// the collision test plus one test for every cell the food was tried on
+	u64 cost = 1;
+	if (snake.score != score)
+	    cost += food_attempts(rng, &snake);
+
+	if (cost > result->worst_cost) {
+	    result->worst_cost = cost;
+	    result->worst_tick = tick;
+	    result->worst_tick_ns = ns;
+	}
+    }
+
+    result->ticks = tick;
+    result->length = snake.length;
+
+    if (replay)
+	replay->score = snake.score;
+
+    free_snake(&snake);
+}
+
+static void save_finding(const u8 *data, u32 size, const char *kind, const struct run_result *result) {
+    struct run_result again;
+    struct replay replay;
+    run_input(data, size, &again, &replay);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s_%ux%u_%llu.snkr", out_dir, kind, replay.bound_x, replay.bound_y,
+	    (unsigned long long) replay.seed);
+
+    if (replay_save(&replay, path))
+	printf("%s: worst tick %u costs %llu cells, %lluus, length %u -> %s\n", kind, result->worst_tick,
+		(unsigned long long) result->worst_cost, (unsigned long long) result->worst_tick_ns / 1000,
+		result->length, path);
+    else
+	fprintf(stderr, "unable to save %s\n", path);
+
+    replay_free(&replay);
+}
+
+// a single slow tick can be the scheduler, the most expensive tick has to be slow on every run to count
+static bool confirm_slow(const u8 *data, u32 size, struct run_result *result) {
+    for (u32 i=0; i<3; i++) {
+	struct run_result again;
+	run_input(data, size, &again, NULL);
+
+	if (again.worst_tick_ns < result->worst_tick_ns)
+	    result->worst_tick_ns = again.worst_tick_ns;
+    }
+
+    return result->worst_tick_ns > budget_ns;
+}
+
+#ifdef FUZZ_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const u8 *data, size_t size) {
+    if (size > MAX_INPUT_SIZE)
+	return 0;
+
+    struct run_result result;
+    run_input(data, size, &result, NULL);
+
+    if (result.full)
+	save_finding(data, size, "hang", &result);
+    else if (result.worst_tick_ns > budget_ns && confirm_slow(data, size, &result))
+	save_finding(data, size, "slow", &result);
+
+    return 0;
+}
+
+#else
+
+static void mutate(struct rng *rng, struct input *input, const struct input *other) {
+    u8 *data = input->data;
+    u32 n = 1 + uniform_u32(rng, 4);
+
+    for (u32 i=0; i<n; i++) {
+	switch (uniform_u32(rng, 7)) {
+	    // another grid size
+	    case 0:
+		data[uniform_u32(rng, 2)] = next_u32(rng);
+		break;
+
+	    // another seed
+	    case 1:
+		data[2 + uniform_u32(rng, 8)] = next_u32(rng);
+		break;
+
+	    // change a few steps
+	    case 2:
+	    case 3:
+		if (input->size > INPUT_HEADER_SIZE)
+		    data[INPUT_HEADER_SIZE + uniform_u32(rng, input->size - INPUT_HEADER_SIZE)] ^= 1 << uniform_u32(rng, 8);
+		break;
+
+	    // more steps
+	    case 4: {
+		u32 len = 1 + uniform_u32(rng, 16);
+		if (input->size + len > MAX_INPUT_SIZE)
+		    break;
+		for (u32 j=0; j<len; j++)
+		    data[input->size + j] = next_u32(rng);
+		input->size += len;
+		break;
+	    }
+
+	    // fewer steps, hands the game to the greedy bot earlier
+	    case 5:
+		if (input->size > INPUT_HEADER_SIZE)
+		    input->size -= 1 + uniform_u32(rng, input->size - INPUT_HEADER_SIZE);
+		break;
+
+	    // the tail of another input
+	    case 6:
+		if (other->size > INPUT_HEADER_SIZE && input->size > INPUT_HEADER_SIZE) {
+		    u32 at = INPUT_HEADER_SIZE + uniform_u32(rng, input->size - INPUT_HEADER_SIZE);
+		    u32 from = INPUT_HEADER_SIZE + uniform_u32(rng, other->size - INPUT_HEADER_SIZE);
+		    u32 len = other->size - from;
+		    if (at + len > MAX_INPUT_SIZE)
+			len = MAX_INPUT_SIZE - at;
+		    memcpy(data + at, other->data + from, len);
+		    input->size = at + len;
+		}
+		break;
+	}
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s [options]\n"
+	    "  --seconds N       how long to fuzz (default 60)\n"
+	    "  --budget-us N     ticks slower than this are saved as replays (default 100)\n"
+	    "  --max-ticks N     games are cut off after this many ticks (default 20000)\n"
+	    "  --seed N          seed of the mutations (default 1)\n"
+	    "  --out DIR         where findings are saved (default .)\n",
+	    prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    u32 seconds = 60;
+    u64 seed = 1;
+
+    for (int i=1; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--seconds") == 0)
+	    seconds = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--budget-us") == 0)
+	    budget_ns = strtoull(val, NULL, 10) * 1000;
+	else if (strcmp(arg, "--max-ticks") == 0)
+	    max_ticks = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--seed") == 0)
+	    seed = strtoull(val, NULL, 10);
+	else if (strcmp(arg, "--out") == 0)
+	    out_dir = val;
+	else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    struct rng rng;
+    seed_rng(&rng, seed);
+
+    // the corpus starts out as random seeds left entirely to the greedy bot, half of them on small grids
+    // which fill up much sooner
+    static struct input corpus[CORPUS_SIZE];
+    for (u32 i=0; i<CORPUS_SIZE; i++) {
+	struct input *input = &corpus[i];
+	input->size = INPUT_HEADER_SIZE;
+	for (u32 j=0; j<INPUT_HEADER_SIZE; j++)
+	    input->data[j] = next_u32(&rng);
+	if (i % 2) {
+	    input->data[0] %= 8;
+	    input->data[1] %= 8;
+	}
+	run_input(input->data, input->size, &input->result, NULL);
+    }
+
+    u64 start = now_ns();
+    u64 next_report = start + 1000000000ull;
+    u64 execs = 0;
+    u64 worst_saved_ns = budget_ns;
+    u32 hangs = 0, slow = 0;
+
+    static struct input candidate;
+
+    while (now_ns() - start < (u64) seconds * 1000000000ull) {
+	const struct input *parent = &corpus[uniform_u32(&rng, CORPUS_SIZE)];
+	candidate = *parent;
+	mutate(&rng, &candidate, &corpus[uniform_u32(&rng, CORPUS_SIZE)]);
+
+	run_input(candidate.data, candidate.size, &candidate.result, NULL);
+	execs++;
+
+	struct run_result *result = &candidate.result;
+
+	// the first few are plenty, they are all the same bug
+	if (result->full && hangs < 8) {
+	    hangs++;
+	    save_finding(candidate.data, candidate.size, "hang", result);
+	}
+
+	// saving only new records keeps one noisy region from flooding the directory
+	if (result->worst_tick_ns > worst_saved_ns && confirm_slow(candidate.data, candidate.size, result) &&
+		result->worst_tick_ns > worst_saved_ns) {
+	    worst_saved_ns = result->worst_tick_ns;
+	    slow++;
+	    save_finding(candidate.data, candidate.size, "slow", result);
+	}
+
+	// replace the cheapest input of the corpus if this one was worse
+	u32 cheapest = 0;
+	for (u32 i=1; i<CORPUS_SIZE; i++)
+	    if (corpus[i].result.worst_cost < corpus[cheapest].result.worst_cost)
+		cheapest = i;
+
+	if (result->worst_cost > corpus[cheapest].result.worst_cost)
+	    corpus[cheapest] = candidate;
+
+	u64 now = now_ns();
+	if (now >= next_report) {
+	    u64 best_cost = 0;
+	    for (u32 i=0; i<CORPUS_SIZE; i++)
+		if (corpus[i].result.worst_cost > best_cost)
+		    best_cost = corpus[i].result.worst_cost;
+
+	    printf("%llu execs (%.0f/s), worst tick cost %llu cells, %u slow, %u hangs\n",
+		    (unsigned long long) execs, execs / ((now - start) / 1e9), (unsigned long long) best_cost, slow, hangs);
+	    next_report = now + 1000000000ull;
+	}
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif
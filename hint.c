@@ -0,0 +1,197 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hint.h"
+
+
+#define NO_CELL UINT32_MAX
+
+static u32 cell_of(const struct hint *hint, struct vec2 pos) {
+    return pos.y * hint->bound_x + pos.x;
+}
+
+static struct vec2 pos_of(const struct hint *hint, u32 cell) {
+    return (struct vec2) { cell % hint->bound_x, cell / hint->bound_x };
+}
+
+// the cell one step from cell in directions[dir], NO_CELL if that is off the grid and the grid has walls
+static u32 step_cell(const struct hint *hint, u32 cell, u32 dir) {
+    struct vec2 pos = pos_of(hint, cell);
+
+    if (hint->walls) {
+	pos.x += directions[dir].x;
+	pos.y += directions[dir].y;
+
+	if ((u32) pos.x >= hint->bound_x || (u32) pos.y >= hint->bound_y)
+	    return NO_CELL;
+    } else {
+	pos = move_in_bounded_direction(pos, directions[dir], hint->bound_x, hint->bound_y);
+    }
+
+    return cell_of(hint, pos);
+}
+
+// breadth first from the head of body, the last piece, until target comes up
+// a piece is in the way until the pieces behind it and any growth still to come have moved on, on the tick the
+// tail moves off it is still there, like in move_snake
+// the first time a cell is reached is the only one looked at, a longer way there could find more of the body gone,
+// for a hint that is close enough
+static bool search(struct hint *hint, const struct vec2 *body, u32 length, u32 pending_growth, u32 target) {
+    u32 n_cells = hint->bound_x * hint->bound_y;
+
+    memset(hint->free_at, 0, n_cells * sizeof(*hint->free_at));
+    memset(hint->dist, 0xFF, n_cells * sizeof(*hint->dist));
+
+    for (u32 i=0; i<length; i++)
+	hint->free_at[cell_of(hint, body[i])] = i + 1 + pending_growth;
+
+    u32 head = cell_of(hint, body[length - 1]);
+    hint->dist[head] = 0;
+    hint->queue[0] = head;
+    u32 first = 0, last = 1;
+
+    while (first < last) {
+	u32 cell = hint->queue[first++];
+	if (cell == target)
+	    return true;
+
+	u32 arrival = hint->dist[cell] + 1;
+
+	for (u32 dir=0; dir<4; dir++) {
+	    u32 next = step_cell(hint, cell, dir);
+
+	    if (next == NO_CELL || hint->dist[next] != NO_CELL || arrival <= hint->free_at[next])
+		continue;
+	    if (hint->obstacles && hint->obstacles[next / 64] >> (next % 64) & 1)
+		continue;
+
+	    hint->dist[next] = arrival;
+	    hint->prev[next] = cell;
+	    hint->queue[last++] = next;
+	}
+    }
+
+    return false;
+}
+
+static struct hint_path *find_path(struct hint *hint) {
+    u32 food = cell_of(hint, hint->food);
+
+    bool found = search(hint, hint->body, hint->length, hint->pending_growth, food);
+    u32 length = found ? hint->dist[food] : 0;
+
+    struct hint_path *path = malloc(sizeof(*path) + length * sizeof(path->cells[0]));
+    assert(path);
+
+    path->tick = hint->tick;
+    path->length = 0;
+
+    if (!found)
+	return path;
+
+    u32 cell = food;
+    for (u32 i=length; i>0; i--) {
+	path->cells[i - 1] = pos_of(hint, cell);
+	cell = hint->prev[cell];
+    }
+
+    // the body once the food is eaten is the end of the old body followed by the path, one piece longer
+    memcpy(hint->body + hint->length, path->cells, length * sizeof(path->cells[0]));
+
+    u32 total = hint->length + length;
+    u32 new_length = hint->length + 1 < total ? hint->length + 1 : total;
+    const struct vec2 *after = hint->body + total - new_length;
+
+    // a way back to its own tail keeps the snake out of a dead end for as long as it follows it
+    if (search(hint, after, new_length, hint->growth - 1, cell_of(hint, after[0])))
+	path->length = length;
+
+    return path;
+}
+
+static int hint_main(void *data) {
+    struct hint *hint = data;
+
+    while (true) {
+	SDL_SemWait(hint->wake);
+	if (SDL_AtomicGet(&hint->stop))
+	    break;
+
+	// a path nobody took yet is simply replaced by the newer one
+	free(SDL_AtomicSetPtr(&hint->published, find_path(hint)));
+
+	SDL_AtomicSet(&hint->busy, 0);
+    }
+
+    return 0;
+}
+
+bool hint_start(struct hint *hint, u32 bound_x, u32 bound_y) {
+    assert(hint);
+    assert(bound_x > 0 && bound_y > 0);
+
+    memset(hint, 0, sizeof(*hint));
+
+    hint->bound_x = bound_x;
+    hint->bound_y = bound_y;
+
+    u32 n_cells = bound_x * bound_y;
+
+    hint->body = malloc(2 * n_cells * sizeof(*hint->body));
+    hint->free_at = malloc(n_cells * sizeof(*hint->free_at));
+    hint->dist = malloc(n_cells * sizeof(*hint->dist));
+    hint->prev = malloc(n_cells * sizeof(*hint->prev));
+    hint->queue = malloc(n_cells * sizeof(*hint->queue));
+    assert(hint->body && hint->free_at && hint->dist && hint->prev && hint->queue);
+
+    hint->wake = SDL_CreateSemaphore(0);
+    if (!hint->wake)
+	return false;
+
+    hint->thread = SDL_CreateThread(hint_main, "hint", hint);
+
+    return hint->thread != NULL;
+}
+
+void hint_stop(struct hint *hint) {
+    assert(hint);
+
+    SDL_AtomicSet(&hint->stop, 1);
+    SDL_SemPost(hint->wake);
+    SDL_WaitThread(hint->thread, NULL);
+
+    SDL_DestroySemaphore(hint->wake);
+
+    free(hint_take(hint));
+    free(hint->body);
+    free(hint->free_at);
+    free(hint->dist);
+    free(hint->prev);
+    free(hint->queue);
+}
+
+void hint_request(struct hint *hint, const struct snake *snake, u32 tick) {
+    assert(hint);
+    assert(snake);
+    assert(snake->bound_x == hint->bound_x && snake->bound_y == hint->bound_y);
+
+    // the snake starting out stacked on a grid shorter than it would not fit the snapshot
+    if (SDL_AtomicGet(&hint->busy) || snake->died || snake->length > hint->bound_x * hint->bound_y)
+	return;
+
+    hint->walls = snake->walls;
+    hint->obstacles = snake->obstacles;
+    hint->food = snake->food_pos;
+    hint->tick = tick;
+    hint->growth = snake->growth;
+    hint->pending_growth = snake->pending_growth;
+
+    hint->length = 0;
+    for (const struct snake_piece *walk = snake->tail; walk; walk = walk->next)
+	hint->body[hint->length++] = walk->pos;
+
+    // the barrier in SDL_AtomicSet makes the snapshot visible before the search thread can see busy
+    SDL_AtomicSet(&hint->busy, 1);
+    SDL_SemPost(hint->wake);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+#include "SDL_atomic.h"
+
+#include "types.h"
+#include "snake.h"
+
+// a suggested path to the food for practice games, searched on a thread of its own
+//
+// after a tick the main thread hands over a copy of the game, but only if the search thread is idle, so the copy
+// is all a tick ever pays for, however long a search takes on a big board
+// the search is a breadth first search that knows which body cells will have moved out of the way by the time
+// the head gets there, and a path only counts as safe if the snake can still reach its tail after eating
+//
+// a finished path is published by swapping a pointer in, the renderer takes it by swapping NULL in,
+// so each path is owned by exactly one side at any time and whoever owns it frees it
+
+struct hint_path {
+    // the tick of the game it was searched from
+    u32 tick;
+    // 0 when there was no safe way to the food
+    u32 length;
+    // from the head's first step up to the food
+    struct vec2 cells[];
+};
+
+struct hint {
+    SDL_Thread *thread;
+    SDL_sem *wake;
+    SDL_atomic_t stop;
+    // set while the search thread owns the snapshot, the main thread only writes it while this is 0
+    SDL_atomic_t busy;
+
+    // the snapshot of the game
+    u32 bound_x, bound_y;
+    bool walls;
+    const u64 *obstacles;
+    struct vec2 food;
+    u32 tick;
+    u32 growth, pending_growth;
+    // tail to head, and room for the body after a path as well
+    struct vec2 *body;
+    u32 length;
+
+    // search state, one entry per cell
+    u32 *free_at;
+    u32 *dist;
+    u32 *prev;
+    u32 *queue;
+
+    // struct hint_path *, see above
+    void *published;
+};
+
+bool hint_start(struct hint *hint, u32 bound_x, u32 bound_y);
+
+void hint_stop(struct hint *hint);
+
+// starts a search from the snake as it is now, unless one is still running
+void hint_request(struct hint *hint, const struct snake *snake, u32 tick);
+
+// the newest path if there is one that was not taken yet, the caller frees it
+static inline struct hint_path *hint_take(struct hint *hint) {
+    return SDL_AtomicSetPtr(&hint->published, NULL);
+}
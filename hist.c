@@ -0,0 +1,85 @@
+#include <assert.h>
+#include <string.h>
+
+#include "hist.h"
+
+
+static u32 bucket_of(u64 value) {
+    if (value < 2 * HIST_SUB_BUCKETS)
+	return value;
+
+    u32 msb = 63 - __builtin_clzll(value);
+    u32 shift = msb - 4;
+
+    // value >> shift is in [16, 32), so consecutive shifts line up bucket after bucket
+    return shift * HIST_SUB_BUCKETS + (value >> shift);
+}
+
+// largest value that still lands in the bucket
+static u64 bucket_high(u32 bucket) {
+    if (bucket < 2 * HIST_SUB_BUCKETS)
+	return bucket;
+
+    u32 shift = bucket / HIST_SUB_BUCKETS - 1;
+    u64 mantissa = bucket - shift * HIST_SUB_BUCKETS;
+
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void hist_clear(struct hist *hist) {
+    assert(hist);
+
+    memset(hist, 0, sizeof(*hist));
+}
+
+void hist_add(struct hist *hist, u64 value) {
+    assert(hist);
+
+    hist->counts[bucket_of(value)]++;
+    hist->total++;
+    hist->sum += value;
+    if (value > hist->max)
+	hist->max = value;
+}
+
+void hist_merge(struct hist *dst, const struct hist *src) {
+    assert(dst);
+    assert(src);
+
+    for (u32 i=0; i<HIST_BUCKETS; i++)
+	dst->counts[i] += src->counts[i];
+
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->max > dst->max)
+	dst->max = src->max;
+}
+
+u64 hist_percentile(const struct hist *hist, f64 p) {
+    assert(hist);
+
+    if (hist->total == 0)
+	return 0;
+
+    u64 wanted = p * hist->total;
+    if (wanted >= hist->total)
+	wanted = hist->total - 1;
+
+    u64 seen = 0;
+    for (u32 i=0; i<HIST_BUCKETS; i++) {
+	seen += hist->counts[i];
+
+	if (seen > wanted) {
+	    u64 high = bucket_high(i);
+	    return high < hist->max ? high : hist->max;
+	}
+    }
+
+    return hist->max;
+}
+
+f64 hist_mean(const struct hist *hist) {
+    assert(hist);
+
+    return hist->total ? (f64) hist->sum / hist->total : 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "types.h"
+
+// log-linear histogram, every power of two is split into 16 buckets so percentiles come out within ~6%
+// adding a sample is a couple of instructions so it is fine to record on hot paths
+
+#define HIST_SUB_BUCKETS 16
+#define HIST_BUCKETS (HIST_SUB_BUCKETS * 61)
+
+struct hist {
+    u64 counts[HIST_BUCKETS];
+    u64 total;
+    u64 sum;
+    u64 max;
+};
+
+void hist_clear(struct hist *hist);
+
+void hist_add(struct hist *hist, u64 value);
+
+// merges src into dst
+void hist_merge(struct hist *dst, const struct hist *src);
+
+// value below which the fraction p of the samples falls, p in [0, 1]
+u64 hist_percentile(const struct hist *hist, f64 p);
+
+f64 hist_mean(const struct hist *hist);
@@ -0,0 +1,204 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "SDL_error.h"
+
+#include "jobs.h"
+
+
+void job_graph_init(struct job_graph *graph) {
+    assert(graph);
+
+    memset(graph, 0, sizeof(*graph));
+}
+
+struct job *job_graph_add(struct job_graph *graph, const char *name, job_fn fn, void *arg) {
+    assert(graph);
+    assert(fn);
+    assert(graph->n_jobs < JOB_GRAPH_MAX);
+
+    struct job *job = &graph->jobs[graph->n_jobs++];
+    memset(job, 0, sizeof(*job));
+
+    job->name = name;
+    job->fn = fn;
+    job->arg = arg;
+
+    return job;
+}
+
+void job_depends_on(struct job *job, struct job *dependency) {
+    assert(job);
+    assert(dependency);
+    assert(dependency->n_dependents < JOB_MAX_DEPENDENTS);
+
+    dependency->dependents[dependency->n_dependents++] = job;
+    job->n_dependencies++;
+}
+
+
+static void push(struct job_deque *deque, struct job *job) {
+    SDL_AtomicLock(&deque->lock);
+
+    assert(deque->bottom - deque->top < JOB_DEQUE_SIZE);
+    deque->jobs[deque->bottom++ % JOB_DEQUE_SIZE] = job;
+
+    SDL_AtomicUnlock(&deque->lock);
+}
+
+// the newest job, its data is most likely still in this thread's cache
+static struct job *pop(struct job_deque *deque) {
+    struct job *job = NULL;
+
+    SDL_AtomicLock(&deque->lock);
+
+    if (deque->bottom != deque->top)
+	job = deque->jobs[--deque->bottom % JOB_DEQUE_SIZE];
+
+    SDL_AtomicUnlock(&deque->lock);
+
+    return job;
+}
+
+// the oldest job, thieves never touch the end the owner works on unless it is the last job
+static struct job *steal(struct job_deque *deque) {
+    struct job *job = NULL;
+
+    // someone else is on this deque, there are other ones to try
+    if (!SDL_AtomicTryLock(&deque->lock))
+	return NULL;
+
+    if (deque->bottom != deque->top)
+	job = deque->jobs[deque->top++ % JOB_DEQUE_SIZE];
+
+    SDL_AtomicUnlock(&deque->lock);
+
+    return job;
+}
+
+// own deque first, then every other one starting after our own
+static struct job *find_job(struct job_pool *pool, u32 index) {
+    struct job *job = pop(&pool->deques[index]);
+    if (job)
+	return job;
+
+    for (u32 i=1; i<=pool->n_workers; i++) {
+	job = steal(&pool->deques[(index + i) % (pool->n_workers + 1)]);
+	if (job) {
+	    SDL_AtomicAdd(&pool->steals, 1);
+	    return job;
+	}
+    }
+
+    return NULL;
+}
+
+static void run_job(struct job_pool *pool, u32 index, struct job *job) {
+    job->fn(job->arg);
+
+    for (u32 i=0; i<job->n_dependents; i++) {
+	struct job *dependent = job->dependents[i];
+
+	// SDL_AtomicAdd returns the value before, so 1 means we were the last dependency
+	if (SDL_AtomicAdd(&dependent->pending, -1) == 1) {
+	    push(&pool->deques[index], dependent);
+	    if (pool->n_workers)
+		SDL_SemPost(pool->wake);
+	}
+    }
+
+    SDL_AtomicAdd(&pool->graph->remaining, -1);
+}
+
+static int worker_main(void *data) {
+    struct job_worker *worker = data;
+    struct job_pool *pool = worker->pool;
+
+    while (SDL_AtomicGet(&pool->running)) {
+	struct job *job = find_job(pool, worker->index);
+
+	if (job)
+	    run_job(pool, worker->index, job);
+	else
+	    SDL_SemWait(pool->wake);
+    }
+
+    return 0;
+}
+
+bool job_pool_init(struct job_pool *pool, u32 n_workers) {
+    assert(pool);
+    assert(n_workers <= JOB_MAX_WORKERS);
+
+    memset(pool, 0, sizeof(*pool));
+
+    pool->n_workers = n_workers;
+    SDL_AtomicSet(&pool->running, 1);
+
+    pool->wake = SDL_CreateSemaphore(0);
+    if (!pool->wake) {
+	fprintf(stderr, "unable to create semaphore: %s\n", SDL_GetError());
+	return false;
+    }
+
+    for (u32 i=0; i<n_workers; i++) {
+	pool->workers[i].pool = pool;
+	pool->workers[i].index = i;
+
+	pool->threads[i] = SDL_CreateThread(worker_main, "job worker", &pool->workers[i]);
+	if (!pool->threads[i]) {
+	    fprintf(stderr, "unable to create job worker: %s\n", SDL_GetError());
+	    pool->n_workers = i;
+	    job_pool_free(pool);
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+void job_pool_free(struct job_pool *pool) {
+    assert(pool);
+
+    SDL_AtomicSet(&pool->running, 0);
+
+    for (u32 i=0; i<pool->n_workers; i++)
+	SDL_SemPost(pool->wake);
+    for (u32 i=0; i<pool->n_workers; i++)
+	SDL_WaitThread(pool->threads[i], NULL);
+
+    if (pool->wake)
+	SDL_DestroySemaphore(pool->wake);
+
+    memset(pool, 0, sizeof(*pool));
+}
+
+void job_pool_run(struct job_pool *pool, struct job_graph *graph) {
+    assert(pool);
+    assert(graph);
+
+    u32 index = pool->n_workers;
+
+    pool->graph = graph;
+    SDL_AtomicSet(&graph->remaining, graph->n_jobs);
+
+    for (u32 i=0; i<graph->n_jobs; i++)
+	SDL_AtomicSet(&graph->jobs[i].pending, graph->jobs[i].n_dependencies);
+
+    // workers only find the roots once they are pushed, so everything above is visible to them by then
+    for (u32 i=0; i<graph->n_jobs; i++) {
+	if (graph->jobs[i].n_dependencies == 0) {
+	    push(&pool->deques[index], &graph->jobs[i]);
+	    if (pool->n_workers)
+		SDL_SemPost(pool->wake);
+	}
+    }
+
+    // a frame's graph is a handful of short jobs, waiting on anything slower than a spin would cost more than them
+    while (SDL_AtomicGet(&graph->remaining) > 0) {
+	struct job *job = find_job(pool, index);
+	if (job)
+	    run_job(pool, index, job);
+    }
+}
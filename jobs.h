@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SDL_atomic.h"
+#include "SDL_mutex.h"
+#include "SDL_thread.h"
+
+#include "types.h"
+
+// a small job system for the frame
+//
+// a frame is a graph of jobs built once at startup, every job runs once its dependencies are done
+// running the graph again only resets counters, so nothing is allocated per frame
+//
+// every worker has its own deque, jobs made ready by a worker go to the bottom of its own deque and it takes
+// them back from there, idle workers steal from the top of the others
+// the thread calling job_pool_run works too, so work SDL wants on the main thread is simply done before
+// or after running the graph
+
+#define JOB_GRAPH_MAX 32
+#define JOB_MAX_DEPENDENTS 8
+#define JOB_MAX_WORKERS 64
+// every job is pushed once per run, so a deque never holds more than a whole graph
+#define JOB_DEQUE_SIZE JOB_GRAPH_MAX
+
+typedef void (*job_fn)(void *arg);
+
+struct job {
+    const char *name;
+    job_fn fn;
+    void *arg;
+
+    // dependencies, fixed once the graph is built, and how many of them are left in the current run
+    u32 n_dependencies;
+    SDL_atomic_t pending;
+
+    struct job *dependents[JOB_MAX_DEPENDENTS];
+    u32 n_dependents;
+};
+
+struct job_graph {
+    struct job jobs[JOB_GRAPH_MAX];
+    u32 n_jobs;
+
+    // jobs of the current run that have not finished
+    SDL_atomic_t remaining;
+};
+
+struct job_deque {
+    SDL_SpinLock lock;
+    // jobs[top % size] up to jobs[bottom % size], the owner works at the bottom, thieves at the top
+    u32 top, bottom;
+    struct job *jobs[JOB_DEQUE_SIZE];
+};
+
+struct job_pool;
+
+struct job_worker {
+    struct job_pool *pool;
+    u32 index;
+};
+
+struct job_pool {
+    // threads besides the one calling job_pool_run, whose deque is the last one
+    u32 n_workers;
+    SDL_Thread *threads[JOB_MAX_WORKERS];
+    struct job_worker workers[JOB_MAX_WORKERS];
+    struct job_deque deques[JOB_MAX_WORKERS + 1];
+
+    // posted for every job made ready, sleeping workers wake up to steal it
+    SDL_sem *wake;
+    SDL_atomic_t running;
+
+    struct job_graph *graph;
+
+    // jobs taken from another thread's deque, over the pool's life
+    SDL_atomic_t steals;
+};
+
+void job_graph_init(struct job_graph *graph);
+
+struct job *job_graph_add(struct job_graph *graph, const char *name, job_fn fn, void *arg);
+
+// job only runs once dependency is done
+void job_depends_on(struct job *job, struct job *dependency);
+
+// starts n_workers threads, 0 runs every job on the calling thread
+bool job_pool_init(struct job_pool *pool, u32 n_workers);
+
+void job_pool_free(struct job_pool *pool);
+
+// runs every job of graph once and returns when they are all done
+// only one graph runs at a time, and only from the thread that called job_pool_init
+void job_pool_run(struct job_pool *pool, struct job_graph *graph);
@@ -0,0 +1,194 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+
+#include "types.h"
+#include "snake.h"
+#include "replay.h"
+#include "scores.h"
+#include "os.h"
+
+// looks into a score store, see scores.h, and fills it from directories of replays, e.g. a tournament's
+
+
+#define MAX_TOP 1000
+
+static u64 now_ns(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
+
+    return counter / freq * 1000000000 + counter % freq * 1000000000 / freq;
+}
+
+// every replay in dir goes in with the result it recorded, they are not played back
+static bool import_replays(struct score_store *store, const char *dir) {
+    u32 n_paths;
+    char **paths = os_list_dir(dir, ".snkr", &n_paths);
+    if (!paths) {
+	fprintf(stderr, "unable to read %s\n", dir);
+	return false;
+    }
+
+    u64 start = now_ns();
+    u32 imported = 0, unreadable = 0, on_map = 0;
+
+    for (u32 i=0; i<n_paths; i++) {
+	struct os_mapped_file file;
+	struct replay replay;
+
+	if (!os_map_file(paths[i], &file)) {
+	    unreadable++;
+	    continue;
+	}
+
+	bool parsed = replay_parse(&replay, file.data, file.size);
+
+	// a score on a map is not one for the classic board, and its replay only plays back with the map
+	if (parsed && replay.map_hash) {
+	    on_map++;
+	} else if (parsed) {
+	    struct score_entry entry = {
+		.score = replay.score,
+		.ticks = replay.ticks,
+		.seed = replay.seed,
+		.time = time(NULL),
+	    };
+	    score_set_replay(&entry, paths[i]);
+
+	    if (!scores_add(store, &entry)) {
+		fprintf(stderr, "unable to write to %s\n", store->log_path);
+		os_unmap_file(&file);
+		break;
+	    }
+	    imported++;
+	} else
+	    unreadable++;
+
+	os_unmap_file(&file);
+    }
+
+    bool ok = scores_flush(store);
+
+    printf("imported %u replays from %s in %.1fms, %u unreadable, %u played on a map\n", imported, dir,
+	    (now_ns() - start) / 1e6, unreadable, on_map);
+
+    os_free_paths(paths);
+    return ok;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s --scores FILE [options]\n"
+	    "  --scores FILE     the store, created if it is not there\n"
+	    "  --import DIR      add every replay in DIR\n"
+	    "  --top K           print the best K games, up to %u (default 10)\n"
+	    "  --rank SCORE      print where a game with SCORE would rank\n"
+	    "  --reindex yes     merge everything into the index now instead of when it is due\n",
+	    prog, MAX_TOP);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    const char *import = NULL;
+    u32 top = 10;
+    const char *rank = NULL;
+    bool reindex = false;
+
+    for (int i=1; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--scores") == 0)
+	    path = val;
+	else if (strcmp(arg, "--import") == 0)
+	    import = val;
+	else if (strcmp(arg, "--top") == 0)
+	    top = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--rank") == 0)
+	    rank = val;
+	else if (strcmp(arg, "--reindex") == 0)
+	    reindex = strcmp(val, "yes") == 0;
+	else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    if (!path || top > MAX_TOP)
+	usage(argv[0]);
+
+    // big enough that it goes on the heap
+    static struct score_store store;
+
+    u64 start = now_ns();
+    if (!scores_open(&store, path)) {
+	fprintf(stderr, "unable to open %s\n", path);
+	return EXIT_FAILURE;
+    }
+    printf("%llu games, %llu indexed, opened in %.1fms\n", (unsigned long long) scores_count(&store),
+	    (unsigned long long) store.n_indexed, (now_ns() - start) / 1e6);
+
+    if (import && !import_replays(&store, import)) {
+	scores_close(&store);
+	return EXIT_FAILURE;
+    }
+
+    if (reindex) {
+	start = now_ns();
+	if (!scores_reindex(&store))
+	    fprintf(stderr, "unable to write %s\n", store.index_path);
+	printf("reindexed %llu games in %.1fms\n", (unsigned long long) store.n_indexed, (now_ns() - start) / 1e6);
+    }
+
+    if (rank) {
+	u32 score = strtoul(rank, NULL, 10);
+
+	start = now_ns();
+	u64 r = scores_rank(&store, score);
+	printf("a score of %u ranks %llu of %llu (%.1fus)\n", score, (unsigned long long) r,
+		(unsigned long long) scores_count(&store) + 1, (now_ns() - start) / 1e3);
+    }
+
+    if (top) {
+	struct score_key keys[MAX_TOP];
+
+	start = now_ns();
+	u32 n = scores_top(&store, top, keys);
+	f64 top_us = (now_ns() - start) / 1e3;
+
+	printf("%6s %8s %8s %20s %20s  %s\n", "rank", "score", "ticks", "seed", "recorded", "replay");
+
+	for (u32 i=0; i<n; i++) {
+	    struct score_entry entry;
+	    if (!scores_get(&store, keys[i].record, &entry)) {
+		fprintf(stderr, "unable to read game %u\n", keys[i].record);
+		continue;
+	    }
+
+	    char when[32] = "?";
+	    time_t t = entry.time;
+	    struct tm *tm = localtime(&t);
+	    if (tm)
+		strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", tm);
+
+	    printf("%6u %8u %8u %20llu %20s  %s\n", i + 1, entry.score, entry.ticks,
+		    (unsigned long long) entry.seed, when, entry.replay);
+	}
+
+	printf("top %u in %.1fus\n", n, top_us);
+    }
+
+    scores_close(&store);
+
+    return EXIT_SUCCESS;
+}
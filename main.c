@@ -12,243 +12,216 @@
 #include "SDL_thread.h"
 
 #include "types.h"
-
-#define GRID_WIDTH 20
-#define GRID_HEIGHT 20
+#include "snake.h"
+#include "replay.h"
+#include "draw.h"
+#include "rewind.h"
+#include "map.h"
+#include "hist.h"
+#include "os.h"
+#include "bots.h"
+#include "jobs.h"
+#include "scores.h"
+#include "dsp.h"
+#include "spectrum.h"
+#include "hint.h"
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 800
 
-#define INITIAL_SNAKE_LEN 10
+// how far back holding R can take the game
+#define REWIND_SECONDS 10
 
+// fast forward, a frame runs up to this many ticks and only draws the last one, beyond it the speed is uncapped
+#define TURBO_MAX_SPEED 512
+// share of a frame uncapped speed spends ticking, the rest is left for drawing and events
+#define TURBO_BUDGET 0.8
 
-// returns u32 in the range [0, bound) preventing modulo bias
-u32 uniform_u32(u32 bound) {
-    u32 v = rand();
 
-    while (v >= RAND_MAX - (RAND_MAX % bound)) {
-	v = rand();
-    };
-    return v % bound;
+void fatal(const char *msg) {
+    assert(msg);
+    const char *err_str = SDL_GetError();
+    fprintf(stderr, "%s: %s\n", msg, err_str);
+    exit(EXIT_FAILURE);
 }
 
+static u64 now_ns(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
 
-struct vec2 {
-    s32 x, y;
-};
-
-struct snake_piece {
-    struct vec2 pos;
-    struct snake_piece *next;
-};
-
-// returns the position after moving pos in direction dir
-// but bounded in x direction by [0, bound_x) and in the y direction by [0, bound_y)
-// assumes dx < bound-x && dy < bound_x
-struct vec2 move_in_bounded_direction(struct vec2 pos, struct vec2 dir, u32 bound_x, u32 bound_y) {
-    struct vec2 new_pos;
-
-    new_pos.x = pos.x + dir.x; 
-    if (new_pos.x < 0)
-	new_pos.x = bound_x + new_pos.x;
-    else if (new_pos.x >= bound_x)
-	new_pos.x = new_pos.x - bound_x;
-
-
-    new_pos.y = pos.y + dir.y;
-    if (new_pos.y < 0)
-	new_pos.y = bound_y + new_pos.y;
-    else if (new_pos.y >= bound_y)
-	new_pos.y = new_pos.y - bound_y;
-
-    return new_pos;
+    return counter / freq * 1000000000 + counter % freq * 1000000000 / freq;
 }
 
-#define VEC2S_EQUAL(v1, v2) ((v1.x) == (v2.x) && (v1.y) == (v2.y))
-
-const struct vec2 DIRECTION_UP = {
-    .x = 0, .y = -1
-};
-const struct vec2 DIRECTION_DOWN = {
-    .x = 0, .y = 1
-};
-const struct vec2 DIRECTION_LEFT = {
-    .x = -1, .y = 0
-};
-const struct vec2 DIRECTION_RIGHT = {
-    .x = 1, .y = 0
-};
 
-struct vec2 directions[4] = {
-    DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT
+enum thread_priority {
+    PRIORITY_DEFAULT,
+    PRIORITY_LOW,
+    PRIORITY_NORMAL,
+    PRIORITY_HIGH,
+    PRIORITY_REALTIME,
 };
 
-struct snake {
-    // snake head is where new position is placed, tail is where last position is removed
-    struct snake_piece *head, *tail;
-
-    struct vec2 direction;
-
-    u32 bound_x, bound_y;
-
-    struct vec2 food_pos;
-
-    u32 score;
+static const char *priority_names[] = { "default", "low", "normal", "high", "realtime" };
 
-    bool died;
+// how a thread wants to be scheduled, on a loaded machine the scheduler is what makes ticks late and audio drop
+struct thread_config {
+    enum thread_priority priority;
+    // cpu to pin the thread to, -1 for any
+    s32 cpu;
 };
 
-void init_snake(struct snake *snake) {
-    assert(snake);
-
-    snake->bound_x = GRID_WIDTH;
-    snake->bound_y = GRID_HEIGHT;
-
-    snake->direction = directions[uniform_u32(4)];
-
-
-    // want to draw the snake tail in the opposite direction of the initial direction
-    struct vec2 tail_direction;
-    struct vec2 dir = snake->direction;
-    if (VEC2S_EQUAL(dir, DIRECTION_UP))
-	tail_direction = DIRECTION_DOWN;
-    else if (VEC2S_EQUAL(dir, DIRECTION_DOWN))
-	tail_direction = DIRECTION_UP;
-    else if (VEC2S_EQUAL(dir, DIRECTION_LEFT))
-	tail_direction = DIRECTION_RIGHT;
-    else if (VEC2S_EQUAL(dir, DIRECTION_RIGHT))
-	tail_direction = DIRECTION_LEFT;
-    else
-	assert(false);
-
-
-    snake->tail = NULL;
-
-    for (u32 i=0; i<INITIAL_SNAKE_LEN; i++) {
-	struct snake_piece *new_tail = malloc(sizeof(*new_tail));
-	assert(new_tail);
-
-	if (snake->tail) {
-	    new_tail->pos = move_in_bounded_direction(snake->tail->pos, tail_direction, snake->bound_x, snake->bound_y);
-	   
-	    new_tail->next = snake->tail;
-	    snake->tail = new_tail;
-	} else {
-	    new_tail->next = NULL;
-	    new_tail->pos.x = uniform_u32(snake->bound_x);
-	    new_tail->pos.y = uniform_u32(snake->bound_y);
-
-	    snake->head = snake->tail = new_tail;
+static bool parse_priority(const char *name, enum thread_priority *priority) {
+    for (u32 i=0; i<sizeof(priority_names) / sizeof(priority_names[0]); i++) {
+	if (strcmp(priority_names[i], name) == 0) {
+	    *priority = i;
+	    return true;
 	}
     }
 
-    snake->food_pos.x = uniform_u32(snake->bound_x);
-    snake->food_pos.y = uniform_u32(snake->bound_y);
-
-    snake->score = 0;
-
-    snake->died = false;
+    return false;
 }
 
-struct vec2 next_food_pos(const struct snake *snake)
-{
-    assert(snake);
+// applies config to the calling thread, what cannot be applied is only complained about
+static void apply_thread_config(const char *name, const struct thread_config *config) {
+    bool ok = true;
+
+    switch (config->priority) {
+	case PRIORITY_DEFAULT:
+	    break;
+	case PRIORITY_LOW:
+	    ok = SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW) == 0;
+	    break;
+	case PRIORITY_NORMAL:
+	    ok = SDL_SetThreadPriority(SDL_THREAD_PRIORITY_NORMAL) == 0;
+	    break;
+	case PRIORITY_HIGH:
+	    ok = SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH) == 0;
+	    break;
+	case PRIORITY_REALTIME:
+	    // without the privileges for a real time class the most we get is SDL's highest priority
+	    if (!os_set_realtime()) {
+		fprintf(stderr, "no real time scheduling for the %s thread, using time critical\n", name);
+		ok = SDL_SetThreadPriority(SDL_THREAD_PRIORITY_TIME_CRITICAL) == 0;
+	    }
+	    break;
+    }
 
-    struct vec2 result;
+    if (!ok)
+	fprintf(stderr, "unable to set the %s thread to %s priority: %s\n", name, priority_names[config->priority],
+		SDL_GetError());
 
-    // This is a perfectly fine way to generate a piece without colliding with a snake piece
-    // Maybe it could be more reliable in face of a really long snake but there is no such use case now
-    bool pos_taken;
+    if (config->cpu >= 0 && !os_pin_thread(config->cpu))
+	fprintf(stderr, "unable to pin the %s thread to cpu %d\n", name, config->cpu);
+}
 
-    do {
-	pos_taken = false;
+static void print_timing(const char *what, const struct thread_config *config, const struct hist *hist) {
+    char cpu[16] = "any";
+    if (config->cpu >= 0)
+	snprintf(cpu, sizeof(cpu), "%d", config->cpu);
 
-	result.x = uniform_u32(snake->bound_x);
-	result.y = uniform_u32(snake->bound_y);
+    printf("%s (%s priority, cpu %s): %llu samples, mean %.0fus, p50 %lluus, p99 %lluus, max %lluus\n",
+	    what, priority_names[config->priority], cpu, (unsigned long long) hist->total, hist_mean(hist),
+	    (unsigned long long) hist_percentile(hist, 0.5), (unsigned long long) hist_percentile(hist, 0.99),
+	    (unsigned long long) hist->max);
+}
 
-	for (struct snake_piece *walk = snake->tail; walk; walk = walk->next)
-	    if (VEC2S_EQUAL(result, walk->pos)) {
-		pos_taken = true;
-		break;
-	    }
-	
-    } while(pos_taken);
+static void record_score(const char *path, const struct snake *snake, u32 ticks, u64 seed, const char *replay_path) {
+    // too big for the stack
+    static struct score_store store;
 
-    return result;
-}
+    if (!scores_open(&store, path)) {
+	fprintf(stderr, "unable to open the scores in %s\n", path);
+	return;
+    }
 
-void move_snake(struct snake *snake) {
-    assert(snake);
+    struct score_entry entry = {
+	.score = snake->score,
+	.ticks = ticks,
+	.seed = seed,
+	.time = time(NULL),
+    };
+    if (replay_path)
+	score_set_replay(&entry, replay_path);
 
-    struct snake_piece *new_piece = malloc(sizeof(*new_piece));
-    assert(new_piece);
+    u64 rank = scores_rank(&store, entry.score);
+    if (scores_add(&store, &entry) && scores_flush(&store))
+	printf("Rank %llu of %llu\n", (unsigned long long) rank, (unsigned long long) scores_count(&store));
+    else
+	fprintf(stderr, "unable to save the score to %s\n", path);
 
-    new_piece->next = NULL;
+    scores_close(&store);
+}
 
-    new_piece->pos = move_in_bounded_direction(snake->head->pos, snake->direction, snake->bound_x, snake->bound_y);
 
-    // if the snake's new head is in the same position as any of its other pieces, then we die
-    for (struct snake_piece *walk = snake->tail; walk; walk = walk->next) {
-	if (VEC2S_EQUAL(new_piece->pos, walk->pos)) {
-	    snake->died = true;
-	    return;
-        }
-    }
+// timing of the audio callback, written by the callback and read under SDL_LockAudio
+struct audio_timing {
+    // how far apart callbacks come from what the buffer size promises, in us
+    struct hist jitter;
+    // time spent inside the callback, in us
+    struct hist busy;
+    // time spent in the effects, in ns
+    struct hist dsp;
+    u64 period_us;
+    u64 last_ns;
+};
 
-    snake->head->next = new_piece;
-    snake->head = new_piece;
+static struct audio_timing audio_timing;
 
+struct audio_data {
+    SDL_atomic_t len;
+    u8 *pos;
 
-    // if the snake's head is on the food, we eat it, and make a new one
-    bool ate = false;
-    if (VEC2S_EQUAL(snake->head->pos, snake->food_pos)) {
-	ate = true;
-	snake->score++;
+    // for SDL's audio thread, which only exists once the device is open, so it is applied on the first callback
+    const struct thread_config *config;
+    bool configured;
 
-	snake->food_pos = next_food_pos(snake);
-    }
+    // what the device plays, sound effects are only made for 16 bit samples
+    SDL_AudioFormat format;
+    u32 freq, channels;
 
+    // the sound effect playing, a square wave
+    u32 sfx_period, sfx_left, sfx_phase;
 
-    // only remove a tail piece if we have not just consumed food
-    // if we ate, this increases the length of the snake by 1
-    if (!ate) {
-	struct snake_piece *old_tail = snake->tail;
-	snake->tail = old_tail->next;
+    // effects for 16 bit devices, see dsp.h
+    struct dsp dsp;
+    bool use_dsp;
+};
 
-	free(old_tail);
-    }
-}
+// written by the game, read by the audio callback
+static struct dsp_params dsp_params;
 
-void fatal(const char *msg) {
-    assert(msg);
-    const char *err_str = SDL_GetError();
-    fprintf(stderr, "%s: %s\n", msg, err_str);
-    exit(EXIT_FAILURE);
-}
+// the music on its way to the spectrum, only fed when the spectrum is shown, which is set before audio starts
+static struct spectrum_buffer spectrum_buffer;
+static bool feed_spectrum;
 
-void draw_snake_to_surface(const struct snake *snake, SDL_Surface *surface) {
-    assert(snake);
-    assert(surface);
+// sound effects are made up on the spot, there are no files for them
+enum sfx {
+    SFX_NONE,
+    SFX_EAT,
+    SFX_DEATH,
+};
 
-    if (SDL_FillRect(surface, NULL, 0xFFFFFF)  < 0)
-	fatal("SDL_FillRect");
+// set by the frame, swapped back to SFX_NONE by the audio callback when it starts playing it
+static SDL_atomic_t sfx_trigger;
 
-    u32 *pixels = (u32 *) surface->pixels;
+// writes the current sound effect into wave, at most samples of it, returns how many frames it wrote
+static u32 make_sfx(struct audio_data *data, s16 *wave, u32 samples) {
+    u32 frames = samples / data->channels;
+    if (frames > data->sfx_left)
+	frames = data->sfx_left;
 
-    for (struct snake_piece *walk = snake->tail; walk; walk = walk->next) {
-	u32 pixel_idx = walk->pos.y * snake->bound_x + walk->pos.x;
+    for (u32 i=0; i<frames; i++) {
+	s16 v = data->sfx_phase < data->sfx_period / 2 ? 3000 : -3000;
+	for (u32 c=0; c<data->channels; c++)
+	    wave[i * data->channels + c] = v;
 
-	pixels[pixel_idx] = 0;
+	data->sfx_phase = (data->sfx_phase + 1) % data->sfx_period;
     }
 
-    u32 food_pixel_idx = snake->food_pos.y * snake->bound_x + snake->food_pos.x;
-    pixels[food_pixel_idx] = 0;
-}
+    data->sfx_left -= frames;
 
-struct audio_data {
-    SDL_atomic_t len;
-    u8 *pos;
-};
+    return frames;
+}
 
 struct audio_player {
     char *file;
@@ -266,24 +239,78 @@ void start_audio(struct audio_player *player) {
 
 void audio_callback(void *userdata, unsigned char *stream, int len) {
     struct audio_data *data = (struct audio_data *) userdata;
+    u64 start = now_ns();
 
-    SDL_memset(stream, 0, len);
+    if (!data->configured) {
+	apply_thread_config("audio", data->config);
+	data->configured = true;
+    }
 
-    if (SDL_AtomicGet(&data->len) == 0)
-	return;
+    // the first callback after opening has nothing to compare to
+    if (audio_timing.last_ns) {
+	u64 period_us = (start - audio_timing.last_ns) / 1000;
+	hist_add(&audio_timing.jitter, period_us > audio_timing.period_us ? period_us - audio_timing.period_us :
+		audio_timing.period_us - period_us);
+    }
+    audio_timing.last_ns = start;
 
     u32 data_len = SDL_AtomicGet(&data->len);
+    u32 music_len = (u32) len < data_len ? (u32) len : data_len;
+
+    // a new effect cuts off the one playing
+    enum sfx sfx = SDL_AtomicSet(&sfx_trigger, SFX_NONE);
+    if (sfx != SFX_NONE) {
+	data->sfx_period = data->freq / (sfx == SFX_EAT ? 880 : 110);
+	data->sfx_left = data->freq * (sfx == SFX_EAT ? 60 : 400) / 1000;
+	data->sfx_phase = 0;
+    }
+
+    static s16 music[DSP_MAX_FRAMES * DSP_MAX_CHANNELS];
+    static s16 wave[DSP_MAX_FRAMES * DSP_MAX_CHANNELS];
+    u32 frames = len / sizeof(s16) / data->channels;
+
+    if (data->use_dsp && frames <= DSP_MAX_FRAMES) {
+	// the music runs out before the block does on the last callback
+	SDL_memcpy(music, data->pos, music_len);
+	SDL_memset((u8 *) music + music_len, 0, len - music_len);
+
+	if (feed_spectrum)
+	    spectrum_feed(&spectrum_buffer, music, frames, data->channels);
+
+	bool playing = data->sfx_left && data->sfx_period;
+	if (playing) {
+	    u32 sfx_frames = make_sfx(data, wave, frames * data->channels);
+	    SDL_memset(wave + sfx_frames * data->channels, 0, (frames - sfx_frames) * data->channels * sizeof(s16));
+	}
 
-    if (len > data_len)
-	len = data_len;
+	u64 dsp_start = now_ns();
+	dsp_process(&data->dsp, &dsp_params, music, playing ? wave : NULL, (s16 *) stream, frames);
+	hist_add(&audio_timing.dsp, now_ns() - dsp_start);
+    } else {
+	SDL_memset(stream, 0, len);
 
-    SDL_MixAudio(stream, data->pos, len, SDL_MIX_MAXVOLUME);
+	if (music_len > 0)
+	    SDL_MixAudio(stream, data->pos, music_len, SDL_MIX_MAXVOLUME);
 
-    data->pos += len;
-    SDL_AtomicAdd(&data->len, -len);
+	if (data->sfx_left && data->sfx_period && data->format == AUDIO_S16SYS) {
+	    u32 sfx_frames = make_sfx(data, wave, len / sizeof(s16) < sizeof(wave) / sizeof(wave[0]) ?
+		    len / sizeof(s16) : sizeof(wave) / sizeof(wave[0]));
+	    SDL_MixAudioFormat(stream, (const u8 *) wave, AUDIO_S16SYS, sfx_frames * data->channels * sizeof(s16),
+		    SDL_MIX_MAXVOLUME);
+	}
+    }
+
+    if (music_len > 0) {
+	data->pos += music_len;
+	SDL_AtomicAdd(&data->len, -music_len);
+    }
+
+    hist_add(&audio_timing.busy, (now_ns() - start) / 1000);
 }
 
 int audio(void *data) {
+    const struct thread_config *config = data;
+
     const char *wav_file = "lux_aeterna.wav";
 
     SDL_AudioSpec wav_spec;
@@ -293,15 +320,18 @@ int audio(void *data) {
 
     if (SDL_LoadWAV(wav_file, &wav_spec, &wav_buf, &len) == NULL) {
 	fprintf(stderr, "SDL_LoadWAV: %s\n", SDL_GetError());
-    	return 1;
+	return 1;
     }
 
     while (true) {
 	printf("starting audio playback\n");
-	struct audio_data audio_data;
+	// the effects' buffers are too big for the stack
+	static struct audio_data audio_data;
 
 	audio_data.pos = wav_buf;
 	SDL_AtomicSet(&audio_data.len, len);
+	audio_data.config = config;
+	audio_data.configured = false;
 
 	wav_spec.callback = audio_callback;
 	wav_spec.userdata = &audio_data;
@@ -311,9 +341,24 @@ int audio(void *data) {
 	    return 1;
 	}
 
+	// wav_spec now holds what the device actually does
+	audio_timing.period_us = (u64) wav_spec.samples * 1000000 / wav_spec.freq;
+	audio_timing.last_ns = 0;
+
+	audio_data.format = wav_spec.format;
+	audio_data.freq = wav_spec.freq;
+	audio_data.channels = wav_spec.channels;
+	audio_data.sfx_left = 0;
+
+	// the effects only know 16 bit samples, anything else is mixed as it was
+	audio_data.use_dsp = wav_spec.format == AUDIO_S16SYS && wav_spec.channels <= DSP_MAX_CHANNELS;
+	if (audio_data.use_dsp)
+	    dsp_init(&audio_data.dsp, wav_spec.freq, wav_spec.channels);
+	SDL_AtomicSet(&spectrum_buffer.freq, wav_spec.freq);
+
 	SDL_PauseAudio(0);
 
-	while(SDL_AtomicGet(&
+	while(SDL_AtomicGet(&audio_data.len) > 0)
 	    SDL_Delay(100);
 	
 	SDL_CloseAudio();
@@ -323,15 +368,235 @@ int audio(void *data) {
 }
 
 
-int main(int argc, char *argv[]) {
-    srand(time(NULL));
+// where things go on the window, worked out again only when its size changes and not on every frame
+struct view {
+    SDL_Surface *window_surface;
+    // the grid with square cells, whole pixels per cell when they fit, the rest of the window stays white
+    SDL_Rect grid_rect;
+    // the bottom quarter of the grid
+    SDL_Rect spectrum_rect;
+};
+
+// the window surface is as big as the window is in pixels, on a high dpi display that is more than its size in
+// points, so everything is laid out from the surface and not from the window size
+static bool layout_view(struct view *view, SDL_Window *window, u32 bound_x, u32 bound_y) {
+    view->window_surface = SDL_GetWindowSurface(window);
+    if (!view->window_surface)
+	return false;
+
+    s32 w = view->window_surface->w, h = view->window_surface->h;
+    s32 cell = w / bound_x < h / bound_y ? w / bound_x : h / bound_y;
+
+    SDL_Rect *grid = &view->grid_rect;
+    if (cell > 0) {
+	grid->w = cell * bound_x;
+	grid->h = cell * bound_y;
+    } else if ((s64) w * bound_y < (s64) h * bound_x) {
+	// fewer pixels than cells, the cells are squeezed together and only keep the grid's proportions
+	grid->w = w;
+	grid->h = (s64) w * bound_y / bound_x;
+    } else {
+	grid->w = (s64) h * bound_x / bound_y;
+	grid->h = h;
+    }
+    grid->x = (w - grid->w) / 2;
+    grid->y = (h - grid->h) / 2;
+
+    view->spectrum_rect = (SDL_Rect) { grid->x, grid->y + grid->h * 3 / 4, grid->w, grid->h / 4 };
+
+    // the bars around the grid are only ever filled here, every frame draws over the grid alone
+    return SDL_FillRect(view->window_surface, NULL, 0xFFFFFF) == 0;
+}
+
+// what the jobs of a frame work on
+// a frame is a tick: sim -> (bot || render || sfx) -> present with the spectrum next to all of it,
+// the present stays on the main thread for SDL
+struct frame {
+    struct snake *snake;
+    struct rewind *rewind;
+    bool rewinding;
+
+    struct replay *replay;
+    bool replaying;
+    u32 replay_tick;
+
+    struct replay *record;
+    bool recording;
+
+    // ticks the game has gone on for, rewinding takes them back
+    u32 ticks;
+
+    // steers instead of the keyboard when set
+    const struct bot_info *bot;
+
+    SDL_Surface *walls_surface, *grid_surface;
+    const struct view *view;
+
+    // what the frame's ticks changed, for the sfx, so fast forward makes a sound at most once a frame
+    u32 score_before;
+    bool died_before;
+
+    // the music's spectrum, its own job draws it and the main thread lays it over the window once the frame is done
+    struct spectrum *spectrum;
+    SDL_Surface *spectrum_surface;
+    // time the job took, in ns
+    struct hist spectrum_time;
+
+    // a suggested way to the food for practice, NULL without, the render job owns the path it took last
+    struct hint *hint;
+    struct hint_path *hint_path;
+
+    // looked at on the main thread once the frame is done
+    bool replay_over;
+    const char *render_error;
+    const char *spectrum_error;
+};
+
+static void sim_job(void *arg) {
+    struct frame *frame = arg;
+    struct snake *snake = frame->snake;
+
+    if (frame->rewinding) {
+	// the replay and the recording go back with the game
+	if (rewind_undo(frame->rewind, snake)) {
+	    frame->ticks--;
+	    if (frame->replaying)
+		frame->replay_tick--;
+	    if (frame->recording)
+		frame->record->ticks--;
+	}
+
+    } else if (!snake->died) {
+	if (frame->replaying) {
+	    if (frame->replay_tick == frame->replay->ticks) {
+		frame->replay_over = true;
+		return;
+	    }
+
+	    snake->direction = replay_direction(frame->replay, frame->replay_tick++);
+	}
+
+	if (frame->recording)
+	    replay_record(frame->record, snake->direction);
+
+	rewind_move_snake(frame->rewind, snake);
+	frame->ticks++;
+
+	if (snake->died)
+	    printf("You died! Score: %d, hold R to rewind\n", snake->score);
+    }
+}
+
+// decides the direction of the next tick, only reads the body so it runs next to the render
+static void bot_job(void *arg) {
+    struct frame *frame = arg;
+
+    if (frame->bot && !frame->replaying && !frame->snake->died)
+	frame->snake->direction = frame->bot->decide(frame->snake);
+}
+
+// lays the newest hint over the grid from where the head is on it, a path the snake went off of is not shown
+static void draw_hint(struct frame *frame) {
+    struct hint_path *newer = hint_take(frame->hint);
+    if (newer) {
+	free(frame->hint_path);
+	frame->hint_path = newer;
+    }
+
+    const struct hint_path *path = frame->hint_path;
+    const struct snake *snake = frame->snake;
+
+    if (!path || path->length == 0 || !VEC2S_EQUAL(path->cells[path->length - 1], snake->food_pos))
+	return;
+
+    // the search may be a few ticks behind on a big board, the head has then already gone some of the way
+    u32 from = 0;
+    if (frame->ticks != path->tick) {
+	while (from < path->length && !VEC2S_EQUAL(path->cells[from], snake->head->pos))
+	    from++;
+	if (from == path->length)
+	    return;
+	from++;
+    }
+
+    // the food keeps its own color
+    draw_path_to_surface(path->cells + from, path->length - 1 - from, snake->bound_x, frame->grid_surface);
+}
+
+static void render_job(void *arg) {
+    struct frame *frame = arg;
+
+    if (!draw_snake_to_surface(frame->snake, frame->walls_surface, frame->grid_surface)) {
+	frame->render_error = "SDL_FillRect";
+	return;
+    }
+
+    if (frame->hint)
+	draw_hint(frame);
+
+    // blits write the clipped rect back, the view's own stays as it was laid out
+    SDL_Rect rect = frame->view->grid_rect;
+    if (SDL_BlitScaled(frame->grid_surface, NULL, frame->view->window_surface, &rect) < 0)
+	frame->render_error = "SDL_BlitScaled";
+}
+
+// needs nothing from the tick, so it runs next to everything else
+static void spectrum_job(void *arg) {
+    struct frame *frame = arg;
+
+    if (!frame->spectrum)
+	return;
+
+    u64 start = now_ns();
+
+    // the overlay is only drawn again for a new block, otherwise the one from before is laid over the window
+    if (spectrum_update(frame->spectrum, &spectrum_buffer) &&
+	    !draw_spectrum_to_surface(frame->spectrum->heights, frame->spectrum->n_bars, frame->spectrum_surface))
+	frame->spectrum_error = "SDL_FillRect";
+
+    hist_add(&frame->spectrum_time, now_ns() - start);
+}
+
+// the ticks of a fast forwarded frame before its last one, which goes through the frame's graph as usual
+// sim and bot take turns on the main thread, handing ticks this short to the workers would only add waiting
+static void run_turbo_ticks(struct frame *frame, u32 speed, u64 deadline_ns) {
+    for (u32 i=1; speed == 0 || i < speed; i++) {
+	if (frame->replay_over || (frame->snake->died && !frame->rewinding))
+	    return;
+
+	// uncapped only looks at the clock every few ticks, it costs about as much as a tick
+	if (speed == 0 && i % 64 == 0 && now_ns() >= deadline_ns)
+	    return;
+
+	sim_job(frame);
+	bot_job(frame);
+    }
+}
 
+static void print_speed(u32 speed) {
+    if (speed)
+	printf("speed %ux\n", speed);
+    else
+	printf("speed uncapped\n");
+}
+
+static void sfx_job(void *arg) {
+    struct frame *frame = arg;
+
+    if (frame->snake->died && !frame->died_before)
+	SDL_AtomicSet(&sfx_trigger, SFX_DEATH);
+    else if (frame->snake->score > frame->score_before)
+	SDL_AtomicSet(&sfx_trigger, SFX_EAT);
+}
+
+
+int main(int argc, char *argv[]) {
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
 	fatal("SDL_Init");
 
 
     SDL_Window *window = SDL_CreateWindow("Window", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 
-	    WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL);
+	    WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL | SDL_WINDOW_ALLOW_HIGHDPI);
     if (!window)
 	fatal("SDL_CreateWindow");
 
@@ -353,21 +618,228 @@ int main(int argc, char *argv[]) {
 
     SDL_PixelFormat *window_surface_format = window_surface->format;
 
-    SDL_Surface *grid_surface = SDL_CreateRGBSurfaceWithFormat(0, GRID_WIDTH, GRID_HEIGHT, 
-	    window_surface_format->BitsPerPixel, window_surface_format->format);
+    // a replay, e.g. one saved by the tournament, steers the snake instead of the keyboard
+    struct replay replay;
+    bool replaying = false;
+
+    // the other way around, every game played by hand can be saved as a replay
+    struct replay record;
+    const char *record_path = NULL;
+
+    // games played, not watched, go on the leaderboard, see scores.h
+    const char *scores_path = NULL;
+
+    // a level with static walls, its grid replaces the default one
+    struct level_map map;
+    bool have_map = false;
+
+    // the main thread runs both the simulation and the rendering
+    struct thread_config sim_config = { PRIORITY_DEFAULT, -1 };
+    struct thread_config audio_config = { PRIORITY_DEFAULT, -1 };
+
+    // a builtin bot can play instead, see bots.h
+    const struct bot_info *bot = NULL;
+
+    // threads helping the main one with each frame, the frame is only three jobs wide after the sim
+    u32 n_job_workers = SDL_GetCPUCount() > 1 ? SDL_GetCPUCount() - 1 : 0;
+    if (n_job_workers > 3)
+	n_job_workers = 3;
+
+    // bars of the music's spectrum along the bottom of the window, 0 for none
+    u32 spectrum_bars = 0;
+
+    // ticks per frame, 0 runs as many as fit in a frame, see TURBO_BUDGET
+    u32 speed = 1;
+
+    // practice mode, shows a safe way to the food, see hint.h
+    bool hints = false;
+
+    for (int i=1; i+1<argc; i++) {
+	if (strcmp(argv[i], "--record") == 0)
+	    record_path = argv[i+1];
+	if (strcmp(argv[i], "--scores") == 0)
+	    scores_path = argv[i+1];
+
+	if (strcmp(argv[i], "--replay") == 0) {
+	    if (!replay_load(&replay, argv[i+1])) {
+		fprintf(stderr, "unable to load replay %s\n", argv[i+1]);
+		return EXIT_FAILURE;
+	    }
+	    replaying = true;
+	}
+
+	if (strcmp(argv[i], "--map") == 0) {
+	    if (!map_load(&map, argv[i+1])) {
+		fprintf(stderr, "unable to load map %s\n", argv[i+1]);
+		return EXIT_FAILURE;
+	    }
+	    have_map = true;
+	}
+
+	if ((strcmp(argv[i], "--sim-priority") == 0 && !parse_priority(argv[i+1], &sim_config.priority)) ||
+		(strcmp(argv[i], "--audio-priority") == 0 && !parse_priority(argv[i+1], &audio_config.priority))) {
+	    fprintf(stderr, "unknown priority %s, one of low, normal, high, realtime\n", argv[i+1]);
+	    return EXIT_FAILURE;
+	}
+
+	if (strcmp(argv[i], "--bot") == 0 && !(bot = find_bot(argv[i+1]))) {
+	    fprintf(stderr, "unknown bot %s\n", argv[i+1]);
+	    return EXIT_FAILURE;
+	}
+
+	if (strcmp(argv[i], "--jobs") == 0)
+	    n_job_workers = strtoul(argv[i+1], NULL, 10) < JOB_MAX_WORKERS ? strtoul(argv[i+1], NULL, 10) : JOB_MAX_WORKERS;
+
+	if (strcmp(argv[i], "--spectrum") == 0) {
+	    spectrum_bars = strtoul(argv[i+1], NULL, 10);
+	    if (spectrum_bars > SPECTRUM_MAX_BARS) {
+		fprintf(stderr, "the spectrum has at most %u bars\n", SPECTRUM_MAX_BARS);
+		return EXIT_FAILURE;
+	    }
+	}
+
+	if (strcmp(argv[i], "--hints") == 0)
+	    hints = strcmp(argv[i+1], "yes") == 0;
+
+	if (strcmp(argv[i], "--speed") == 0) {
+	    speed = strtoul(argv[i+1], NULL, 10);
+	    if (speed > TURBO_MAX_SPEED) {
+		fprintf(stderr, "the speed is at most %u, 0 is uncapped\n", TURBO_MAX_SPEED);
+		return EXIT_FAILURE;
+	    }
+	}
+
+	if (strcmp(argv[i], "--sim-cpu") == 0)
+	    sim_config.cpu = atoi(argv[i+1]);
+	if (strcmp(argv[i], "--audio-cpu") == 0)
+	    audio_config.cpu = atoi(argv[i+1]);
+    }
+
+    apply_thread_config("sim", &sim_config);
 
     bool running = true;
     bool paused = false;
 
     struct snake snake;
+    u64 seed = time(NULL);
+
+    u64 map_id = have_map ? map_hash(&map) : 0;
+
+    // a replay only plays back the game it recorded on the map it was recorded on
+    if (replaying && replay.map_hash != map_id) {
+	if (!replay.map_hash)
+	    fprintf(stderr, "the replay was played without a map\n");
+	else if (!have_map)
+	    fprintf(stderr, "the replay was played on a map, it needs --map\n");
+	else
+	    fprintf(stderr, "the replay was played on another map\n");
+	return EXIT_FAILURE;
+    }
+
+    if (replaying)
+	replay_start(&replay, &snake);
+    else if (have_map)
+	init_snake(&snake, map.width, map.height, seed);
+    else
+	init_snake(&snake, GRID_WIDTH, GRID_HEIGHT, seed);
+
+    if (have_map) {
+	if (snake.bound_x != map.width || snake.bound_y != map.height) {
+	    fprintf(stderr, "the map is %ux%u but the replay is %ux%u\n", map.width, map.height,
+		    snake.bound_x, snake.bound_y);
+	    return EXIT_FAILURE;
+	}
+
+	if (!set_rules(&snake, &(struct rules) { .obstacles = map.walls })) {
+	    fprintf(stderr, "the map has no room for the snake, it needs %u free cells in a row\n", INITIAL_SNAKE_LEN);
+	    return EXIT_FAILURE;
+	}
+    }
+
+    if (record_path) {
+	replay_init(&record, snake.bound_x, snake.bound_y, replaying ? replay.seed : seed,
+		bot ? bot->name : "human");
+	record.map_hash = map_id;
+    }
+
+    // the ticks run backwards while R is held, also after dying, see frame.rewinding
+    struct rewind rewind;
+    rewind_init(&rewind, &snake, REWIND_SECONDS * 1000 / 50);
+
+    SDL_Surface *grid_surface = SDL_CreateRGBSurfaceWithFormat(0, snake.bound_x, snake.bound_y, 
+	    window_surface_format->BitsPerPixel, window_surface_format->format);
+
+    // the walls never change, so they are drawn once and every frame starts from a copy of them
+    SDL_Surface *walls_surface = NULL;
+    if (have_map) {
+	walls_surface = SDL_CreateRGBSurfaceWithFormat(0, snake.bound_x, snake.bound_y,
+		window_surface_format->BitsPerPixel, window_surface_format->format);
+	if (!walls_surface || !draw_walls_to_surface(map.walls, map.width, map.height, walls_surface))
+	    fatal("SDL_CreateRGBSurfaceWithFormat");
+    }
+
 
-    init_snake(&snake);
+    dsp_params_init(&dsp_params);
 
+    static struct spectrum spectrum;
+    SDL_Surface *spectrum_surface = NULL;
+    if (spectrum_bars) {
+	spectrum_init(&spectrum, spectrum_bars);
+	spectrum_buffer_init(&spectrum_buffer);
+	feed_spectrum = true;
 
-    SDL_Thread *thread = SDL_CreateThread(audio, "audio", NULL);
+	// a few pixels per bar, scaled up onto the window like the grid
+	spectrum_surface = SDL_CreateRGBSurfaceWithFormat(0, spectrum_bars * 4, 64,
+		window_surface_format->BitsPerPixel, window_surface_format->format);
+	if (!spectrum_surface || !draw_spectrum_to_surface(spectrum.heights, spectrum_bars, spectrum_surface))
+	    fatal("SDL_CreateRGBSurfaceWithFormat");
+    }
+
+    SDL_Thread *thread = SDL_CreateThread(audio, "audio", &audio_config);
     if (!thread)
 	fprintf(stderr, "unable to create audio thread: %s\n", SDL_GetError());
 
+    struct view view;
+    if (!layout_view(&view, window, snake.bound_x, snake.bound_y))
+	fatal("SDL_GetWindowSurface");
+    bool resized = false;
+
+    struct frame frame = {
+	.snake = &snake,
+	.rewind = &rewind,
+	.replay = &replay,
+	.replaying = replaying,
+	.record = &record,
+	.recording = record_path != NULL,
+	.bot = bot,
+	.walls_surface = walls_surface,
+	.grid_surface = grid_surface,
+	.view = &view,
+	.spectrum = spectrum_bars ? &spectrum : NULL,
+	.spectrum_surface = spectrum_surface,
+    };
+
+    static struct hint hint;
+    if (hints) {
+	if (!hint_start(&hint, snake.bound_x, snake.bound_y))
+	    fatal("SDL_CreateThread");
+	frame.hint = &hint;
+    }
+
+    // built once, every tick runs the same graph again
+    struct job_graph graph;
+    job_graph_init(&graph);
+
+    struct job *sim = job_graph_add(&graph, "sim", sim_job, &frame);
+    job_depends_on(job_graph_add(&graph, "bot", bot_job, &frame), sim);
+    job_depends_on(job_graph_add(&graph, "render", render_job, &frame), sim);
+    job_depends_on(job_graph_add(&graph, "sfx", sfx_job, &frame), sim);
+    job_graph_add(&graph, "spectrum", spectrum_job, &frame);
+
+    struct job_pool pool;
+    if (!job_pool_init(&pool, n_job_workers))
+	return EXIT_FAILURE;
+
     // we make a snake move every target_ms ms
     f64 target_ms = 50;
     f64 accumulated_ms = 0;
@@ -377,6 +849,11 @@ int main(int argc, char *argv[]) {
     // this makes sure we only allow one direction change per snake move
     bool moved_since_last_dir_change = true;
 
+    // how far each tick lands from target_ms after the one before, in us
+    struct hist tick_jitter;
+    hist_clear(&tick_jitter);
+    u64 last_tick_ns = 0;
+
     while (running) {
 	u64 start = SDL_GetPerformanceCounter();
 
@@ -385,38 +862,70 @@ int main(int argc, char *argv[]) {
 	    if (event.type == SDL_QUIT) {
 		running = false;
 
+	    } else if (event.type == SDL_KEYUP) {
+		if (event.key.keysym.scancode == SDL_SCANCODE_R)
+		    frame.rewinding = false;
+
 	    } else if (event.type == SDL_KEYDOWN) {
+		// only pausing, rewinding and the speed are left to the keyboard while a replay or a bot plays
+		SDL_Scancode key = event.key.keysym.scancode;
+		if ((replaying || bot) && key != SDL_SCANCODE_SPACE && key != SDL_SCANCODE_R &&
+			key != SDL_SCANCODE_EQUALS && key != SDL_SCANCODE_KP_PLUS &&
+			key != SDL_SCANCODE_MINUS && key != SDL_SCANCODE_KP_MINUS)
+		    continue;
+
 		switch (event.key.keysym.scancode) {
 		    case SDL_SCANCODE_SPACE:
 			paused = !paused;
+			SDL_AtomicSet(&dsp_params.muffled, paused);
+			// the time spent paused is not jitter
+			last_tick_ns = 0;
+			break;
+
+		    case SDL_SCANCODE_R:
+			frame.rewinding = true;
+			break;
+
+		    // doubles up to TURBO_MAX_SPEED and then goes uncapped, slowing down goes back the same way
+		    case SDL_SCANCODE_EQUALS:
+		    case SDL_SCANCODE_KP_PLUS:
+			if (speed)
+			    speed = speed < TURBO_MAX_SPEED ? speed * 2 : 0;
+			print_speed(speed);
+			break;
+
+		    case SDL_SCANCODE_MINUS:
+		    case SDL_SCANCODE_KP_MINUS:
+			speed = speed == 0 ? TURBO_MAX_SPEED : speed > 1 ? speed / 2 : 1;
+			print_speed(speed);
 			break;
 
 		    case SDL_SCANCODE_UP:
 			if (moved_since_last_dir_change && snake.direction.y != 1) {
 			    moved_since_last_dir_change = false;
 			    snake.direction = DIRECTION_UP;
-		        }
+			}
 			break;
 
 		    case SDL_SCANCODE_DOWN:
 			if (moved_since_last_dir_change && snake.direction.y != -1) {
 			    moved_since_last_dir_change = false;
 			    snake.direction = DIRECTION_DOWN;
-		        }
+			}
 			break;
 
 		    case SDL_SCANCODE_LEFT:
 			if (moved_since_last_dir_change && snake.direction.x != 1) {
 			    moved_since_last_dir_change = false;
 			    snake.direction = DIRECTION_LEFT;
-		        }
+			}
 			break;
 
 		    case SDL_SCANCODE_RIGHT:
 			if (moved_since_last_dir_change && snake.direction.x != -1) {
 			    moved_since_last_dir_change = false;
 			    snake.direction = DIRECTION_RIGHT;
-		        }
+			}
 			break;
 
 		    default:
@@ -424,28 +933,69 @@ int main(int argc, char *argv[]) {
 		}
 
 	    } else if (event.type == SDL_WINDOWEVENT) {
-		if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
-		    window_surface = SDL_GetWindowSurface(window);
-		    SDL_FillRect(window_surface, NULL, 0xFFFFFF);
-		}
+		// dragging the window's edge sends these by the dozen, only the last size matters
+		if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+		    resized = true;
 	    } 
 	}
 
+	// once per frame at most, and the last frame goes straight back up so a paused game does not go blank
+	if (resized) {
+	    resized = false;
+
+	    if (!layout_view(&view, window, snake.bound_x, snake.bound_y))
+		fatal("SDL_GetWindowSurface");
+	    SDL_Rect rect = view.grid_rect;
+	    if (SDL_BlitScaled(grid_surface, NULL, view.window_surface, &rect) < 0)
+		fatal("SDL_BlitScaled");
+	    if (SDL_UpdateWindowSurface(window) < 0)
+		fatal("SDL_UpdateWindowSurface");
+	}
+
 	if (!paused && accumulated_ms > target_ms) {
 	    accumulated_ms -= 50;
 	    moved_since_last_dir_change = true;
 
-	    move_snake(&snake);
+	    u64 tick_ns = now_ns();
+	    if (last_tick_ns) {
+		u64 interval_us = (tick_ns - last_tick_ns) / 1000, target_us = target_ms * 1000;
+		hist_add(&tick_jitter, interval_us > target_us ? interval_us - target_us : target_us - interval_us);
+	    }
+	    last_tick_ns = tick_ns;
+
+	    frame.score_before = snake.score;
+	    frame.died_before = snake.died;
 
-	    if (snake.died) {
-		printf("You died! Score: %d\n", snake.score);
+	    // fast forward runs the frame's other ticks first, the graph then does the last one and draws only that
+	    if (speed != 1)
+		run_turbo_ticks(&frame, speed, tick_ns + target_ms * TURBO_BUDGET * 1000000);
+
+	    job_pool_run(&pool, &graph);
+
+	    // a fast forwarded frame that ran long is not made up for with frames back to back, that would never end
+	    if (speed != 1 && accumulated_ms > target_ms)
+		accumulated_ms = 0;
+
+	    if (frame.replay_over) {
+		printf("Replay over! Score: %d\n", snake.score);
 		return EXIT_SUCCESS;
 	    }
 
-	    draw_snake_to_surface(&snake, grid_surface);
+	    if (frame.render_error)
+		fatal(frame.render_error);
+	    if (frame.spectrum_error)
+		fatal(frame.spectrum_error);
 
-	    if (SDL_BlitScaled(grid_surface, NULL, window_surface, NULL) < 0)
-		fatal("SDL_BlitScaled");
+	    // searched while the next frame waits, it shows up on whichever frame comes after it is done
+	    if (frame.hint)
+		hint_request(frame.hint, &snake, frame.ticks);
+
+	    // the bottom quarter of the grid
+	    if (frame.spectrum) {
+		SDL_Rect rect = view.spectrum_rect;
+		if (SDL_BlitScaled(frame.spectrum_surface, NULL, view.window_surface, &rect) < 0)
+		    fatal("SDL_BlitScaled");
+	    }
 
 	    if (SDL_UpdateWindowSurface(window) < 0)
 		fatal("SDL_UpdateWindowSurface");
@@ -461,7 +1011,55 @@ int main(int argc, char *argv[]) {
 	    accumulated_ms += delta_time;
     }
 
-    printf("Score: %d\n", snake.score);
+    if (!snake.died)
+	printf("Score: %d\n", snake.score);
+
+    print_timing("tick jitter", &sim_config, &tick_jitter);
+
+    SDL_LockAudio();
+    struct audio_timing audio_copy = audio_timing;
+    SDL_UnlockAudio();
+
+    if (audio_copy.busy.total) {
+	print_timing("audio callback jitter", &audio_config, &audio_copy.jitter);
+	print_timing("audio callback time", &audio_config, &audio_copy.busy);
+    }
+
+    if (frame.spectrum_time.total)
+	printf("spectrum: %llu updates, mean %.1fus, p99 %.1fus, max %.1fus\n", (unsigned long long) frame.spectrum_time.total,
+		hist_mean(&frame.spectrum_time) / 1e3, hist_percentile(&frame.spectrum_time, 0.99) / 1e3,
+		frame.spectrum_time.max / 1e3);
+
+    // the effects get a small slice of the callback's period, this is how small
+    if (audio_copy.dsp.total) {
+	f64 p99_us = hist_percentile(&audio_copy.dsp, 0.99) / 1e3;
+	printf("audio effects: %llu blocks, mean %.1fus, p99 %.1fus, max %.1fus, p99 is %.2f%% of the %lluus period\n",
+		(unsigned long long) audio_copy.dsp.total, hist_mean(&audio_copy.dsp) / 1e3, p99_us,
+		audio_copy.dsp.max / 1e3, 100 * p99_us / audio_copy.period_us, (unsigned long long) audio_copy.period_us);
+    }
+
+    if (record_path) {
+	record.score = snake.score;
+	if (!replay_save(&record, record_path))
+	    fprintf(stderr, "unable to save the replay to %s\n", record_path);
+	replay_free(&record);
+    }
+
+    if (scores_path && !replaying)
+	record_score(scores_path, &snake, frame.ticks, seed, record_path);
+
+    job_pool_free(&pool);
+
+    if (frame.hint) {
+	hint_stop(frame.hint);
+	free(frame.hint_path);
+    }
+
+    rewind_free(&rewind);
+    free_snake(&snake);
+
+    if (have_map)
+	map_free(&map);
 
     return EXIT_SUCCESS;
 }
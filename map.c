@@ -0,0 +1,101 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "map.h"
+#include "wire.h"
+
+
+// a whole map with a header we can use, fills in the size
+static bool parse_header(struct level_map *map) {
+    const u8 *data = map->file.data;
+    u64 size = map->file.size;
+
+    if (size < MAP_HEADER_SIZE || get_u32(data) != MAP_MAGIC || get_u16(data + 4) != MAP_VERSION)
+	return false;
+
+    map->width = get_u32(data + 8);
+    map->height = get_u32(data + 12);
+
+    // cells are indexed with a u32 all over the game
+    if (map->width == 0 || map->height == 0 || (u64) map->width * map->height > 0xFFFFFFFFull)
+	return false;
+
+    return size == MAP_HEADER_SIZE + map_words(map->width, map->height) * sizeof(u64);
+}
+
+bool map_load(struct level_map *map, const char *path) {
+    assert(map);
+    assert(path);
+
+    memset(map, 0, sizeof(*map));
+
+    if (!os_map_file(path, &map->file))
+	return false;
+
+    if (!parse_header(map)) {
+	map_free(map);
+	return false;
+    }
+
+    map->walls = (const u64 *) (map->file.data + MAP_HEADER_SIZE);
+
+    // bits past the last cell would turn into pixels and cells that are not there
+    u64 n_cells = (u64) map->width * map->height;
+    if (n_cells % 64 && map->walls[n_cells / 64] >> (n_cells % 64)) {
+	map_free(map);
+	return false;
+    }
+
+    return true;
+}
+
+void map_free(struct level_map *map) {
+    assert(map);
+
+    os_unmap_file(&map->file);
+    memset(map, 0, sizeof(*map));
+}
+
+// fnv-1a over the size and the wall bits
+u64 map_hash(const struct level_map *map) {
+    assert(map);
+
+    u64 hash = 0xCBF29CE484222325ull;
+    u64 n_words = map_words(map->width, map->height);
+
+    u8 size[8];
+    put_u32(size, map->width);
+    put_u32(size + 4, map->height);
+    for (u32 i=0; i<sizeof(size); i++)
+	hash = (hash ^ size[i]) * 0x100000001B3ull;
+
+    // the words are bytes in file order on the little endian machines the maps are read on
+    const u8 *bytes = (const u8 *) map->walls;
+    for (u64 i=0; i<n_words * sizeof(u64); i++)
+	hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+
+    return hash ? hash : 1;
+}
+
+bool map_save(const char *path, u32 width, u32 height, const u64 *walls) {
+    assert(path);
+    assert(walls);
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+	return false;
+
+    u8 header[MAP_HEADER_SIZE] = {0};
+    put_u32(header, MAP_MAGIC);
+    put_u16(header + 4, MAP_VERSION);
+    put_u32(header + 8, width);
+    put_u32(header + 12, height);
+
+    u64 n_words = map_words(width, height);
+
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+	fwrite(walls, sizeof(*walls), n_words, file) == n_words;
+
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "os.h"
+
+// a level's static walls, one bit per cell, so even a huge map is small and loads with a single mapping
+//
+// file layout, little endian:
+//   u32 magic, u16 version, u16 0, u32 width, u32 height, then (width * height + 63) / 64 u64 words
+//   the bit of cell (x, y) is bit (y * width + x) % 64 of word (y * width + x) / 64
+//
+// that is exactly the layout of snake->occupied, so the words are used straight out of the mapping
+// as the obstacles of struct rules, nothing is parsed per cell
+// this reads the words in place, so like the rest of the game it expects a little endian machine
+
+#define MAP_MAGIC 0x4D4B4E53
+#define MAP_VERSION 1
+#define MAP_HEADER_SIZE 16
+
+struct level_map {
+    u32 width, height;
+    // points into the mapping, 8 byte aligned since the header is
+    const u64 *walls;
+
+    struct os_mapped_file file;
+};
+
+static inline u64 map_words(u32 width, u32 height) {
+    return ((u64) width * height + 63) / 64;
+}
+
+// maps the file at path, false if it cannot be mapped or is not a whole map
+bool map_load(struct level_map *map, const char *path);
+
+void map_free(struct level_map *map);
+
+// tells maps apart for replays, see replay.h, never 0
+u64 map_hash(const struct level_map *map);
+
+bool map_save(const char *path, u32 width, u32 height, const u64 *walls);
@@ -0,0 +1,431 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+#include "SDL_thread.h"
+#include "SDL_atomic.h"
+
+#include "types.h"
+#include "map.h"
+
+// builds a maze as a wall map for the game, see map.h, big enough for arenas that rotate maps every round
+//
+// the grid is cut into rooms of corridor x corridor free cells with one cell of wall between them,
+// every room is connected to every other one, so food is always reachable from anywhere
+//
+// the rooms are split into tiles of TILE x TILE, every tile becomes a maze of its own with kruskal's algorithm
+// on a union find small enough to stay in cache, independently and in parallel
+// the tiles are then stitched together by the same algorithm over the much smaller graph of tiles,
+// every tile edge it keeps gets one door somewhere along that border
+// last the rooms are drawn into the bitmap in bands of rows, again in parallel
+//
+// every tile draws from its own generator seeded from the seed and its index, so the same seed gives
+// the same map no matter how many threads built it
+
+
+#define MAX_THREADS 256
+
+#define TILE 64
+
+// 64 rows of any width always end on a word boundary, so bands never share a word of the bitmap
+#define BAND_ROWS 64
+
+// bits of rooms[]
+#define OPEN_EAST 1
+#define OPEN_SOUTH 2
+
+struct maze {
+    u32 width, height;
+    u32 corridor;
+    // chance in percent that a wall the spanning tree does not need gets opened anyway,
+    // a perfect maze has exactly one way between two rooms which makes for short snake games
+    u32 loops;
+    u64 seed;
+
+    u32 rooms_x, rooms_y;
+    u32 tiles_x, tiles_y;
+    // OPEN_ bits of every room, the east and south walls of a room belong to it
+    u8 *rooms;
+
+    u64 *walls;
+
+    SDL_atomic_t next_job;
+};
+
+
+static u64 now_ns(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
+
+    return counter / freq * 1000000000 + counter % freq * 1000000000 / freq;
+}
+
+// the game's generator, but inlined and bounded with a multiply instead of two divisions, shuffling
+// tens of millions of walls spends most of its time here otherwise
+// the bias of the multiply is far below anything visible in a maze
+static inline u32 draw(u64 *state, u32 bound) {
+    u64 z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z = z ^ (z >> 31);
+
+    return (u32) (((z >> 32) * bound) >> 32);
+}
+
+static u32 find_u16(u16 *parent, u32 i) {
+    while (parent[i] != i) {
+	parent[i] = parent[parent[i]];
+	i = parent[i];
+    }
+    return i;
+}
+
+static u32 find_u32(u32 *parent, u32 i) {
+    while (parent[i] != i) {
+	parent[i] = parent[parent[i]];
+	i = parent[i];
+    }
+    return i;
+}
+
+static void build_tile(struct maze *maze, u32 tile) {
+    u32 tx = tile % maze->tiles_x, ty = tile / maze->tiles_x;
+    u32 x0 = tx * TILE, y0 = ty * TILE;
+    u32 w = maze->rooms_x - x0 < TILE ? maze->rooms_x - x0 : TILE;
+    u32 h = maze->rooms_y - y0 < TILE ? maze->rooms_y - y0 : TILE;
+
+    u64 rng = maze->seed ^ ((u64) tile << 32);
+
+    // every edge is a local room index times two, plus one for the wall to the south
+    u16 parent[TILE * TILE];
+    u8 rank[TILE * TILE];
+    u16 edges[TILE * TILE * 2];
+    u32 n_edges = 0;
+
+    for (u32 y=0; y<h; y++) {
+	for (u32 x=0; x<w; x++) {
+	    parent[y * TILE + x] = y * TILE + x;
+	    rank[y * TILE + x] = 0;
+
+	    if (x + 1 < w)
+		edges[n_edges++] = (y * TILE + x) * 2;
+	    if (y + 1 < h)
+		edges[n_edges++] = (y * TILE + x) * 2 + 1;
+	}
+    }
+
+    for (u32 i=n_edges; i>1; i--) {
+	u32 k = draw(&rng, i);
+	u16 tmp = edges[i-1];
+	edges[i-1] = edges[k];
+	edges[k] = tmp;
+    }
+
+    for (u32 i=0; i<n_edges; i++) {
+	u32 a = edges[i] / 2;
+	bool south = edges[i] & 1;
+	u32 b = south ? a + TILE : a + 1;
+
+	u32 ra = find_u16(parent, a), rb = find_u16(parent, b);
+
+	// union by rank keeps the finds short, they are most of the time spent here
+	if (ra != rb) {
+	    if (rank[ra] < rank[rb])
+		parent[ra] = rb;
+	    else
+		parent[rb] = ra;
+	    if (rank[ra] == rank[rb])
+		rank[ra]++;
+	} else if (maze->loops == 0 || draw(&rng, 100) >= maze->loops)
+	    continue;
+
+	u8 *room = &maze->rooms[(u64) (y0 + a / TILE) * maze->rooms_x + x0 + a % TILE];
+	*room |= south ? OPEN_SOUTH : OPEN_EAST;
+    }
+
+    // the walls on the east and south border are the tile's too, stitching opens one per neighbour,
+    // the loops are opened here since this is the only place that sees them all without a lock
+    if (maze->loops == 0)
+	return;
+
+    for (u32 y=0; y<h; y++) {
+	if (x0 + w < maze->rooms_x && draw(&rng, 100) < maze->loops)
+	    maze->rooms[(u64) (y0 + y) * maze->rooms_x + x0 + w - 1] |= OPEN_EAST;
+    }
+    for (u32 x=0; x<w; x++) {
+	if (y0 + h < maze->rooms_y && draw(&rng, 100) < maze->loops)
+	    maze->rooms[(u64) (y0 + h - 1) * maze->rooms_x + x0 + x] |= OPEN_SOUTH;
+    }
+}
+
+// kruskal again, over tiles this time, every kept edge is one door at a random spot of the border
+static void stitch_tiles(struct maze *maze) {
+    u32 n_tiles = maze->tiles_x * maze->tiles_y;
+
+    u32 *parent = malloc(n_tiles * sizeof(*parent));
+    u32 *edges = malloc(n_tiles * 2 * sizeof(*edges));
+    assert(parent && edges);
+
+    u32 n_edges = 0;
+    for (u32 i=0; i<n_tiles; i++) {
+	parent[i] = i;
+
+	if (i % maze->tiles_x + 1 < maze->tiles_x)
+	    edges[n_edges++] = i * 2;
+	if (i / maze->tiles_x + 1 < maze->tiles_y)
+	    edges[n_edges++] = i * 2 + 1;
+    }
+
+    u64 rng = maze->seed;
+
+    for (u32 i=n_edges; i>1; i--) {
+	u32 k = draw(&rng, i);
+	u32 tmp = edges[i-1];
+	edges[i-1] = edges[k];
+	edges[k] = tmp;
+    }
+
+    for (u32 i=0; i<n_edges; i++) {
+	u32 a = edges[i] / 2;
+	bool south = edges[i] & 1;
+	u32 b = south ? a + maze->tiles_x : a + 1;
+
+	u32 ra = find_u32(parent, a), rb = find_u32(parent, b);
+	if (ra == rb)
+	    continue;
+	parent[ra] = rb;
+
+	u32 x0 = a % maze->tiles_x * TILE, y0 = a / maze->tiles_x * TILE;
+
+	if (south) {
+	    u32 w = maze->rooms_x - x0 < TILE ? maze->rooms_x - x0 : TILE;
+	    u32 x = x0 + draw(&rng, w);
+	    maze->rooms[(u64) (y0 + TILE - 1) * maze->rooms_x + x] |= OPEN_SOUTH;
+	} else {
+	    u32 h = maze->rooms_y - y0 < TILE ? maze->rooms_y - y0 : TILE;
+	    u32 y = y0 + draw(&rng, h);
+	    maze->rooms[(u64) y * maze->rooms_x + x0 + TILE - 1] |= OPEN_EAST;
+	}
+    }
+
+    free(parent);
+    free(edges);
+}
+
+static void set_bits(u64 *bits, u64 start, u64 len) {
+    while (len > 0) {
+	u32 shift = start % 64;
+	u64 n = 64 - shift < len ? 64 - shift : len;
+
+	bits[start / 64] |= (n == 64 ? ~0ull : (1ull << n) - 1) << shift;
+
+	start += n;
+	len -= n;
+    }
+}
+
+// opens the cells set in mask, bit 0 being cell start
+// the second word is only touched when some of mask lands in it, it can belong to the next band otherwise
+static inline void clear_cells(u64 *bits, u64 start, u64 mask) {
+    u32 shift = start % 64;
+
+    bits[start / 64] &= ~(mask << shift);
+    if (shift && mask >> (64 - shift))
+	bits[start / 64 + 1] &= ~(mask >> (64 - shift));
+}
+
+// draws rows [y0, y1), which start and end on word boundaries so bands never share a word
+static void draw_band(struct maze *maze, u32 y0, u32 y1) {
+    u32 pitch = maze->corridor + 1;
+    u64 width = maze->width;
+
+    // a room and the door east of it, the doors of the last rooms of a row or column are never open
+    u64 room_mask = (1ull << maze->corridor) - 1;
+
+    set_bits(maze->walls, y0 * width, (u64) (y1 - y0) * width);
+
+    for (u32 y=y0; y<y1; y++) {
+	u32 ry = y / pitch;
+	u64 row = y * width;
+
+	// the outer wall, the wall row under the last rooms and anything below it stay solid
+	if (y == 0 || ry >= maze->rooms_y)
+	    continue;
+
+	if (y % pitch == 0) {
+	    // wall row between rooms ry - 1 and ry, open where the room above opens south
+	    const u8 *above = &maze->rooms[(u64) (ry - 1) * maze->rooms_x];
+
+	    // no branch on the room bits, whether a wall is open is as good as a coin flip
+	    for (u32 rx=0; rx<maze->rooms_x; rx++)
+		clear_cells(maze->walls, row + rx * pitch + 1, room_mask * (above[rx] >> 1 & 1));
+	    continue;
+	}
+
+	// a row through rooms, every room and its east door if it has one
+	const u8 *rooms = &maze->rooms[(u64) ry * maze->rooms_x];
+
+	for (u32 rx=0; rx<maze->rooms_x; rx++)
+	    clear_cells(maze->walls, row + rx * pitch + 1, room_mask | (u64) (rooms[rx] & OPEN_EAST) << maze->corridor);
+    }
+}
+
+static int tile_thread(void *data) {
+    struct maze *maze = data;
+    u32 n_tiles = maze->tiles_x * maze->tiles_y;
+
+    while (true) {
+	u32 tile = SDL_AtomicAdd(&maze->next_job, 1);
+	if (tile >= n_tiles)
+	    break;
+
+	build_tile(maze, tile);
+    }
+
+    return 0;
+}
+
+static int draw_thread(void *data) {
+    struct maze *maze = data;
+
+    while (true) {
+	u64 y0 = (u64) SDL_AtomicAdd(&maze->next_job, 1) * BAND_ROWS;
+	if (y0 >= maze->height)
+	    break;
+
+	u32 y1 = y0 + BAND_ROWS < maze->height ? y0 + BAND_ROWS : maze->height;
+	draw_band(maze, y0, y1);
+    }
+
+    return 0;
+}
+
+// runs fn on n_threads threads and waits for them, jobs are handed out through next_job
+static bool run_threads(struct maze *maze, SDL_ThreadFunction fn, u32 n_threads) {
+    SDL_Thread *threads[MAX_THREADS];
+
+    SDL_AtomicSet(&maze->next_job, 0);
+
+    for (u32 i=0; i<n_threads; i++) {
+	threads[i] = SDL_CreateThread(fn, "mazegen", maze);
+	if (!threads[i]) {
+	    fprintf(stderr, "unable to create thread: %s\n", SDL_GetError());
+	    return false;
+	}
+    }
+
+    for (u32 i=0; i<n_threads; i++)
+	SDL_WaitThread(threads[i], NULL);
+
+    return true;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s --out FILE [options]\n"
+	    "  --out FILE        where to write the map\n"
+	    "  --size WxH        grid size in cells, up to 16384x16384 (default 256x256)\n"
+	    "  --corridor N      width of the corridors in cells, up to 32 (default 3)\n"
+	    "  --loops PCT       chance of opening a wall the maze does not need (default 10)\n"
+	    "  --seed N          (default 1)\n"
+	    "  --threads N       worker threads (default: cpu count)\n",
+	    prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    struct maze maze = {0};
+    maze.width = maze.height = 256;
+    maze.corridor = 3;
+    maze.loops = 10;
+    maze.seed = 1;
+    u32 n_threads = SDL_GetCPUCount();
+    const char *out = NULL;
+
+    for (int i=1; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--out") == 0)
+	    out = val;
+	else if (strcmp(arg, "--size") == 0) {
+	    char *end;
+	    maze.width = strtoul(val, &end, 10);
+	    if (*end != 'x')
+		usage(argv[0]);
+	    maze.height = strtoul(end+1, NULL, 10);
+	} else if (strcmp(arg, "--corridor") == 0)
+	    maze.corridor = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--loops") == 0)
+	    maze.loops = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--seed") == 0)
+	    maze.seed = strtoull(val, NULL, 10);
+	else if (strcmp(arg, "--threads") == 0)
+	    n_threads = strtoul(val, NULL, 10);
+	else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    if (n_threads == 0)
+	n_threads = 1;
+    if (n_threads > MAX_THREADS)
+	n_threads = MAX_THREADS;
+    if (!out || maze.corridor == 0 || maze.corridor > 32 || maze.loops > 100 || maze.width > 16384 || maze.height > 16384)
+	usage(argv[0]);
+
+    maze.rooms_x = maze.width > 0 ? (maze.width - 1) / (maze.corridor + 1) : 0;
+    maze.rooms_y = maze.height > 0 ? (maze.height - 1) / (maze.corridor + 1) : 0;
+    if (maze.rooms_x == 0 || maze.rooms_y == 0) {
+	fprintf(stderr, "a %ux%u grid has no room for a corridor of %u\n", maze.width, maze.height, maze.corridor);
+	return EXIT_FAILURE;
+    }
+
+    maze.tiles_x = (maze.rooms_x + TILE - 1) / TILE;
+    maze.tiles_y = (maze.rooms_y + TILE - 1) / TILE;
+
+    maze.rooms = calloc((u64) maze.rooms_x * maze.rooms_y, 1);
+    maze.walls = malloc(map_words(maze.width, maze.height) * sizeof(*maze.walls));
+    assert(maze.rooms && maze.walls);
+
+    // the last word of the map has to be zero past the last cell, the bands only ever touch cells
+    maze.walls[map_words(maze.width, maze.height) - 1] = 0;
+
+    u64 start = now_ns();
+
+    if (!run_threads(&maze, tile_thread, n_threads))
+	return EXIT_FAILURE;
+
+    u64 tiled = now_ns();
+
+    stitch_tiles(&maze);
+
+    u64 stitched = now_ns();
+
+    if (!run_threads(&maze, draw_thread, n_threads))
+	return EXIT_FAILURE;
+
+    u64 drawn = now_ns();
+
+    printf("%ux%u, %ux%u rooms in %u tiles on %u threads: tiles %.1fms, stitching %.1fms, drawing %.1fms\n",
+	    maze.width, maze.height, maze.rooms_x, maze.rooms_y, maze.tiles_x * maze.tiles_y, n_threads,
+	    (tiled - start) / 1e6, (stitched - tiled) / 1e6, (drawn - stitched) / 1e6);
+
+    if (!map_save(out, maze.width, maze.height, maze.walls)) {
+	fprintf(stderr, "unable to write %s\n", out);
+	return EXIT_FAILURE;
+    }
+
+    free(maze.rooms);
+    free(maze.walls);
+
+    return EXIT_SUCCESS;
+}
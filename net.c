@@ -0,0 +1,295 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "net.h"
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#define MAX_POLL 1024
+
+
+#ifdef _WIN32
+
+static bool would_block(void) {
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+const char *net_error(void) {
+    static char buf[32];
+    snprintf(buf, sizeof(buf), "winsock error %d", WSAGetLastError());
+    return buf;
+}
+
+bool net_init(void) {
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+}
+
+void net_close(net_socket sock) {
+    closesocket(sock);
+}
+
+static bool set_nonblocking(net_socket sock) {
+    u_long on = 1;
+    return ioctlsocket(sock, FIONBIO, &on) == 0;
+}
+
+#else
+
+static bool would_block(void) {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS;
+}
+
+const char *net_error(void) {
+    return strerror(errno);
+}
+
+bool net_init(void) {
+    return true;
+}
+
+void net_close(net_socket sock) {
+    close(sock);
+}
+
+static bool set_nonblocking(net_socket sock) {
+    int flags = fcntl(sock, F_GETFL, 0);
+    return flags >= 0 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+#endif
+
+
+// fills addr from "tcp:[host:]port" or "unix:path", returns the address length or 0 if it does not parse
+static u32 parse_address(const char *address, struct sockaddr_storage *addr, int *family) {
+    assert(address);
+
+    memset(addr, 0, sizeof(*addr));
+
+    if (strncmp(address, "tcp:", 4) == 0) {
+	struct sockaddr_in *in = (struct sockaddr_in *) addr;
+	const char *host = "127.0.0.1";
+	const char *port = address + 4;
+
+	char host_buf[64];
+	const char *colon = strrchr(port, ':');
+	if (colon) {
+	    u32 len = colon - port;
+	    if (len >= sizeof(host_buf))
+		return 0;
+
+	    memcpy(host_buf, port, len);
+	    host_buf[len] = 0;
+	    host = host_buf;
+	    port = colon + 1;
+	}
+
+	in->sin_family = AF_INET;
+	in->sin_port = htons(atoi(port));
+	in->sin_addr.s_addr = inet_addr(host);
+
+	*family = AF_INET;
+	return sizeof(*in);
+    }
+
+#ifndef _WIN32
+    if (strncmp(address, "unix:", 5) == 0) {
+	struct sockaddr_un *un = (struct sockaddr_un *) addr;
+	const char *path = address + 5;
+
+	if (strlen(path) >= sizeof(un->sun_path))
+	    return 0;
+
+	un->sun_family = AF_UNIX;
+	strcpy(un->sun_path, path);
+
+	*family = AF_UNIX;
+	return sizeof(*un);
+    }
+#endif
+
+    return 0;
+}
+
+// small frames go out right away instead of waiting for more data
+static void set_nodelay(net_socket sock, int family) {
+    if (family != AF_INET)
+	return;
+
+    int on = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *) &on, sizeof(on));
+}
+
+net_socket net_listen(const char *address) {
+    struct sockaddr_storage addr;
+    int family;
+
+    u32 addr_len = parse_address(address, &addr, &family);
+    if (!addr_len) {
+	fprintf(stderr, "bad address %s\n", address);
+	return NET_INVALID_SOCKET;
+    }
+
+    net_socket sock = socket(family, SOCK_STREAM, 0);
+    if (sock == NET_INVALID_SOCKET)
+	return NET_INVALID_SOCKET;
+
+#ifndef _WIN32
+    // a socket file left over from an earlier run would make bind fail
+    if (family == AF_UNIX)
+	unlink(((struct sockaddr_un *) &addr)->sun_path);
+#endif
+
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *) &on, sizeof(on));
+
+    if (bind(sock, (struct sockaddr *) &addr, addr_len) != 0 || listen(sock, 64) != 0 || !set_nonblocking(sock)) {
+	net_close(sock);
+	return NET_INVALID_SOCKET;
+    }
+
+    return sock;
+}
+
+net_socket net_accept(net_socket listener) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+
+    net_socket sock = accept(listener, (struct sockaddr *) &addr, &addr_len);
+    if (sock == NET_INVALID_SOCKET)
+	return NET_INVALID_SOCKET;
+
+    if (!set_nonblocking(sock)) {
+	net_close(sock);
+	return NET_INVALID_SOCKET;
+    }
+
+    set_nodelay(sock, addr.ss_family);
+
+    return sock;
+}
+
+net_socket net_connect(const char *address) {
+    struct sockaddr_storage addr;
+    int family;
+
+    u32 addr_len = parse_address(address, &addr, &family);
+    if (!addr_len) {
+	fprintf(stderr, "bad address %s\n", address);
+	return NET_INVALID_SOCKET;
+    }
+
+    net_socket sock = socket(family, SOCK_STREAM, 0);
+    if (sock == NET_INVALID_SOCKET)
+	return NET_INVALID_SOCKET;
+
+    if (connect(sock, (struct sockaddr *) &addr, addr_len) != 0 || !set_nonblocking(sock)) {
+	net_close(sock);
+	return NET_INVALID_SOCKET;
+    }
+
+    set_nodelay(sock, family);
+
+    return sock;
+}
+
+u32 net_local_port(net_socket sock) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+
+    if (getsockname(sock, (struct sockaddr *) &addr, &addr_len) != 0 || addr.sin_family != AF_INET)
+	return 0;
+
+    return ntohs(addr.sin_port);
+}
+
+s32 net_recv(net_socket sock, void *buf, u32 len) {
+    s32 n = recv(sock, buf, len, 0);
+
+    if (n > 0)
+	return n;
+    if (n == 0)
+	return NET_CLOSED;
+
+    return would_block() ? NET_WOULD_BLOCK : NET_ERROR;
+}
+
+#ifdef _WIN32
+#define POLL WSAPoll
+typedef WSAPOLLFD pollfd_t;
+#define SEND_FLAGS 0
+#else
+#define POLL poll
+typedef struct pollfd pollfd_t;
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+#endif
+
+bool net_send_all(net_socket sock, const void *buf, u32 len, s32 timeout_ms) {
+    const u8 *pos = buf;
+
+    while (len > 0) {
+	s32 n = send(sock, (const char *) pos, len, SEND_FLAGS);
+
+	if (n > 0) {
+	    pos += n;
+	    len -= n;
+	    continue;
+	}
+
+	if (n < 0 && !would_block())
+	    return false;
+
+	pollfd_t pfd = { .fd = sock, .events = POLLOUT };
+	if (POLL(&pfd, 1, timeout_ms) <= 0)
+	    return false;
+    }
+
+    return true;
+}
+
+s32 net_poll_readable(const net_socket *socks, u32 n, bool *ready, s32 timeout_ms) {
+    assert(n <= MAX_POLL);
+
+    pollfd_t pfds[MAX_POLL];
+
+    for (u32 i=0; i<n; i++) {
+	pfds[i].fd = socks[i];
+	pfds[i].events = POLLIN;
+	pfds[i].revents = 0;
+    }
+
+    s32 count = POLL(pfds, n, timeout_ms);
+    if (count < 0) {
+#ifdef _WIN32
+	return -1;
+#else
+	// a signal is not an error, the caller just sees nothing ready and loops on its own deadline
+	if (errno != EINTR)
+	    return -1;
+	count = 0;
+#endif
+    }
+
+    for (u32 i=0; i<n; i++)
+	ready[i] = (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+
+    return count;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "types.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+typedef SOCKET net_socket;
+#define NET_INVALID_SOCKET INVALID_SOCKET
+#else
+typedef int net_socket;
+#define NET_INVALID_SOCKET (-1)
+#endif
+
+// return values of net_recv besides the byte count
+#define NET_CLOSED 0
+#define NET_WOULD_BLOCK (-1)
+#define NET_ERROR (-2)
+
+// addresses look like "tcp:5555" (always bound to loopback), "tcp:127.0.0.1:5555" or "unix:/tmp/snake.sock"
+// every socket handed out is non-blocking, waiting is done with net_poll and a timeout
+
+// must be called once before anything else
+bool net_init(void);
+
+net_socket net_listen(const char *address);
+
+// returns NET_INVALID_SOCKET if nobody is waiting
+net_socket net_accept(net_socket listener);
+
+// blocks until connected, the returned socket is non-blocking like every other one
+net_socket net_connect(const char *address);
+
+void net_close(net_socket sock);
+
+// port a tcp socket ended up bound to, for listening on port 0 and telling others where to connect
+u32 net_local_port(net_socket sock);
+
+// > 0 bytes read, NET_CLOSED, NET_WOULD_BLOCK or NET_ERROR
+s32 net_recv(net_socket sock, void *buf, u32 len);
+
+// sends everything, waiting at most timeout_ms for the socket to drain when its buffer is full
+bool net_send_all(net_socket sock, const void *buf, u32 len, s32 timeout_ms);
+
+// waits until one of socks is readable or timeout_ms passed (-1 waits forever)
+// ready[i] is set for readable sockets, returns how many are, or -1 on error
+s32 net_poll_readable(const net_socket *socks, u32 n, bool *ready, s32 timeout_ms);
+
+// text of the last socket error
+const char *net_error(void);
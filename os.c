@@ -0,0 +1,437 @@
+// cpu_set_t and sched_setaffinity
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "os.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+
+// missing from older mingw headers
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+
+// growing array of paths shared by both versions of os_list_dir
+struct path_list {
+    char **paths;
+    u32 count, cap;
+};
+
+static bool ends_with(const char *name, const char *suffix) {
+    u32 name_len = strlen(name), suffix_len = strlen(suffix);
+
+    return name_len >= suffix_len && strcmp(name + name_len - suffix_len, suffix) == 0;
+}
+
+static void add_path(struct path_list *list, const char *dir, const char *name) {
+    if (list->count + 1 >= list->cap) {
+	list->cap = list->cap ? list->cap * 2 : 64;
+	list->paths = realloc(list->paths, list->cap * sizeof(*list->paths));
+	assert(list->paths);
+    }
+
+    u32 len = strlen(dir) + 1 + strlen(name) + 1;
+    char *path = malloc(len);
+    assert(path);
+    snprintf(path, len, "%s/%s", dir, name);
+
+    list->paths[list->count++] = path;
+    list->paths[list->count] = NULL;
+}
+
+void os_free_paths(char **paths) {
+    if (!paths)
+	return;
+
+    for (char **p = paths; *p; p++)
+	free(*p);
+
+    free(paths);
+}
+
+
+#ifdef _WIN32
+
+bool os_spawn(char *const argv[], struct os_process *process) {
+    assert(argv && argv[0]);
+    assert(process);
+
+    // windows wants one command line, every argument is quoted so paths with spaces survive
+    char cmdline[4096];
+    u32 len = 0;
+
+    for (u32 i=0; argv[i]; i++) {
+	int n = snprintf(cmdline + len, sizeof(cmdline) - len, "%s\"%s\"", i ? " " : "", argv[i]);
+	if (n < 0 || (u32) n >= sizeof(cmdline) - len)
+	    return false;
+	len += n;
+    }
+
+    STARTUPINFOA startup;
+    PROCESS_INFORMATION info;
+
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+
+    if (!CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info))
+	return false;
+
+    CloseHandle(info.hThread);
+    process->handle = info.hProcess;
+
+    return true;
+}
+
+bool os_process_exited(struct os_process *process, int *exit_code) {
+    assert(process);
+
+    if (WaitForSingleObject(process->handle, 0) != WAIT_OBJECT_0)
+	return false;
+
+    DWORD code;
+    GetExitCodeProcess(process->handle, &code);
+    CloseHandle(process->handle);
+
+    if (exit_code)
+	*exit_code = code;
+
+    return true;
+}
+
+void os_process_kill(struct os_process *process) {
+    assert(process);
+
+    TerminateProcess(process->handle, 1);
+}
+
+bool os_map_file(const char *path, struct os_mapped_file *map) {
+    assert(path);
+    assert(map);
+
+    memset(map, 0, sizeof(*map));
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+	return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+	CloseHandle(file);
+	return false;
+    }
+
+    map->file = file;
+    map->size = size.QuadPart;
+
+    if (map->size == 0)
+	return true;
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+	CloseHandle(file);
+	return false;
+    }
+
+    map->mapping = mapping;
+    map->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!map->data) {
+	CloseHandle(mapping);
+	CloseHandle(file);
+	return false;
+    }
+
+    return true;
+}
+
+void os_unmap_file(struct os_mapped_file *map) {
+    assert(map);
+
+    if (map->data)
+	UnmapViewOfFile(map->data);
+    if (map->mapping)
+	CloseHandle(map->mapping);
+    if (map->file)
+	CloseHandle(map->file);
+
+    memset(map, 0, sizeof(*map));
+}
+
+char **os_list_dir(const char *dir, const char *suffix, u32 *count) {
+    assert(dir);
+    assert(suffix);
+
+    char pattern[MAX_PATH];
+    snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(pattern, &entry);
+    if (find == INVALID_HANDLE_VALUE)
+	return NULL;
+
+    struct path_list list = {0};
+
+    do {
+	if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && ends_with(entry.cFileName, suffix))
+	    add_path(&list, dir, entry.cFileName);
+    } while (FindNextFileA(find, &entry));
+
+    FindClose(find);
+
+    if (!list.paths) {
+	list.paths = calloc(1, sizeof(*list.paths));
+	assert(list.paths);
+    }
+
+    if (count)
+	*count = list.count;
+
+    return list.paths;
+}
+
+bool os_write_all(int fd, const void *buf, u32 len) {
+    const u8 *p = buf;
+
+    while (len > 0) {
+	int n = _write(fd, p, len);
+	if (n <= 0)
+	    return false;
+
+	p += n;
+	len -= n;
+    }
+
+    return true;
+}
+
+bool os_sync_file(FILE *file) {
+    assert(file);
+
+    return fflush(file) == 0 && _commit(_fileno(file)) == 0;
+}
+
+bool os_replace_file(const char *from, const char *to) {
+    assert(from && to);
+
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+void os_enable_ansi(int fd) {
+    HANDLE handle = (HANDLE) _get_osfhandle(fd);
+
+    DWORD mode;
+    if (GetConsoleMode(handle, &mode))
+	SetConsoleMode(handle, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+}
+
+bool os_pin_thread(u32 cpu) {
+    if (cpu >= sizeof(DWORD_PTR) * 8)
+	return false;
+
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu) != 0;
+}
+
+bool os_set_realtime(void) {
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+}
+
+#else
+
+bool os_spawn(char *const argv[], struct os_process *process) {
+    assert(argv && argv[0]);
+    assert(process);
+
+    pid_t pid = fork();
+    if (pid < 0)
+	return false;
+
+    if (pid == 0) {
+	execvp(argv[0], argv);
+	fprintf(stderr, "unable to run %s\n", argv[0]);
+	_exit(127);
+    }
+
+    process->pid = pid;
+
+    return true;
+}
+
+bool os_process_exited(struct os_process *process, int *exit_code) {
+    assert(process);
+
+    int status;
+    if (waitpid(process->pid, &status, WNOHANG) != process->pid)
+	return false;
+
+    if (exit_code)
+	*exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    return true;
+}
+
+void os_process_kill(struct os_process *process) {
+    assert(process);
+
+    kill(process->pid, SIGKILL);
+}
+
+bool os_map_file(const char *path, struct os_mapped_file *map) {
+    assert(path);
+    assert(map);
+
+    memset(map, 0, sizeof(*map));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+	return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+	close(fd);
+	return false;
+    }
+
+    map->size = st.st_size;
+
+    if (map->size > 0) {
+	void *data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+	    close(fd);
+	    return false;
+	}
+
+	madvise(data, map->size, MADV_SEQUENTIAL);
+	map->data = data;
+    }
+
+    // the mapping keeps the file alive on its own
+    close(fd);
+
+    return true;
+}
+
+void os_unmap_file(struct os_mapped_file *map) {
+    assert(map);
+
+    if (map->data)
+	munmap((void *) map->data, map->size);
+
+    memset(map, 0, sizeof(*map));
+}
+
+char **os_list_dir(const char *dir, const char *suffix, u32 *count) {
+    assert(dir);
+    assert(suffix);
+
+    DIR *d = opendir(dir);
+    if (!d)
+	return NULL;
+
+    struct path_list list = {0};
+
+    struct dirent *entry;
+    while ((entry = readdir(d))) {
+	if (entry->d_name[0] != '.' && ends_with(entry->d_name, suffix))
+	    add_path(&list, dir, entry->d_name);
+    }
+
+    closedir(d);
+
+    // an empty directory still gets an array, NULL is only for errors
+    if (!list.paths) {
+	list.paths = calloc(1, sizeof(*list.paths));
+	assert(list.paths);
+    }
+
+    if (count)
+	*count = list.count;
+
+    return list.paths;
+}
+
+bool os_write_all(int fd, const void *buf, u32 len) {
+    const u8 *p = buf;
+
+    while (len > 0) {
+	ssize_t n = write(fd, p, len);
+	if (n < 0 && errno == EINTR)
+	    continue;
+	if (n <= 0)
+	    return false;
+
+	p += n;
+	len -= n;
+    }
+
+    return true;
+}
+
+bool os_sync_file(FILE *file) {
+    assert(file);
+
+    if (fflush(file) != 0)
+	return false;
+
+    while (fsync(fileno(file)) != 0)
+	if (errno != EINTR)
+	    return false;
+
+    return true;
+}
+
+bool os_replace_file(const char *from, const char *to) {
+    assert(from && to);
+
+    return rename(from, to) == 0;
+}
+
+void os_enable_ansi(int fd) {
+    (void) fd;
+}
+
+bool os_pin_thread(u32 cpu) {
+#ifdef __linux__
+    if (cpu >= CPU_SETSIZE)
+	return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    // no portable way to pin on the other unixes, macos only takes hints
+    (void) cpu;
+    return false;
+#endif
+}
+
+bool os_set_realtime(void) {
+    // the lowest fifo priority is already above every normal thread, no need to fight the kernel's own threads
+    struct sched_param param = { .sched_priority = sched_get_priority_min(SCHED_FIFO) };
+
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+#endif
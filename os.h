@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "types.h"
+
+// the few things SDL does not wrap for us, with a windows and a posix version of each
+
+
+struct os_process {
+#ifdef _WIN32
+    void *handle;
+#else
+    int pid;
+#endif
+};
+
+// starts argv[0] with the given arguments, argv is NULL terminated
+bool os_spawn(char *const argv[], struct os_process *process);
+
+// true once the process is gone, exit_code is then its exit status or -1 if it was killed
+bool os_process_exited(struct os_process *process, int *exit_code);
+
+void os_process_kill(struct os_process *process);
+
+
+struct os_mapped_file {
+    const u8 *data;
+    u64 size;
+
+#ifdef _WIN32
+    void *file, *mapping;
+#endif
+};
+
+// maps the whole file read only, an empty file maps to data == NULL and size 0
+bool os_map_file(const char *path, struct os_mapped_file *map);
+
+void os_unmap_file(struct os_mapped_file *map);
+
+// paths of the files in dir whose names end in suffix, not recursive
+// returns a NULL terminated array that is freed with os_free_paths, or NULL if dir cannot be read
+char **os_list_dir(const char *dir, const char *suffix, u32 *count);
+
+void os_free_paths(char **paths);
+
+
+// writes all of buf to fd, retrying short writes, the fd is 1 for stdout
+bool os_write_all(int fd, const void *buf, u32 len);
+
+// flushes file and waits until what it holds is on the disk, not just in the os cache
+bool os_sync_file(FILE *file);
+
+// renames from to to, replacing to if it exists, in one step as far as a reader can tell
+bool os_replace_file(const char *from, const char *to);
+
+// makes the console behind fd understand ansi escape sequences, only needed on windows
+void os_enable_ansi(int fd);
+
+
+// pins the calling thread to one cpu, false if the os does not let us
+bool os_pin_thread(u32 cpu);
+
+// real time scheduling for the calling thread, SCHED_FIFO on posix and time critical on windows
+// posix only allows it with privileges or an rtprio limit, false when it is refused
+bool os_set_realtime(void);
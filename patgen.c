@@ -0,0 +1,161 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+#include "SDL_thread.h"
+#include "SDL_atomic.h"
+
+#include "types.h"
+#include "pattern.h"
+
+// works out the entry of every 5x5 pattern for the pattern bot, see pattern.h, and writes the table
+//
+// every key is independent, threads take chunks of keys off a counter until there are none left
+// each thread counts its own classes so nothing is shared but the counter
+
+
+#define MAX_THREADS 256
+
+#define CHUNK 65536
+
+struct generator {
+    u8 *entries;
+    SDL_atomic_t next_chunk;
+
+    // per thread, [move][class]
+    u64 counts[MAX_THREADS][3][4];
+};
+
+struct worker {
+    struct generator *gen;
+    u32 index;
+};
+
+
+static u64 now_ns(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
+
+    return counter / freq * 1000000000 + counter % freq * 1000000000 / freq;
+}
+
+static int generate_thread(void *data) {
+    struct worker *worker = data;
+    struct generator *gen = worker->gen;
+    // counted locally, neighbouring threads' counts share cache lines
+    u64 counts[3][4] = {{0}};
+
+    while (true) {
+	u32 key = (u32) SDL_AtomicAdd(&gen->next_chunk, 1) * CHUNK;
+	if (key >= PATTERN_KEYS)
+	    break;
+
+	for (u32 end = key + CHUNK; key < end; key++) {
+	    u8 entry = pattern_classify(key);
+	    gen->entries[key] = entry;
+
+	    for (u32 move=MOVE_LEFT; move<=MOVE_RIGHT; move++)
+		counts[move][pattern_move_class(entry, move)]++;
+	}
+    }
+
+    memcpy(gen->counts[worker->index], counts, sizeof(counts));
+
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s --out FILE [options]\n"
+	    "  --out FILE        where to write the table\n"
+	    "  --threads N       worker threads (default: cpu count)\n",
+	    prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    u32 n_threads = SDL_GetCPUCount();
+    const char *out = NULL;
+
+    for (int i=1; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--out") == 0)
+	    out = val;
+	else if (strcmp(arg, "--threads") == 0)
+	    n_threads = strtoul(val, NULL, 10);
+	else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    if (n_threads == 0)
+	n_threads = 1;
+    if (n_threads > MAX_THREADS)
+	n_threads = MAX_THREADS;
+    if (!out)
+	usage(argv[0]);
+
+    struct generator *gen = calloc(1, sizeof(*gen));
+    assert(gen);
+    gen->entries = malloc(PATTERN_KEYS);
+    assert(gen->entries);
+
+    struct worker workers[MAX_THREADS];
+    SDL_Thread *threads[MAX_THREADS];
+
+    u64 start = now_ns();
+
+    for (u32 i=0; i<n_threads; i++) {
+	workers[i].gen = gen;
+	workers[i].index = i;
+
+	threads[i] = SDL_CreateThread(generate_thread, "patgen", &workers[i]);
+	if (!threads[i]) {
+	    fprintf(stderr, "unable to create thread: %s\n", SDL_GetError());
+	    return EXIT_FAILURE;
+	}
+    }
+
+    for (u32 i=0; i<n_threads; i++)
+	SDL_WaitThread(threads[i], NULL);
+
+    u64 elapsed = now_ns() - start;
+
+    printf("%u patterns on %u threads in %.1fms, %.1fns each\n", PATTERN_KEYS, n_threads,
+	    elapsed / 1e6, (double) elapsed / PATTERN_KEYS);
+
+    static const char *move_names[3] = { "left", "straight", "right" };
+    printf("%-10s %10s %10s %10s %10s\n", "move", "fatal", "pocket", "narrow", "open");
+
+    for (u32 move=MOVE_LEFT; move<=MOVE_RIGHT; move++) {
+	u64 total[4] = {0};
+	for (u32 t=0; t<n_threads; t++)
+	    for (u32 c=0; c<4; c++)
+		total[c] += gen->counts[t][move][c];
+
+	printf("%-10s", move_names[move]);
+	for (u32 c=0; c<4; c++)
+	    printf(" %9.2f%%", 100.0 * total[c] / PATTERN_KEYS);
+	printf("\n");
+    }
+
+    if (!pattern_save(out, gen->entries)) {
+	fprintf(stderr, "unable to write %s\n", out);
+	return EXIT_FAILURE;
+    }
+
+    free(gen->entries);
+    free(gen);
+
+    return EXIT_SUCCESS;
+}
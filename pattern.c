@@ -0,0 +1,182 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "pattern.h"
+#include "wire.h"
+
+
+#define WINDOW 5
+#define WINDOW_CELLS (WINDOW * WINDOW)
+#define WINDOW_MASK ((1u << WINDOW_CELLS) - 1)
+#define CENTER (WINDOW_CELLS / 2)
+
+// columns of a 5x5 mask, for shifting sideways without wrapping into the next row
+#define COLUMN_LEFT 0x0108421u
+#define COLUMN_RIGHT (COLUMN_LEFT << (WINDOW - 1))
+#define BORDER (0x1Fu | 0x1Fu << 20 | COLUMN_LEFT | COLUMN_RIGHT)
+
+static const u8 *table;
+
+
+// the 5x5 cells around the head as the grid has them, bit (dy + 2) * 5 + dx + 2
+static u32 window_bits(const struct snake *snake) {
+    s32 hx = snake->head->pos.x, hy = snake->head->pos.y;
+    s32 w = snake->bound_x, h = snake->bound_y;
+    u32 bits = 0;
+
+    // away from the edges every row is one shift out of the bitmap, or two when it straddles a word
+    if (hx >= 2 && hy >= 2 && hx + 2 < w && hy + 2 < h) {
+	for (u32 row=0; row<WINDOW; row++) {
+	    u64 cell = (u64) (hy - 2 + row) * w + hx - 2;
+	    u64 word = snake->occupied[cell / 64] >> (cell % 64);
+
+	    if (cell % 64 > 64 - WINDOW)
+		word |= snake->occupied[cell / 64 + 1] << (64 - cell % 64);
+
+	    bits |= (u32) (word & 0x1F) << (row * WINDOW);
+	}
+
+	return bits;
+    }
+
+    // near an edge every cell either wraps or falls off the grid, which counts as taken
+    for (u32 row=0; row<WINDOW; row++) {
+	for (u32 col=0; col<WINDOW; col++) {
+	    s32 x = hx - 2 + (s32) col, y = hy - 2 + (s32) row;
+	    bool off = x < 0 || y < 0 || x >= w || y >= h;
+
+	    if (off && snake->walls) {
+		bits |= 1u << (row * WINDOW + col);
+		continue;
+	    }
+
+	    struct vec2 pos = { .x = (x % w + w) % w, .y = (y % h + h) % h };
+	    if (cell_occupied(snake, pos))
+		bits |= 1u << (row * WINDOW + col);
+	}
+    }
+
+    return bits;
+}
+
+u32 pattern_key(const struct snake *snake) {
+    assert(snake);
+
+    u32 bits = window_bits(snake);
+
+    // forward and right of the snake in grid terms, cell (i, j) of the turned window is
+    // (i - 2) * right + (2 - j) * forward away from the head
+    struct vec2 f = snake->direction;
+    struct vec2 r = relative_direction(f, MOVE_RIGHT);
+
+    u32 key = 0, k = 0;
+    for (s32 j=0; j<WINDOW; j++) {
+	for (s32 i=0; i<WINDOW; i++) {
+	    if (j * WINDOW + i == CENTER)
+		continue;
+
+	    s32 dx = (i - 2) * r.x + (2 - j) * f.x;
+	    s32 dy = (i - 2) * r.y + (2 - j) * f.y;
+
+	    key |= (bits >> ((dy + 2) * WINDOW + dx + 2) & 1) << k++;
+	}
+    }
+
+    return key;
+}
+
+static u32 popcount(u32 v) {
+    u32 n = 0;
+    for (; v; v &= v - 1)
+	n++;
+    return n;
+}
+
+// every free cell reachable from start, all 25 cells move at once
+static u32 flood(u32 start, u32 free) {
+    u32 region = start;
+
+    while (true) {
+	u32 next = region | (region << 1 & ~COLUMN_LEFT) | (region >> 1 & ~COLUMN_RIGHT) |
+	    region << WINDOW | region >> WINDOW;
+	next &= free;
+
+	if (next == region)
+	    return region;
+	region = next;
+    }
+}
+
+u8 pattern_classify(u32 key) {
+    assert(key < PATTERN_KEYS);
+
+    // back to 25 bits, the head's cell is taken by the head
+    u32 taken = (key & ((1u << CENTER) - 1)) | 1u << CENTER | (key >> CENTER) << (CENTER + 1);
+    u32 free = ~taken & WINDOW_MASK;
+
+    // cells of the moves left, straight and right, the snake heads towards row 0
+    static const u32 targets[3] = { 2 * WINDOW + 1, 1 * WINDOW + 2, 2 * WINDOW + 3 };
+
+    u8 entry = 0;
+
+    for (u32 move=0; move<3; move++) {
+	u32 start = 1u << targets[move];
+	enum pattern_class class;
+
+	if (!(free & start))
+	    class = PATTERN_FATAL;
+	else {
+	    u32 region = flood(start, free);
+
+	    u32 exits = popcount(region & BORDER);
+
+	    if (exits == 0)
+		class = PATTERN_POCKET;
+	    else if (exits <= PATTERN_NARROW_EXITS)
+		class = PATTERN_NARROW;
+	    else
+		class = PATTERN_OPEN;
+	}
+
+	entry |= class << (move * 2);
+    }
+
+    return entry;
+}
+
+u8 pattern_lookup(u32 key) {
+    return table ? table[key] : pattern_classify(key);
+}
+
+const u8 *pattern_parse(const u8 *data, u64 size) {
+    if (!data || size != PATTERN_HEADER_SIZE + PATTERN_KEYS)
+	return NULL;
+
+    if (get_u32(data) != PATTERN_MAGIC || get_u16(data + 4) != PATTERN_VERSION || get_u32(data + 8) != PATTERN_KEYS)
+	return NULL;
+
+    return data + PATTERN_HEADER_SIZE;
+}
+
+void pattern_set_table(const u8 *entries) {
+    table = entries;
+}
+
+bool pattern_save(const char *path, const u8 *entries) {
+    assert(path);
+    assert(entries);
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+	return false;
+
+    u8 header[PATTERN_HEADER_SIZE] = {0};
+    put_u32(header, PATTERN_MAGIC);
+    put_u16(header + 4, PATTERN_VERSION);
+    put_u32(header + 8, PATTERN_KEYS);
+
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+	fwrite(entries, 1, PATTERN_KEYS, file) == PATTERN_KEYS;
+
+    return fclose(file) == 0 && ok;
+}
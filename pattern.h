@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "snake.h"
+
+// what the 5x5 cells around the head say about each move, looked up instead of searched
+//
+// the key is the occupancy of the 24 cells around the head, turned so the snake heads up, one bit per cell
+// row by row from the row ahead, the head itself left out
+// the entry of a key holds a class for the moves left, straight and right, two bits each from the low bits
+//
+// patgen works out every entry by flood filling the window and writes them to a file that is mapped
+// at runtime, without one the entries are worked out on the spot
+//
+// file layout, little endian:
+//   u32 magic, u16 version, u16 0, u32 number of keys, u32 0, then one byte per key
+
+#define PATTERN_MAGIC 0x544B4E53
+#define PATTERN_VERSION 1
+#define PATTERN_HEADER_SIZE 16
+#define PATTERN_KEYS (1u << 24)
+
+// a region touching the edge of the window in at most this many cells leaves through a corridor
+#define PATTERN_NARROW_EXITS 2
+
+enum pattern_class {
+    // the cell is taken
+    PATTERN_FATAL,
+    // the free cells reachable from the move are all inside the window, 8 at most
+    PATTERN_POCKET,
+    // they reach the edge of the window, but only through PATTERN_NARROW_EXITS cells or less
+    PATTERN_NARROW,
+    // they reach the edge all over, as far as the window can tell there is plenty of room
+    PATTERN_OPEN,
+};
+
+enum relative_move {
+    MOVE_LEFT,
+    MOVE_STRAIGHT,
+    MOVE_RIGHT,
+};
+
+static inline enum pattern_class pattern_move_class(u8 entry, enum relative_move move) {
+    return entry >> (move * 2) & 3;
+}
+
+// the direction move turns dir into
+static inline struct vec2 relative_direction(struct vec2 dir, enum relative_move move) {
+    struct vec2 result = dir;
+
+    if (move == MOVE_LEFT) {
+	result.x = dir.y;
+	result.y = -dir.x;
+    } else if (move == MOVE_RIGHT) {
+	result.x = -dir.y;
+	result.y = dir.x;
+    }
+
+    return result;
+}
+
+u32 pattern_key(const struct snake *snake);
+
+// the entry of key worked out from scratch, what patgen fills the table with
+u8 pattern_classify(u32 key);
+
+// the table entry of key, or pattern_classify if no table is set
+u8 pattern_lookup(u32 key);
+
+// the entries of a whole pattern file, e.g. a mapped one, or NULL if data is not one
+const u8 *pattern_parse(const u8 *data, u64 size);
+
+// entries from pattern_parse for pattern_lookup to use, they have to stay around
+// set it before any bot runs, NULL goes back to working entries out on the spot
+void pattern_set_table(const u8 *entries);
+
+bool pattern_save(const char *path, const u8 *entries);
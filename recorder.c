@@ -0,0 +1,200 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "recorder.h"
+#include "os.h"
+
+
+static struct recorder_block *take_block(struct recorder *recorder) {
+    SDL_AtomicLock(&recorder->lock);
+    struct recorder_block *block = recorder->free_blocks;
+    if (block)
+	recorder->free_blocks = block->next;
+    SDL_AtomicUnlock(&recorder->lock);
+
+    // the pool only grows to the blocks that are in flight at once
+    if (!block) {
+	block = malloc(sizeof(*block));
+	assert(block);
+    }
+
+    return block;
+}
+
+static void queue_block(struct recorder *recorder, struct recorder_block *block) {
+    SDL_AtomicLock(&recorder->lock);
+    block->next = recorder->queue;
+    recorder->queue = block;
+    SDL_AtomicUnlock(&recorder->lock);
+
+    SDL_SemPost(recorder->wake);
+}
+
+// the header stays zero until the last block, so a replay cut short is never taken for a whole one
+static bool write_block(const struct recorder_block *block) {
+    const struct recording *recording = block->recording;
+
+    u64 offset = (u64) block->index * RECORDER_BLOCK_SIZE;
+    u32 size = block->last ? (recording->replay.ticks + 3) / 4 - offset : RECORDER_BLOCK_SIZE;
+
+    FILE *file = fopen(recording->path, block->index == 0 ? "wb" : "r+b");
+    if (!file)
+	return false;
+
+    u8 header[REPLAY_HEADER_SIZE] = {0};
+    if (block->last)
+	replay_put_header(&recording->replay, header);
+
+    bool ok = true;
+    if (block->index == 0 || block->last)
+	ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+
+    ok = ok && fseek(file, REPLAY_HEADER_SIZE + offset, SEEK_SET) == 0 &&
+	fwrite(block->data, 1, size, file) == size;
+
+    if (block->last)
+	ok = ok && os_sync_file(file);
+
+    return fclose(file) == 0 && ok;
+}
+
+static int io_main(void *data) {
+    struct recorder *recorder = data;
+
+    while (true) {
+	SDL_SemWait(recorder->wake);
+
+	SDL_AtomicLock(&recorder->lock);
+	struct recorder_block *queue = recorder->queue;
+	recorder->queue = NULL;
+	bool stop = recorder->stop;
+	SDL_AtomicUnlock(&recorder->lock);
+
+	// oldest first, the blocks of a recording then go out in order and its last one after all of them
+	struct recorder_block *blocks = NULL;
+	while (queue) {
+	    struct recorder_block *block = queue;
+	    queue = block->next;
+	    block->next = blocks;
+	    blocks = block;
+	}
+
+	while (blocks) {
+	    struct recorder_block *block = blocks;
+	    blocks = block->next;
+
+	    struct recording *recording = block->recording;
+
+	    if (!recording->write_failed && !write_block(block))
+		recording->write_failed = true;
+
+	    if (block->last) {
+		if (recording->failed)
+		    *recording->failed = recording->write_failed;
+		free(recording);
+	    }
+
+	    SDL_AtomicLock(&recorder->lock);
+	    block->next = recorder->free_blocks;
+	    recorder->free_blocks = block;
+	    SDL_AtomicUnlock(&recorder->lock);
+	}
+
+	// nothing is handed over after stop, so whatever came before it was in this batch
+	if (stop)
+	    break;
+    }
+
+    return 0;
+}
+
+bool recorder_start(struct recorder *recorder) {
+    assert(recorder);
+
+    memset(recorder, 0, sizeof(*recorder));
+
+    recorder->wake = SDL_CreateSemaphore(0);
+    if (!recorder->wake)
+	return false;
+
+    recorder->thread = SDL_CreateThread(io_main, "recorder", recorder);
+    if (!recorder->thread) {
+	SDL_DestroySemaphore(recorder->wake);
+	return false;
+    }
+
+    return true;
+}
+
+void recorder_stop(struct recorder *recorder) {
+    assert(recorder);
+
+    SDL_AtomicLock(&recorder->lock);
+    recorder->stop = true;
+    SDL_AtomicUnlock(&recorder->lock);
+
+    SDL_SemPost(recorder->wake);
+    SDL_WaitThread(recorder->thread, NULL);
+
+    SDL_DestroySemaphore(recorder->wake);
+
+    while (recorder->free_blocks) {
+	struct recorder_block *block = recorder->free_blocks;
+	recorder->free_blocks = block->next;
+	free(block);
+    }
+}
+
+struct recording *recorder_begin(struct recorder *recorder, const char *path, u32 bound_x, u32 bound_y, u64 seed,
+				 const char *bot) {
+    assert(recorder);
+    assert(path);
+
+    struct recording *recording = malloc(sizeof(*recording));
+    assert(recording);
+
+    recording->recorder = recorder;
+    snprintf(recording->path, sizeof(recording->path), "%s", path);
+    replay_init(&recording->replay, bound_x, bound_y, seed, bot);
+
+    recording->block = take_block(recorder);
+    recording->block->recording = recording;
+    recording->block->index = 0;
+    recording->block->last = false;
+    recording->n_blocks = 0;
+
+    recording->write_failed = false;
+    recording->failed = NULL;
+
+    return recording;
+}
+
+void recording_next_block(struct recording *recording) {
+    assert(recording);
+
+    queue_block(recording->recorder, recording->block);
+    recording->n_blocks++;
+
+    recording->block = take_block(recording->recorder);
+    recording->block->recording = recording;
+    recording->block->index = recording->n_blocks;
+    recording->block->last = false;
+}
+
+void recorder_finish(struct recording *recording, u32 score, bool *failed) {
+    assert(recording);
+
+    recording->replay.score = score;
+    recording->failed = failed;
+
+    // blocks come back from the pool dirty, the bits past the last tick are cleared so the same game always
+    // makes the same file
+    u32 tick = recording->replay.ticks - recording->n_blocks * RECORDER_BLOCK_SIZE * 4;
+    if (tick % 4)
+	recording->block->data[tick / 4] &= (1 << tick % 4 * 2) - 1;
+    recording->block->last = true;
+
+    queue_block(recording->recorder, recording->block);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+#include "SDL_atomic.h"
+
+#include "types.h"
+#include "snake.h"
+#include "replay.h"
+
+// records replays from many games at once without the games ever touching a file
+//
+// a game fills fixed size blocks of directions, a full block goes to the recorder's io thread and the game goes
+// on in a fresh one out of a pool, so recording a tick is a couple of bit operations and at most a spinlock
+// the io thread writes every block at its place in the replay file and the header last, once the game is over,
+// then syncs the file, so a replay is on disk as soon as the blocks queued before it are
+// a file is only open while one of its blocks is written, thousands of games recording at once do not keep
+// thousands of files open
+//
+// the files are the same as replay_save writes, see replay.h, a game cut short by a crash leaves a file with a
+// zero header that replay_load turns down
+
+// bytes of directions in a block, a block holds four ticks a byte
+#define RECORDER_BLOCK_SIZE 4096
+
+struct recording;
+
+struct recorder_block {
+    struct recorder_block *next;
+    struct recording *recording;
+    // which block of the recording it is
+    u32 index;
+    // the last block of a recording, the header goes out with it
+    bool last;
+    u8 data[RECORDER_BLOCK_SIZE];
+};
+
+struct recording {
+    struct recorder *recorder;
+    char path[1024];
+    struct replay replay;
+
+    // the block being filled, the ticks in it are the ones past the blocks handed over
+    struct recorder_block *block;
+    u32 n_blocks;
+
+    // the io thread's side, a block that could not be written fails the whole replay
+    bool write_failed;
+    bool *failed;
+};
+
+struct recorder {
+    SDL_Thread *thread;
+
+    // blocks for the io thread, newest first, and blocks to fill, both under lock
+    SDL_SpinLock lock;
+    struct recorder_block *queue;
+    struct recorder_block *free_blocks;
+    // counts blocks in the queue, plus one to stop the thread
+    SDL_sem *wake;
+    bool stop;
+};
+
+bool recorder_start(struct recorder *recorder);
+
+// writes everything that was handed over, then stops the io thread
+void recorder_stop(struct recorder *recorder);
+
+// starts recording a game into path, which is created once the first block is written
+struct recording *recorder_begin(struct recorder *recorder, const char *path, u32 bound_x, u32 bound_y, u64 seed,
+				 const char *bot);
+
+// hands the filled block to the io thread and starts the next one
+void recording_next_block(struct recording *recording);
+
+// appends the direction the snake is about to move in
+static inline void recording_record(struct recording *recording, struct vec2 dir) {
+    u32 tick = recording->replay.ticks - recording->n_blocks * RECORDER_BLOCK_SIZE * 4;
+
+    if (tick == RECORDER_BLOCK_SIZE * 4) {
+	recording_next_block(recording);
+	tick = 0;
+    }
+
+    u8 *byte = &recording->block->data[tick / 4];
+    u32 shift = tick % 4 * 2;
+
+    *byte = (*byte & ~(3 << shift)) | direction_index(dir) << shift;
+    recording->replay.ticks++;
+}
+
+// ends the game with its final score, the recording belongs to the io thread from here on
+// failed, if given, is set once the replay is written and has to stay around until recorder_stop returns
+void recorder_finish(struct recording *recording, u32 score, bool *failed);
@@ -0,0 +1,175 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+#include "wire.h"
+
+
+void replay_init(struct replay *replay, u32 bound_x, u32 bound_y, u64 seed, const char *bot) {
+    assert(replay);
+
+    memset(replay, 0, sizeof(*replay));
+
+    replay->bound_x = bound_x;
+    replay->bound_y = bound_y;
+    replay->seed = seed;
+
+    if (bot)
+	strncpy(replay->bot, bot, REPLAY_BOT_NAME - 1);
+}
+
+void replay_free(struct replay *replay) {
+    assert(replay);
+
+    if (replay->cap)
+	free(replay->dirs);
+    replay->dirs = NULL;
+    replay->cap = 0;
+}
+
+void replay_record(struct replay *replay, struct vec2 dir) {
+    assert(replay);
+
+    if (replay->ticks / 4 >= replay->cap) {
+	replay->cap = replay->cap ? replay->cap * 2 : 256;
+	replay->dirs = realloc(replay->dirs, replay->cap);
+	assert(replay->dirs);
+    }
+
+    u8 *byte = &replay->dirs[replay->ticks / 4];
+    u32 shift = replay->ticks % 4 * 2;
+
+    *byte = (*byte & ~(3 << shift)) | direction_index(dir) << shift;
+    replay->ticks++;
+}
+
+void replay_put_header(const struct replay *replay, u8 *header) {
+    assert(replay);
+    assert(header);
+
+    memset(header, 0, REPLAY_HEADER_SIZE);
+    put_u32(header, REPLAY_MAGIC);
+    put_u16(header + 4, REPLAY_VERSION);
+    put_u32(header + 8, replay->bound_x);
+    put_u32(header + 12, replay->bound_y);
+    put_u64(header + 16, replay->seed);
+    put_u32(header + 24, replay->ticks);
+    put_u32(header + 28, replay->score);
+    memcpy(header + 32, replay->bot, REPLAY_BOT_NAME);
+    put_u64(header + 48, replay->map_hash);
+}
+
+bool replay_save(const struct replay *replay, const char *path) {
+    assert(replay);
+    assert(path);
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+	return false;
+
+    u8 header[REPLAY_HEADER_SIZE];
+    replay_put_header(replay, header);
+
+    u32 dirs_len = (replay->ticks + 3) / 4;
+
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+	fwrite(replay->dirs, 1, dirs_len, file) == dirs_len;
+
+    return fclose(file) == 0 && ok;
+}
+
+// the size of the header, 0 if data does not start with one we know
+static u32 header_size(const u8 *data, u64 size) {
+    if (size < REPLAY_V1_HEADER_SIZE || get_u32(data) != REPLAY_MAGIC)
+	return 0;
+
+    u16 version = get_u16(data + 4);
+    if (version == 1)
+	return REPLAY_V1_HEADER_SIZE;
+    if (version == REPLAY_VERSION && size >= REPLAY_HEADER_SIZE)
+	return REPLAY_HEADER_SIZE;
+
+    return 0;
+}
+
+static void get_header(struct replay *replay, const u8 *data, u32 size) {
+    replay_init(replay, get_u32(data + 8), get_u32(data + 12), get_u64(data + 16), NULL);
+    replay->ticks = get_u32(data + 24);
+    replay->score = get_u32(data + 28);
+    memcpy(replay->bot, data + 32, REPLAY_BOT_NAME);
+    replay->bot[REPLAY_BOT_NAME - 1] = 0;
+
+    if (size >= REPLAY_HEADER_SIZE)
+	replay->map_hash = get_u64(data + 48);
+}
+
+bool replay_load(struct replay *replay, const char *path) {
+    assert(replay);
+    assert(path);
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+	return false;
+
+    // the version decides how much of the header there is, the rest of it comes after
+    u8 header[REPLAY_HEADER_SIZE];
+    u32 size = fread(header, 1, REPLAY_V1_HEADER_SIZE, file) == REPLAY_V1_HEADER_SIZE ?
+	header_size(header, REPLAY_HEADER_SIZE) : 0;
+
+    if (size == 0 || fread(header + REPLAY_V1_HEADER_SIZE, 1, size - REPLAY_V1_HEADER_SIZE, file) !=
+	    size - REPLAY_V1_HEADER_SIZE) {
+	fclose(file);
+	return false;
+    }
+
+    get_header(replay, header, size);
+
+    u32 dirs_len = (replay->ticks + 3) / 4;
+    replay->cap = dirs_len ? dirs_len : 1;
+    replay->dirs = malloc(replay->cap);
+    assert(replay->dirs);
+
+    bool ok = fread(replay->dirs, 1, dirs_len, file) == dirs_len && replay->bound_x && replay->bound_y;
+    fclose(file);
+
+    if (!ok)
+	replay_free(replay);
+
+    return ok;
+}
+
+bool replay_parse(struct replay *replay, const u8 *data, u64 size) {
+    assert(replay);
+
+    u32 header = header_size(data, size);
+    if (header == 0)
+	return false;
+
+    get_header(replay, data, header);
+
+    replay->dirs = (u8 *) data + header;
+    replay->cap = 0;
+
+    return replay->bound_x && replay->bound_y && size - header >= ((u64) replay->ticks + 3) / 4;
+}
+
+void replay_start(const struct replay *replay, struct snake *snake) {
+    assert(replay);
+    assert(snake);
+
+    init_snake(snake, replay->bound_x, replay->bound_y, replay->seed);
+}
+
+bool replay_verify(const struct replay *replay, struct snake *snake) {
+    replay_start(replay, snake);
+
+    u32 tick;
+    for (tick = 0; tick < replay->ticks && !snake->died; tick++) {
+	snake->direction = replay_direction(replay, tick);
+	move_snake(snake);
+    }
+
+    return tick == replay->ticks && snake->score == replay->score;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "snake.h"
+
+// a game is fully determined by its grid, its seed and the direction used on every tick,
+// so a replay is just those plus a few fields to check the result against
+//
+// file layout, little endian:
+//   u32 magic, u16 version, u16 0, u32 bound_x, u32 bound_y, u64 seed, u32 ticks, u32 score,
+//   char bot[16] (zero padded), u64 map hash, then ticks two bit direction indices, four to a byte starting at
+//   the low bits
+// version 1 has no map hash, its games were all played without a map
+//
+// a game on a map only plays back with the same map, see map_hash, everything else plays replays with a map
+// hash of 0
+
+#define REPLAY_MAGIC 0x504B4E53
+#define REPLAY_VERSION 2
+#define REPLAY_HEADER_SIZE 56
+#define REPLAY_V1_HEADER_SIZE 48
+#define REPLAY_BOT_NAME 16
+
+struct replay {
+    u32 bound_x, bound_y;
+    u64 seed;
+    u32 ticks;
+    u32 score;
+    char bot[REPLAY_BOT_NAME];
+    // 0 when the game was played without a map
+    u64 map_hash;
+
+    u8 *dirs;
+    // 0 when dirs points into memory the replay does not own, see replay_parse
+    u32 cap;
+};
+
+void replay_init(struct replay *replay, u32 bound_x, u32 bound_y, u64 seed, const char *bot);
+
+void replay_free(struct replay *replay);
+
+// appends the direction the snake is about to move in
+void replay_record(struct replay *replay, struct vec2 dir);
+
+static inline struct vec2 replay_direction(const struct replay *replay, u32 tick) {
+    return directions[(replay->dirs[tick / 4] >> (tick % 4 * 2)) & 3];
+}
+
+// the first REPLAY_HEADER_SIZE bytes of the replay's file
+void replay_put_header(const struct replay *replay, u8 *header);
+
+bool replay_save(const struct replay *replay, const char *path);
+
+bool replay_load(struct replay *replay, const char *path);
+
+// reads a replay straight out of a buffer holding a whole file, e.g. a mapped one
+// dirs then points into data, so data has to outlive the replay and the replay cannot be recorded to
+bool replay_parse(struct replay *replay, const u8 *data, u64 size);
+
+// starts the recorded game, snake must be freed by the caller
+// a replay with a map hash also needs the map's obstacles set, see set_rules
+void replay_start(const struct replay *replay, struct snake *snake);
+
+// plays the whole replay into snake, returns false if the result does not match what was recorded
+bool replay_verify(const struct replay *replay, struct snake *snake);
@@ -0,0 +1,113 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rewind.h"
+
+
+void rewind_init(struct rewind *rewind, const struct snake *snake, u32 max_ticks) {
+    assert(rewind);
+    assert(snake);
+    assert(max_ticks > 0);
+
+    memset(rewind, 0, sizeof(*rewind));
+
+    rewind->cap = max_ticks;
+    rewind->deltas = malloc(max_ticks * sizeof(*rewind->deltas));
+    assert(rewind->deltas);
+
+    rewind->direction = direction_index(snake->direction);
+}
+
+void rewind_free(struct rewind *rewind) {
+    assert(rewind);
+
+    free(rewind->deltas);
+    memset(rewind, 0, sizeof(*rewind));
+}
+
+void rewind_move_snake(struct rewind *rewind, struct snake *snake) {
+    assert(rewind);
+    assert(snake);
+
+    struct vec2 old_tail = snake->tail->pos;
+    u64 old_rng = snake->rng.state;
+    u32 old_score = snake->score;
+    u32 old_length = snake->length;
+
+    move_snake(snake);
+
+    if (snake->died)
+	return;
+
+    struct rewind_delta *delta = &rewind->deltas[rewind->newest];
+
+    delta->ate = snake->score != old_score;
+    delta->grew = snake->length != old_length;
+    if (delta->ate)
+	delta->old_rng = old_rng;
+    else if (!delta->grew)
+	delta->old_tail = old_tail;
+    delta->old_direction = rewind->direction;
+
+    rewind->direction = direction_index(snake->direction);
+
+    rewind->newest = (rewind->newest + 1) % rewind->cap;
+    if (rewind->count < rewind->cap)
+	rewind->count++;
+}
+
+bool rewind_undo(struct rewind *rewind, struct snake *snake) {
+    assert(rewind);
+    assert(snake);
+
+    // the deadly move never made it onto the board
+    if (snake->died) {
+	snake->died = false;
+	return true;
+    }
+
+    if (rewind->count == 0)
+	return false;
+
+    rewind->newest = (rewind->newest + rewind->cap - 1) % rewind->cap;
+    rewind->count--;
+
+    const struct rewind_delta *delta = &rewind->deltas[rewind->newest];
+
+    struct snake_piece *head = snake->head;
+    assert(head->prev);
+
+    vacate_cell(snake, head);
+
+    snake->head = head->prev;
+    snake->head->next = NULL;
+
+    if (delta->grew) {
+	// eating added growth - 1 to what was pending, any other tick that grew used one up
+	if (delta->ate) {
+	    snake->food_pos = head->pos;
+	    snake->rng.state = delta->old_rng;
+	    snake->score--;
+	    snake->pending_growth = snake->pending_growth + 1 - snake->growth;
+	} else {
+	    snake->pending_growth++;
+	}
+	snake->length--;
+
+	free(head);
+    } else {
+	// the old head piece goes back on as the tail, no allocation either way
+	head->pos = delta->old_tail;
+	occupy_cell(snake, head->pos);
+	head->prev = NULL;
+	head->next = snake->tail;
+	snake->tail->prev = head;
+	snake->tail = head;
+    }
+
+    snake->direction = directions[delta->old_direction];
+    rewind->direction = delta->old_direction;
+
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "snake.h"
+
+// takes back the last few seconds of a game one tick at a time
+// a tick only ever adds a head and either drops the tail piece or keeps it, eating or still growing, so instead of copying
+// the snake we keep what the tick threw away in a fixed ring, the oldest ticks fall out of it
+// undoing a tick is then a couple of pointer swaps
+
+struct rewind_delta {
+    union {
+	// where the dropped tail piece was, when the tick kept no tail
+	struct vec2 old_tail;
+	// the rng before it placed the new food, when it did, the old food was where the head is now
+	u64 old_rng;
+    };
+    // direction index the snake was heading in before the tick
+    u8 old_direction;
+    bool ate;
+    // the tail stayed on, always when ate, also on the extra ticks of growth above 1
+    bool grew;
+};
+
+struct rewind {
+    struct rewind_delta *deltas;
+    u32 cap;
+    // deltas[newest - 1] is the last tick, count of them are usable
+    u32 newest;
+    u32 count;
+
+    u8 direction;
+};
+
+// remembers up to max_ticks ticks of snake, which has to be freshly started
+void rewind_init(struct rewind *rewind, const struct snake *snake, u32 max_ticks);
+
+void rewind_free(struct rewind *rewind);
+
+// move_snake that remembers how to undo itself, the deadly move is not remembered since it changes nothing
+void rewind_move_snake(struct rewind *rewind, struct snake *snake);
+
+// takes back the last tick, or just the death if the snake died, false if there is nothing left to undo
+bool rewind_undo(struct rewind *rewind, struct snake *snake);
@@ -0,0 +1,363 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scores.h"
+#include "wire.h"
+
+
+// keys merged into the new index at a time
+#define REINDEX_CHUNK 4096
+
+static void encode_entry(u8 *buf, const struct score_entry *entry) {
+    memset(buf, 0, SCORES_RECORD_SIZE);
+
+    put_u32(buf, entry->score);
+    put_u32(buf + 4, entry->ticks);
+    put_u64(buf + 8, entry->seed);
+    put_u64(buf + 16, entry->time);
+    strncpy((char *) buf + 24, entry->replay, SCORES_REPLAY_PATH - 1);
+}
+
+static void decode_entry(const u8 *buf, struct score_entry *entry) {
+    entry->score = get_u32(buf);
+    entry->ticks = get_u32(buf + 4);
+    entry->seed = get_u64(buf + 8);
+    entry->time = get_u64(buf + 16);
+
+    memcpy(entry->replay, buf + 24, SCORES_REPLAY_PATH);
+    entry->replay[SCORES_REPLAY_PATH - 1] = 0;
+}
+
+static bool key_before(struct score_key a, struct score_key b) {
+    return a.score > b.score || (a.score == b.score && a.record < b.record);
+}
+
+static int compare_keys(const void *a, const void *b) {
+    struct score_key x = *(const struct score_key *) a, y = *(const struct score_key *) b;
+    return key_before(x, y) ? -1 : key_before(y, x);
+}
+
+static struct score_key index_key(const struct score_store *store, u64 i) {
+    const u8 *p = store->index.data + SCORES_HEADER_SIZE + i * SCORES_KEY_SIZE;
+    return (struct score_key) { get_u32(p), get_u32(p + 4) };
+}
+
+static void push_tail(struct score_store *store, struct score_key key) {
+    if (store->n_tail == store->tail_cap) {
+	store->tail_cap = store->tail_cap ? store->tail_cap * 2 : 1024;
+	store->tail = realloc(store->tail, store->tail_cap * sizeof(*store->tail));
+	assert(store->tail);
+    }
+
+    store->tail[store->n_tail++] = key;
+    store->tail_sorted = false;
+}
+
+static void sort_tail(struct score_store *store) {
+    if (!store->tail_sorted)
+	qsort(store->tail, store->n_tail, sizeof(*store->tail), compare_keys);
+    store->tail_sorted = true;
+}
+
+static bool seek_record(FILE *log, u64 record) {
+    return fseek(log, SCORES_HEADER_SIZE + record * SCORES_RECORD_SIZE, SEEK_SET) == 0;
+}
+
+// maps the index if it is there and fits the log, n_indexed is 0 otherwise
+static bool load_index(struct score_store *store) {
+    store->n_indexed = 0;
+
+    if (!os_map_file(store->index_path, &store->index))
+	return false;
+
+    const u8 *data = store->index.data;
+    u64 size = store->index.size;
+
+    if (size >= SCORES_HEADER_SIZE && get_u32(data) == SCORES_INDEX_MAGIC && get_u16(data + 4) == SCORES_VERSION) {
+	u64 n = get_u64(data + 8);
+
+	if (n <= store->n_durable && size == SCORES_HEADER_SIZE + n * SCORES_KEY_SIZE) {
+	    store->n_indexed = n;
+	    return true;
+	}
+    }
+
+    os_unmap_file(&store->index);
+    return false;
+}
+
+// the keys of every durable record the index does not cover, read straight through the log
+static bool load_tail(struct score_store *store) {
+    store->n_tail = 0;
+
+    if (!seek_record(store->log, store->n_indexed))
+	return false;
+
+    u8 buf[SCORES_RECORD_SIZE];
+    for (u64 record = store->n_indexed; record < store->n_durable; record++) {
+	if (fread(buf, 1, sizeof(buf), store->log) != sizeof(buf))
+	    return false;
+
+	push_tail(store, (struct score_key) { get_u32(buf), record });
+    }
+
+    return true;
+}
+
+bool scores_open(struct score_store *store, const char *path) {
+    assert(store);
+    assert(path);
+
+    memset(store, 0, sizeof(*store));
+    snprintf(store->log_path, sizeof(store->log_path), "%s", path);
+    snprintf(store->index_path, sizeof(store->index_path), "%s.idx", path);
+
+    u8 header[SCORES_HEADER_SIZE] = {0};
+
+    store->log = fopen(path, "r+b");
+    if (store->log) {
+	if (fread(header, 1, sizeof(header), store->log) != sizeof(header) ||
+		get_u32(header) != SCORES_LOG_MAGIC || get_u16(header + 4) != SCORES_VERSION ||
+		get_u16(header + 6) != SCORES_RECORD_SIZE) {
+	    fclose(store->log);
+	    return false;
+	}
+    } else {
+	store->log = fopen(path, "w+b");
+	if (!store->log)
+	    return false;
+
+	put_u32(header, SCORES_LOG_MAGIC);
+	put_u16(header + 4, SCORES_VERSION);
+	put_u16(header + 6, SCORES_RECORD_SIZE);
+
+	if (fwrite(header, 1, sizeof(header), store->log) != sizeof(header) || !os_sync_file(store->log)) {
+	    fclose(store->log);
+	    return false;
+	}
+    }
+
+    // a record cut short by a crash does not count, the next append goes over it
+    if (fseek(store->log, 0, SEEK_END) != 0) {
+	fclose(store->log);
+	return false;
+    }
+    store->n_durable = (ftell(store->log) - SCORES_HEADER_SIZE) / SCORES_RECORD_SIZE;
+
+    load_index(store);
+
+    if (!load_tail(store)) {
+	scores_close(store);
+	return false;
+    }
+
+    // e.g. the index was missing, better to pay for it once now than on every query
+    if (store->n_tail >= SCORES_TAIL_MAX)
+	scores_reindex(store);
+
+    return true;
+}
+
+void scores_close(struct score_store *store) {
+    assert(store);
+
+    if (!scores_flush(store))
+	fprintf(stderr, "unable to write %u scores to %s\n", store->n_pending, store->log_path);
+
+    fclose(store->log);
+    os_unmap_file(&store->index);
+    free(store->tail);
+
+    memset(store, 0, sizeof(*store));
+}
+
+bool scores_add(struct score_store *store, const struct score_entry *entry) {
+    assert(store);
+    assert(entry);
+    assert(scores_count(store) < UINT32_MAX);
+
+    // a failed batch stays pending, the store has no room for more until it goes out
+    if (store->n_pending == SCORES_BATCH && !scores_flush(store))
+	return false;
+
+    push_tail(store, (struct score_key) { entry->score, scores_count(store) });
+    store->pending[store->n_pending++] = *entry;
+
+    if (store->n_pending < SCORES_BATCH)
+	return true;
+
+    if (!scores_flush(store))
+	return false;
+
+    return store->n_tail < SCORES_TAIL_MAX || scores_reindex(store);
+}
+
+bool scores_flush(struct score_store *store) {
+    assert(store);
+
+    if (store->n_pending == 0)
+	return true;
+
+    u8 buf[SCORES_BATCH * SCORES_RECORD_SIZE];
+    for (u32 i=0; i<store->n_pending; i++)
+	encode_entry(buf + i * SCORES_RECORD_SIZE, &store->pending[i]);
+
+    u32 len = store->n_pending * SCORES_RECORD_SIZE;
+    if (!seek_record(store->log, store->n_durable) || fwrite(buf, 1, len, store->log) != len ||
+	    !os_sync_file(store->log))
+	return false;
+
+    store->n_durable += store->n_pending;
+    store->n_pending = 0;
+
+    return true;
+}
+
+bool scores_reindex(struct score_store *store) {
+    assert(store);
+
+    // the index may only cover what is on the disk
+    if (!scores_flush(store))
+	return false;
+
+    sort_tail(store);
+
+    char tmp_path[1100];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", store->index_path);
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file)
+	return false;
+
+    u64 n = store->n_indexed + store->n_tail;
+
+    u8 buf[REINDEX_CHUNK * SCORES_KEY_SIZE];
+    put_u32(buf, SCORES_INDEX_MAGIC);
+    put_u16(buf + 4, SCORES_VERSION);
+    put_u16(buf + 6, 0);
+    put_u64(buf + 8, n);
+    bool ok = fwrite(buf, 1, SCORES_HEADER_SIZE, file) == SCORES_HEADER_SIZE;
+
+    // both are sorted already, so this is one merge pass
+    u64 i = 0, j = 0;
+    while (ok && i + j < n) {
+	u32 count = 0;
+
+	for (; count < REINDEX_CHUNK && i + j < n; count++) {
+	    struct score_key key;
+	    if (j == store->n_tail || (i < store->n_indexed && key_before(index_key(store, i), store->tail[j])))
+		key = index_key(store, i++);
+	    else
+		key = store->tail[j++];
+
+	    put_u32(buf + count * SCORES_KEY_SIZE, key.score);
+	    put_u32(buf + count * SCORES_KEY_SIZE + 4, key.record);
+	}
+
+	ok = fwrite(buf, 1, count * SCORES_KEY_SIZE, file) == count * SCORES_KEY_SIZE;
+    }
+
+    ok = ok && os_sync_file(file);
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok) {
+	remove(tmp_path);
+	return false;
+    }
+
+    // windows does not replace a file that is still mapped
+    os_unmap_file(&store->index);
+
+    bool replaced = os_replace_file(tmp_path, store->index_path);
+
+    // whatever is on the disk now, the tail makes up for what it does not cover
+    load_index(store);
+    if (!load_tail(store)) {
+	fprintf(stderr, "unable to read %s\n", store->log_path);
+	store->n_tail = 0;
+    }
+
+    return replaced && store->n_indexed == n;
+}
+
+u64 scores_rank(struct score_store *store, u32 score) {
+    assert(store);
+
+    sort_tail(store);
+
+    // the first key of each that is not better than score, i.e. how many are
+    u64 lo = 0, hi = store->n_indexed;
+    while (lo < hi) {
+	u64 mid = lo + (hi - lo) / 2;
+	if (index_key(store, mid).score > score)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    u64 better = lo;
+
+    lo = 0;
+    hi = store->n_tail;
+    while (lo < hi) {
+	u64 mid = lo + (hi - lo) / 2;
+	if (store->tail[mid].score > score)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    return 1 + better + lo;
+}
+
+u32 scores_top(struct score_store *store, u32 k, struct score_key *keys) {
+    assert(store);
+    assert(keys || k == 0);
+
+    sort_tail(store);
+
+    u64 i = 0, j = 0;
+    u32 count = 0;
+
+    for (; count < k && (i < store->n_indexed || j < store->n_tail); count++) {
+	if (j == store->n_tail || (i < store->n_indexed && key_before(index_key(store, i), store->tail[j])))
+	    keys[count] = index_key(store, i++);
+	else
+	    keys[count] = store->tail[j++];
+    }
+
+    return count;
+}
+
+bool scores_get(struct score_store *store, u32 record, struct score_entry *entry) {
+    assert(store);
+    assert(entry);
+
+    if (record >= scores_count(store))
+	return false;
+
+    if (record >= store->n_durable) {
+	*entry = store->pending[record - store->n_durable];
+	return true;
+    }
+
+    u8 buf[SCORES_RECORD_SIZE];
+    if (!seek_record(store->log, record) || fread(buf, 1, sizeof(buf), store->log) != sizeof(buf))
+	return false;
+
+    decode_entry(buf, entry);
+    return true;
+}
+
+void score_set_replay(struct score_entry *entry, const char *path) {
+    assert(entry);
+    assert(path);
+
+    const char *name = path;
+    for (const char *p = path; *p; p++)
+	if (*p == '/' || *p == '\\')
+	    name = p + 1;
+
+    snprintf(entry->replay, sizeof(entry->replay), "%s", name);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "types.h"
+#include "os.h"
+
+// a leaderboard that keeps every game recorded into it, millions of them, without ever loading them all
+//
+// games are appended to a log of fixed size records in batches, a whole batch costs one write and one fsync
+// next to the log is an index of every record's score and number, sorted from the best score down,
+// which is mapped and binary searched, so a rank or the top k only touches a few pages of it and k records
+// records appended since the index was written are kept in memory and searched alongside it,
+// once there are SCORES_TAIL_MAX of them the two are merged into a new index
+//
+// the log is only ever appended to and the index only covers records that were synced, so a crash loses at
+// most the batch that was being written, a torn record at the end is simply overwritten by the next one
+// one process writes a store at a time
+//
+// log layout, little endian:
+//   u32 magic, u16 version, u16 record size, u64 0, then records of
+//   u32 score, u32 ticks, u64 seed, u64 unix time, char replay[40] (zero padded)
+// index layout, little endian, next to the log with .idx appended to its name:
+//   u32 magic, u16 version, u16 0, u64 records covered, then u32 score, u32 record for each of them
+
+#define SCORES_LOG_MAGIC 0x4C4B4E53
+#define SCORES_INDEX_MAGIC 0x494B4E53
+#define SCORES_VERSION 1
+#define SCORES_HEADER_SIZE 16
+#define SCORES_RECORD_SIZE 64
+#define SCORES_KEY_SIZE 8
+#define SCORES_REPLAY_PATH 40
+
+// records written and synced together
+#define SCORES_BATCH 256
+// records kept out of the index before it is rewritten, big enough that rewriting it stays rare
+#define SCORES_TAIL_MAX 65536
+
+struct score_entry {
+    u32 score;
+    // how long the game went on
+    u32 ticks;
+    u64 seed;
+    // when it was recorded, unix time
+    u64 time;
+    // where its replay was saved, empty if it was not
+    char replay[SCORES_REPLAY_PATH];
+};
+
+// a record's place in the ranking, better scores first and earlier records first among equal ones
+struct score_key {
+    u32 score;
+    u32 record;
+};
+
+struct score_store {
+    char log_path[1024], index_path[1024];
+    FILE *log;
+
+    // records synced to the log, the first n_indexed of them are in the index
+    u64 n_durable;
+    u64 n_indexed;
+    struct os_mapped_file index;
+
+    // keys of every record past n_indexed, pending ones included, only sorted when a query needs it
+    struct score_key *tail;
+    u32 n_tail, tail_cap;
+    bool tail_sorted;
+
+    // records not written yet, they follow the durable ones
+    struct score_entry pending[SCORES_BATCH];
+    u32 n_pending;
+};
+
+// opens the store at path, creating it if there is none
+// a missing or stale index is rebuilt from the log
+bool scores_open(struct score_store *store, const char *path);
+
+// flushes what is pending, nothing is lost by not reindexing first
+void scores_close(struct score_store *store);
+
+// the entry gets the next record number
+// false if a full batch could not be written, it stays pending and the entry is only kept if there was room
+bool scores_add(struct score_store *store, const struct score_entry *entry);
+
+// writes and syncs the pending records
+bool scores_flush(struct score_store *store);
+
+// flushes, then merges every record past the index into a new one
+bool scores_reindex(struct score_store *store);
+
+static inline u64 scores_count(const struct score_store *store) {
+    return store->n_durable + store->n_pending;
+}
+
+// 1 + the number of records with a better score, i.e. where a game with score would rank
+u64 scores_rank(struct score_store *store, u32 score);
+
+// the best k records into keys, returns how many there were
+u32 scores_top(struct score_store *store, u32 k, struct score_key *keys);
+
+bool scores_get(struct score_store *store, u32 record, struct score_entry *entry);
+
+// keeps the file name of a replay's path, cut to fit, replays are looked up next to the store or by name
+void score_set_replay(struct score_entry *entry, const char *path);
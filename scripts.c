@@ -0,0 +1,122 @@
+#include <assert.h>
+#include <string.h>
+
+#include "scripts.h"
+#include "pattern.h"
+#include "coro.h"
+
+
+// the first leg of a spiral, any shorter and it winds itself into its own body
+#define SPIRAL_START 4
+
+const char *script_names[N_SCRIPT_KINDS] = {
+    "zigzag", "spiral", "hunter"
+};
+
+void script_start(struct script *script, enum script_kind kind) {
+    assert(script);
+    assert(kind < N_SCRIPT_KINDS);
+
+    memset(script, 0, sizeof(*script));
+    script->kind = kind;
+}
+
+static bool is_free(const struct snake *snake, struct vec2 dir) {
+    struct vec2 pos;
+    return next_head_pos(snake, dir, &pos) && !cell_occupied(snake, pos);
+}
+
+// the turn to side if it is free, otherwise the other one, otherwise straight on to the end
+static struct vec2 turn(const struct snake *snake, u32 side) {
+    struct vec2 first = relative_direction(snake->direction, side ? MOVE_RIGHT : MOVE_LEFT);
+    struct vec2 second = relative_direction(snake->direction, side ? MOVE_LEFT : MOVE_RIGHT);
+
+    if (is_free(snake, first))
+	return first;
+    if (is_free(snake, second))
+	return second;
+
+    return snake->direction;
+}
+
+struct vec2 script_zigzag(struct script *script, const struct snake *snake) {
+    assert(script && snake);
+
+    CO_BEGIN(script->line);
+
+    while (true) {
+	// a lane is the grid's length or until something is in the way, so the lanes fill the grid side by side
+	script->leg = snake->direction.x ? snake->bound_x - 1 : snake->bound_y - 1;
+	for (script->steps = 0; script->steps < script->leg && is_free(snake, snake->direction); script->steps++)
+	    CO_YIELD(script->line, snake->direction);
+
+	// two turns the same way make a u-turn into the next lane, the next u-turn goes the other way
+	script->side ^= 1;
+	CO_YIELD(script->line, turn(snake, script->side));
+	CO_YIELD(script->line, turn(snake, script->side));
+    }
+
+    CO_END(script->line, snake->direction);
+}
+
+struct vec2 script_spiral(struct script *script, const struct snake *snake) {
+    assert(script && snake);
+
+    CO_BEGIN(script->line);
+
+    script->leg = SPIRAL_START;
+
+    while (true) {
+	for (script->steps = 0; script->steps < script->leg; script->steps++) {
+	    if (!is_free(snake, snake->direction))
+		break;
+	    CO_YIELD(script->line, snake->direction);
+	}
+
+	// a leg cut short, or one as long as the grid, starts a new spiral from where it is
+	if (script->steps < script->leg || script->leg >= snake->bound_x + snake->bound_y) {
+	    script->leg = SPIRAL_START;
+	} else {
+	    // legs grow every second turn, by two so there is a free lane between the rings
+	    script->side ^= 1;
+	    if (script->side == 0)
+		script->leg += 2;
+	}
+
+	CO_YIELD(script->line, turn(snake, 1));
+    }
+
+    CO_END(script->line, snake->direction);
+}
+
+struct vec2 script_hunter(struct script *script, const struct snake *snake) {
+    assert(script && snake);
+
+    CO_BEGIN(script->line);
+
+    while (true) {
+	// straight at the food, the axis in side first, not minding that the grid may wrap
+	{
+	    s32 dx = snake->food_pos.x - snake->head->pos.x, dy = snake->food_pos.y - snake->head->pos.y;
+	    struct vec2 dir = snake->direction;
+
+	    if (dx && (script->side == 0 || dy == 0))
+		dir = (struct vec2) { dx > 0 ? 1 : -1, 0 };
+	    else if (dy)
+		dir = (struct vec2) { 0, dy > 0 ? 1 : -1 };
+
+	    bool reverse = dir.x == -snake->direction.x && dir.y == -snake->direction.y;
+	    if (!reverse && is_free(snake, dir)) {
+		CO_YIELD(script->line, dir);
+		continue;
+	    }
+	}
+
+	// in the way, go round for a few ticks and try the other axis first afterwards
+	script->side ^= 1;
+	for (script->steps = 0; script->steps < 3; script->steps++)
+	    CO_YIELD(script->line, is_free(snake, snake->direction) ? snake->direction : turn(snake, script->side));
+    }
+
+    CO_END(script->line, snake->direction);
+}
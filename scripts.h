@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "snake.h"
+
+// scripted opponents for arenas, simple movement patterns written as coroutines, see coro.h
+//
+// unlike a bot a script remembers what it was doing from one tick to the next, all of it in a struct script
+// of a few bytes, so an arena can keep thousands of them and resume each with one call per tick
+
+enum script_kind {
+    // runs along a lane until something is in the way, then turns into the next lane and comes back
+    SCRIPT_ZIGZAG,
+    // ever longer legs turning right, starting over small when it runs into something
+    SCRIPT_SPIRAL,
+    // one axis at a time towards the food, with a short detour when the way is blocked
+    SCRIPT_HUNTER,
+    N_SCRIPT_KINDS
+};
+
+extern const char *script_names[N_SCRIPT_KINDS];
+
+struct script {
+    // where the coroutine left off
+    u16 line;
+    u8 kind;
+    // which way the next turn goes, or which axis goes first
+    u8 side;
+    // locals kept across yields
+    u16 steps, leg;
+};
+
+void script_start(struct script *script, enum script_kind kind);
+
+// the direction for this tick, the caller moves the snake before the next call
+struct vec2 script_zigzag(struct script *script, const struct snake *snake);
+struct vec2 script_spiral(struct script *script, const struct snake *snake);
+struct vec2 script_hunter(struct script *script, const struct snake *snake);
+
+static inline struct vec2 script_resume(struct script *script, const struct snake *snake) {
+    switch (script->kind) {
+	case SCRIPT_ZIGZAG:
+	    return script_zigzag(script, snake);
+	case SCRIPT_SPIRAL:
+	    return script_spiral(script, snake);
+	default:
+	    return script_hunter(script, snake);
+    }
+}
@@ -0,0 +1,1079 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+#include "SDL_atomic.h"
+
+#include "types.h"
+#include "snake.h"
+#include "bots.h"
+#include "checkpoint.h"
+#include "wire.h"
+
+// hosts many independent rooms on a fixed pool of worker threads instead of a process per game
+// every worker keeps its rooms in a timer wheel and sleeps until the earliest tick deadline,
+// a balancer on the main thread moves rooms from busy workers to idle ones
+// with a checkpoint file every room is saved to it periodically and the server can resume from it, see checkpoint.h
+
+
+#define MAX_WORKERS 64
+#define MAX_GRIDS 16
+#define MAX_RULES 16
+
+// each slot of the wheel is 1ms wide, one turn of the wheel covers WHEEL_SLOTS ms
+// deadlines further out than a turn just sit in their slot until the wheel comes around to them
+#define WHEEL_SLOTS 256
+#define WHEEL_SLOT_US 1000
+
+#define TOP_ROOMS 5
+
+// room record in a checkpoint, little endian:
+//   u32 id, u32 snakes, u32 bound x, u32 bound y, u8 walls, u8 0, u16 0, u32 growth, u32 rocks percent,
+//   u64 next seed, u64 ticks, u64 missed, u64 games, u64 average tick cost in ns,
+//   then the rock bitmap when there are rocks, then every snake
+#define ROOM_RECORD_HEADER_SIZE 68
+
+
+struct room {
+    u32 id;
+
+    // snakes in a room tick together but each plays on its own grid
+    u32 n_snakes;
+    struct snake *snakes;
+    u64 next_seed;
+
+    struct rules rules;
+    // percentage of cells turned into obstacles, placed again for every game
+    u32 rocks_pct;
+    u64 *rocks;
+
+    u64 tick_us;
+    // absolute time of the next tick on the server clock
+    u64 deadline;
+
+    // wheel slot chain or inbox chain, whichever the room is in
+    struct room *next;
+
+    // only ever touched by the worker owning the room
+    u64 ticks, missed, games;
+    u64 cost_max_ns;
+    // exponentially weighted tick cost, this is what load balancing looks at
+    f64 cost_avg_ns;
+
+    // the last checkpoint round the room was saved in
+    u32 checkpoint_round;
+};
+
+struct room_stats {
+    u32 id;
+    u32 n_snakes;
+    u32 bound_x, bound_y;
+    u64 ticks, missed, games;
+    f64 cost_avg_ns;
+    u64 cost_max_ns;
+};
+
+// cumulative counters of a worker, published every report period
+struct worker_stats {
+    u32 rooms;
+    u64 ticks, missed, games;
+    u64 migrated_out;
+    u64 cost_total_ns, cost_max_ns;
+    // rooms copied for checkpoints and the time that took, outside of the tick costs
+    u64 checkpoints;
+    u64 checkpoint_total_ns, checkpoint_max_ns;
+
+    u32 n_top;
+    struct room_stats top[TOP_ROOMS];
+};
+
+struct worker {
+    u32 index;
+    SDL_Thread *thread;
+
+    SDL_mutex *lock;
+    SDL_cond *wake;
+
+    // rooms handed to this worker, protected by lock
+    struct room *inbox;
+
+    // published copy of stats, protected by lock
+    struct worker_stats published;
+
+    // everything below is private to the worker thread
+    struct room *wheel[WHEEL_SLOTS];
+    // wheel slots before this one have been fully processed
+    u64 wheel_time;
+
+    struct worker_stats stats;
+    f64 load_ppm;
+    u64 next_publish;
+
+    // parts per million of one core spent ticking, read by the balancer
+    SDL_atomic_t load;
+    // index of the worker that should get one of our rooms, -1 when nothing is asked
+    SDL_atomic_t donate_to;
+    SDL_atomic_t donate_ppm;
+};
+
+struct server {
+    u32 n_workers;
+    struct worker workers[MAX_WORKERS];
+
+    u64 miss_slack_us;
+    u64 report_us;
+
+    // NULL without checkpoints
+    struct checkpoint_writer *checkpoint;
+
+    SDL_atomic_t running;
+};
+
+
+static u64 now_us(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
+
+    // split to not overflow the multiplication on long uptimes
+    return counter / freq * 1000000 + counter % freq * 1000000 / freq;
+}
+
+static u64 now_ns(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
+
+    return counter / freq * 1000000000 + counter % freq * 1000000000 / freq;
+}
+
+static f64 room_load_ppm(const struct room *room) {
+    return room->cost_avg_ns * 1000 / room->tick_us;
+}
+
+// one entry of --rules
+struct rule_spec {
+    bool walls;
+    u32 growth;
+    u32 rocks_pct;
+};
+
+// starts a game for every snake of the room, under the room's rules
+static void start_game(struct room *room, u32 bound_x, u32 bound_y) {
+    for (u32 i=0; i<room->n_snakes; i++)
+	init_snake(&room->snakes[i], bound_x, bound_y, room->next_seed++);
+
+    if (room->rocks) {
+	u32 n_words = ((u64) bound_x * bound_y + 63) / 64;
+	memset(room->rocks, 0, n_words * sizeof(*room->rocks));
+
+	// rocks never land on a snake, they could still box one in, that just makes for a short game
+	struct rng rng;
+	seed_rng(&rng, room->next_seed++);
+
+	u32 n_rocks = (u64) bound_x * bound_y * room->rocks_pct / 100;
+	for (u32 i=0; i<n_rocks; i++) {
+	    struct vec2 pos = { .x = uniform_u32(&rng, bound_x), .y = uniform_u32(&rng, bound_y) };
+
+	    bool free_cell = true;
+	    for (u32 k=0; k<room->n_snakes && free_cell; k++)
+		free_cell = !cell_occupied(&room->snakes[k], pos);
+
+	    if (free_cell) {
+		u32 cell = pos.y * bound_x + pos.x;
+		room->rocks[cell / 64] |= 1ull << (cell % 64);
+	    }
+	}
+    }
+
+    // the rocks keep off the bodies, with walls set_rules can still move one to where it fits,
+    // and if rocks leave it nowhere to go the snake starts out dead, which just makes for a short game
+    for (u32 i=0; i<room->n_snakes; i++)
+	if (!set_rules(&room->snakes[i], &room->rules))
+	    room->snakes[i].died = true;
+}
+
+static struct room *create_room(u32 id, u32 n_snakes, u32 bound_x, u32 bound_y, const struct rule_spec *spec,
+				u64 tick_us, u64 base_seed) {
+    struct room *room = calloc(1, sizeof(*room));
+    assert(room);
+
+    room->id = id;
+    room->n_snakes = n_snakes;
+    room->tick_us = tick_us;
+    room->next_seed = base_seed ^ ((u64) id << 32);
+
+    room->rules.walls = spec->walls;
+    room->rules.growth = spec->growth;
+    room->rocks_pct = spec->rocks_pct;
+    if (spec->rocks_pct > 0) {
+	room->rocks = calloc(((u64) bound_x * bound_y + 63) / 64, sizeof(*room->rocks));
+	assert(room->rocks);
+	room->rules.obstacles = room->rocks;
+    }
+
+    room->snakes = malloc(n_snakes * sizeof(*room->snakes));
+    assert(room->snakes);
+
+    start_game(room, bound_x, bound_y);
+
+    return room;
+}
+
+static void destroy_room(struct room *room) {
+    for (u32 i=0; i<room->n_snakes; i++)
+	free_snake(&room->snakes[i]);
+
+    free(room->snakes);
+    free(room->rocks);
+    free(room);
+}
+
+// returns true when the room finished a game and started the next one
+static bool tick_room(struct room *room) {
+    bool all_died = true;
+    bool cleared = false;
+
+    for (u32 i=0; i<room->n_snakes && !cleared; i++) {
+	struct snake *snake = &room->snakes[i];
+
+	if (!snake->died) {
+	    snake->direction = bot_greedy(snake);
+
+	    // a snake about to clear its board ends the game for the whole room, the move itself would never return
+	    cleared = eats_last_free_cell(snake);
+	    if (!cleared)
+		move_snake(snake);
+	}
+
+	if (!snake->died)
+	    all_died = false;
+    }
+
+    // a room never closes, once everyone is dead or a board is cleared the next game starts
+    if (all_died || cleared) {
+	room->games++;
+
+	u32 bound_x = room->snakes[0].bound_x, bound_y = room->snakes[0].bound_y;
+
+	for (u32 i=0; i<room->n_snakes; i++)
+	    free_snake(&room->snakes[i]);
+
+	start_game(room, bound_x, bound_y);
+    }
+
+    return all_died || cleared;
+}
+
+
+static u32 rock_words(u32 bound_x, u32 bound_y) {
+    return ((u64) bound_x * bound_y + 63) / 64;
+}
+
+// copies the room into a checkpoint record, between two of its ticks so it is consistent without stopping anyone
+static void save_room(struct checkpoint_writer *writer, struct worker *worker, struct room *room) {
+    u64 start = now_ns();
+
+    u32 bound_x = room->snakes[0].bound_x, bound_y = room->snakes[0].bound_y;
+    u32 n_words = room->rocks ? rock_words(bound_x, bound_y) : 0;
+
+    u32 size = ROOM_RECORD_HEADER_SIZE + n_words * 8;
+    for (u32 i=0; i<room->n_snakes; i++)
+	size += checkpoint_snake_size(&room->snakes[i]);
+
+    struct checkpoint_record *record = checkpoint_record_alloc(writer, size);
+    u8 *buf = record->data;
+
+    put_u32(buf, room->id);
+    put_u32(buf + 4, room->n_snakes);
+    put_u32(buf + 8, bound_x);
+    put_u32(buf + 12, bound_y);
+    buf[16] = room->rules.walls;
+    buf[17] = 0;
+    put_u16(buf + 18, 0);
+    put_u32(buf + 20, room->rules.growth);
+    put_u32(buf + 24, room->rocks_pct);
+    put_u64(buf + 28, room->next_seed);
+    put_u64(buf + 36, room->ticks);
+    put_u64(buf + 44, room->missed);
+    put_u64(buf + 52, room->games);
+    put_u64(buf + 60, room->cost_avg_ns);
+
+    buf += ROOM_RECORD_HEADER_SIZE;
+    for (u32 i=0; i<n_words; i++, buf += 8)
+	put_u64(buf, room->rocks[i]);
+
+    for (u32 i=0; i<room->n_snakes; i++)
+	buf = checkpoint_put_snake(buf, &room->snakes[i]);
+
+    assert(buf == record->data + size);
+
+    room->checkpoint_round = record->round;
+    checkpoint_submit(writer, record);
+
+    u64 cost = now_ns() - start;
+
+    worker->stats.checkpoints++;
+    worker->stats.checkpoint_total_ns += cost;
+    if (cost > worker->stats.checkpoint_max_ns)
+	worker->stats.checkpoint_max_ns = cost;
+}
+
+// a room as it was saved, NULL if the record does not hold one
+// the rooms are only ever driven by bots, which pick the same moves from the same state, so there is no input to
+// replay on top of the checkpoint, the room just goes on from the tick it was saved at
+static struct room *load_room(const u8 *buf, u32 size, u64 tick_us) {
+    const u8 *end = buf + size;
+
+    if (size < ROOM_RECORD_HEADER_SIZE)
+	return NULL;
+
+    u32 n_snakes = get_u32(buf + 4);
+    u32 bound_x = get_u32(buf + 8), bound_y = get_u32(buf + 12);
+    u32 rocks_pct = get_u32(buf + 24);
+
+    if (n_snakes == 0 || bound_x == 0 || bound_y == 0 || bound_x > UINT16_MAX || bound_y > UINT16_MAX ||
+	    rocks_pct >= 100)
+	return NULL;
+
+    u32 n_words = rocks_pct > 0 ? rock_words(bound_x, bound_y) : 0;
+    if ((u64) (size - ROOM_RECORD_HEADER_SIZE) < (u64) n_words * 8)
+	return NULL;
+
+    struct room *room = calloc(1, sizeof(*room));
+    assert(room);
+
+    room->id = get_u32(buf);
+    room->tick_us = tick_us;
+    room->rules.walls = buf[16];
+    room->rules.growth = get_u32(buf + 20);
+    room->rocks_pct = rocks_pct;
+    room->next_seed = get_u64(buf + 28);
+    room->ticks = get_u64(buf + 36);
+    room->missed = get_u64(buf + 44);
+    room->games = get_u64(buf + 52);
+    room->cost_avg_ns = get_u64(buf + 60);
+
+    buf += ROOM_RECORD_HEADER_SIZE;
+
+    if (n_words) {
+	room->rocks = malloc(n_words * sizeof(*room->rocks));
+	assert(room->rocks);
+
+	for (u32 i=0; i<n_words; i++, buf += 8)
+	    room->rocks[i] = get_u64(buf);
+	room->rules.obstacles = room->rocks;
+    }
+
+    room->snakes = calloc(n_snakes, sizeof(*room->snakes));
+    assert(room->snakes);
+
+    for (; room->n_snakes < n_snakes; room->n_snakes++) {
+	buf = checkpoint_get_snake(buf, end, bound_x, bound_y, &room->rules, &room->snakes[room->n_snakes]);
+	if (!buf)
+	    break;
+    }
+
+    if (room->n_snakes < n_snakes) {
+	destroy_room(room);
+	return NULL;
+    }
+
+    return room;
+}
+
+static void wheel_insert(struct worker *worker, struct room *room) {
+    u64 slot = room->deadline / WHEEL_SLOT_US;
+
+    // a deadline that already passed goes into the slot being processed right now
+    if (slot < worker->wheel_time)
+	slot = worker->wheel_time;
+
+    room->next = worker->wheel[slot % WHEEL_SLOTS];
+    worker->wheel[slot % WHEEL_SLOTS] = room;
+}
+
+// unlinks all rooms whose deadline is <= now and returns them as a chain
+static struct room *wheel_take_due(struct worker *worker, u64 now) {
+    u64 end = now / WHEEL_SLOT_US;
+    u64 start = worker->wheel_time;
+
+    // we fell behind by more than a turn, every slot is visited once anyway
+    if (end - start >= WHEEL_SLOTS)
+	start = end - WHEEL_SLOTS + 1;
+
+    struct room *due = NULL;
+
+    for (u64 t = start; t <= end; t++) {
+	struct room **link = &worker->wheel[t % WHEEL_SLOTS];
+
+	while (*link) {
+	    struct room *room = *link;
+
+	    if (room->deadline <= now) {
+		*link = room->next;
+		room->next = due;
+		due = room;
+	    } else {
+		link = &room->next;
+	    }
+	}
+    }
+
+    // the current slot may still hold rooms due later in this ms, so it is processed again next time
+    worker->wheel_time = end;
+
+    return due;
+}
+
+// microseconds until the earliest deadline in the wheel, one turn when it is empty
+// a slot can hold rooms of later turns, so the earliest one in the first non empty slot is not always the
+// earliest of all, the scan goes on until the slots start past the earliest deadline seen so far
+static u64 wheel_next_wait(const struct worker *worker, u64 now) {
+    u64 earliest = UINT64_MAX;
+
+    for (u64 t = worker->wheel_time; t < worker->wheel_time + WHEEL_SLOTS; t++) {
+	// every room in this slot and the ones after it is due at the start of its slot or later
+	if (t * WHEEL_SLOT_US >= earliest)
+	    break;
+
+	for (const struct room *room = worker->wheel[t % WHEEL_SLOTS]; room; room = room->next)
+	    if (room->deadline < earliest)
+		earliest = room->deadline;
+    }
+
+    if (earliest == UINT64_MAX)
+	return (u64) WHEEL_SLOTS * WHEEL_SLOT_US;
+
+    return earliest <= now ? 0 : earliest - now;
+}
+
+static void run_due_rooms(struct server *server, struct worker *worker, struct room *due, u64 now) {
+    while (due) {
+	struct room *room = due;
+	due = due->next;
+
+	if (now - room->deadline > server->miss_slack_us) {
+	    room->missed++;
+	    worker->stats.missed++;
+	}
+
+	u64 start = now_ns();
+	if (tick_room(room))
+	    worker->stats.games++;
+	u64 cost = now_ns() - start;
+
+	f64 old_load = room_load_ppm(room);
+
+	room->cost_avg_ns = room->ticks ? room->cost_avg_ns * 0.95 + cost * 0.05 : cost;
+	if (cost > room->cost_max_ns)
+	    room->cost_max_ns = cost;
+	room->ticks++;
+
+	worker->load_ppm += room_load_ppm(room) - old_load;
+
+	worker->stats.ticks++;
+	worker->stats.cost_total_ns += cost;
+	if (cost > worker->stats.cost_max_ns)
+	    worker->stats.cost_max_ns = cost;
+
+	if (server->checkpoint && room->checkpoint_round != checkpoint_round(server->checkpoint))
+	    save_room(server->checkpoint, worker, room);
+
+	// ticks that could not happen in time are dropped instead of run back to back
+	room->deadline += room->tick_us;
+	now = now_us();
+	while (room->deadline <= now)
+	    room->deadline += room->tick_us;
+
+	wheel_insert(worker, room);
+    }
+}
+
+// hands the room closest to the requested load over to another worker
+static void donate_room(struct server *server, struct worker *worker) {
+    s32 target = SDL_AtomicGet(&worker->donate_to);
+    if (target < 0)
+	return;
+
+    SDL_AtomicSet(&worker->donate_to, -1);
+
+    if (worker->stats.rooms < 2 || (u32) target == worker->index)
+	return;
+
+    f64 wanted = SDL_AtomicGet(&worker->donate_ppm);
+
+    struct room **best_link = NULL;
+    f64 best_diff = 0;
+    f64 total = 0;
+
+    for (u32 s=0; s<WHEEL_SLOTS; s++) {
+	for (struct room **link = &worker->wheel[s]; *link; link = &(*link)->next) {
+	    f64 load = room_load_ppm(*link);
+	    f64 diff = load > wanted ? load - wanted : wanted - load;
+
+	    total += load;
+
+	    // moving a room bigger than the gap would just move the imbalance
+	    if (load <= 2 * wanted && (!best_link || diff < best_diff)) {
+		best_link = link;
+		best_diff = diff;
+	    }
+	}
+    }
+
+    // resync the running sum while we walked everything anyway
+    worker->load_ppm = total;
+
+    if (!best_link)
+	return;
+
+    struct room *room = *best_link;
+    *best_link = room->next;
+
+    worker->load_ppm -= room_load_ppm(room);
+    worker->stats.rooms--;
+    worker->stats.migrated_out++;
+
+    struct worker *to = &server->workers[target];
+
+    SDL_LockMutex(to->lock);
+    room->next = to->inbox;
+    to->inbox = room;
+    SDL_CondSignal(to->wake);
+    SDL_UnlockMutex(to->lock);
+}
+
+static void publish_stats(struct worker *worker) {
+    struct worker_stats *stats = &worker->stats;
+
+    // keep the most expensive rooms, there are few enough top slots that insertion is fine
+    stats->n_top = 0;
+
+    for (u32 s=0; s<WHEEL_SLOTS; s++) {
+	for (const struct room *room = worker->wheel[s]; room; room = room->next) {
+	    u32 pos = stats->n_top;
+	    while (pos > 0 && stats->top[pos-1].cost_avg_ns < room->cost_avg_ns)
+		pos--;
+
+	    if (pos >= TOP_ROOMS)
+		continue;
+
+	    u32 last = stats->n_top < TOP_ROOMS ? stats->n_top : TOP_ROOMS - 1;
+	    memmove(&stats->top[pos+1], &stats->top[pos], (last - pos) * sizeof(stats->top[0]));
+
+	    struct room_stats *rs = &stats->top[pos];
+	    rs->id = room->id;
+	    rs->n_snakes = room->n_snakes;
+	    rs->bound_x = room->snakes[0].bound_x;
+	    rs->bound_y = room->snakes[0].bound_y;
+	    rs->ticks = room->ticks;
+	    rs->missed = room->missed;
+	    rs->games = room->games;
+	    rs->cost_avg_ns = room->cost_avg_ns;
+	    rs->cost_max_ns = room->cost_max_ns;
+
+	    if (stats->n_top < TOP_ROOMS)
+		stats->n_top++;
+	}
+    }
+
+    SDL_LockMutex(worker->lock);
+    worker->published = *stats;
+    SDL_UnlockMutex(worker->lock);
+}
+
+struct worker_arg {
+    struct server *server;
+    struct worker *worker;
+};
+
+static int worker_main(void *data) {
+    struct worker_arg *arg = data;
+    struct server *server = arg->server;
+    struct worker *worker = arg->worker;
+
+    worker->wheel_time = now_us() / WHEEL_SLOT_US;
+    worker->next_publish = now_us();
+
+    while (SDL_AtomicGet(&server->running)) {
+	SDL_LockMutex(worker->lock);
+	struct room *inbox = worker->inbox;
+	worker->inbox = NULL;
+	SDL_UnlockMutex(worker->lock);
+
+	while (inbox) {
+	    struct room *room = inbox;
+	    inbox = inbox->next;
+
+	    worker->load_ppm += room_load_ppm(room);
+	    worker->stats.rooms++;
+	    wheel_insert(worker, room);
+	}
+
+	donate_room(server, worker);
+
+	u64 now = now_us();
+	run_due_rooms(server, worker, wheel_take_due(worker, now), now);
+
+	SDL_AtomicSet(&worker->load, (int) worker->load_ppm);
+
+	now = now_us();
+	if (now >= worker->next_publish) {
+	    publish_stats(worker);
+	    worker->next_publish = now + server->report_us / 8;
+	}
+
+	u64 wait = wheel_next_wait(worker, now_us());
+	if (wait == 0)
+	    continue;
+
+	// round up so we never wake before the deadline and spin
+	u32 wait_ms = (wait + 999) / 1000;
+
+	SDL_LockMutex(worker->lock);
+	if (!worker->inbox && SDL_AtomicGet(&worker->donate_to) < 0 && SDL_AtomicGet(&server->running))
+	    SDL_CondWaitTimeout(worker->wake, worker->lock, wait_ms);
+	SDL_UnlockMutex(worker->lock);
+    }
+
+    publish_stats(worker);
+
+    for (u32 s=0; s<WHEEL_SLOTS; s++) {
+	while (worker->wheel[s]) {
+	    struct room *room = worker->wheel[s];
+	    worker->wheel[s] = room->next;
+	    destroy_room(room);
+	}
+    }
+
+    return 0;
+}
+
+
+// asks the busiest worker to give a room to the least busy one if they are far enough apart
+static void balance(struct server *server) {
+    u32 max_idx = 0, min_idx = 0;
+    s32 max_load = -1, min_load = -1;
+
+    for (u32 i=0; i<server->n_workers; i++) {
+	s32 load = SDL_AtomicGet(&server->workers[i].load);
+
+	if (max_load < 0 || load > max_load) {
+	    max_load = load;
+	    max_idx = i;
+	}
+	if (min_load < 0 || load < min_load) {
+	    min_load = load;
+	    min_idx = i;
+	}
+    }
+
+    // 2% of a core, or a fifth of the busiest worker's load, whichever is bigger
+    s32 threshold = max_load / 5;
+    if (threshold < 20000)
+	threshold = 20000;
+
+    if (max_idx == min_idx || max_load - min_load < threshold)
+	return;
+
+    struct worker *worker = &server->workers[max_idx];
+
+    SDL_AtomicSet(&worker->donate_ppm, (max_load - min_load) / 2);
+    SDL_AtomicSet(&worker->donate_to, min_idx);
+
+    SDL_LockMutex(worker->lock);
+    SDL_CondSignal(worker->wake);
+    SDL_UnlockMutex(worker->lock);
+}
+
+static void print_room_stats(const struct room_stats *rs) {
+    printf("    room %u (%u snake%s %ux%u): tick avg %.1fus max %.1fus, %llu ticks, %llu missed, %llu games\n",
+	    rs->id, rs->n_snakes, rs->n_snakes == 1 ? "" : "s", rs->bound_x, rs->bound_y,
+	    rs->cost_avg_ns / 1000, rs->cost_max_ns / 1000.0,
+	    (unsigned long long) rs->ticks, (unsigned long long) rs->missed, (unsigned long long) rs->games);
+}
+
+// prints totals since the previous report and the most expensive rooms over all workers
+static void report(struct server *server, struct worker_stats *prev, f64 elapsed_s, f64 interval_s) {
+    struct worker_stats total = {0};
+    struct worker_stats cur[MAX_WORKERS];
+    struct room_stats top[MAX_WORKERS * TOP_ROOMS];
+    u32 n_top = 0;
+
+    for (u32 i=0; i<server->n_workers; i++) {
+	struct worker *worker = &server->workers[i];
+
+	SDL_LockMutex(worker->lock);
+	cur[i] = worker->published;
+	SDL_UnlockMutex(worker->lock);
+
+	total.rooms += cur[i].rooms;
+	total.ticks += cur[i].ticks - prev[i].ticks;
+	total.missed += cur[i].missed - prev[i].missed;
+	total.games += cur[i].games - prev[i].games;
+	total.migrated_out += cur[i].migrated_out - prev[i].migrated_out;
+	total.cost_total_ns += cur[i].cost_total_ns - prev[i].cost_total_ns;
+	if (cur[i].cost_max_ns > total.cost_max_ns)
+	    total.cost_max_ns = cur[i].cost_max_ns;
+	total.checkpoints += cur[i].checkpoints - prev[i].checkpoints;
+	total.checkpoint_total_ns += cur[i].checkpoint_total_ns - prev[i].checkpoint_total_ns;
+	if (cur[i].checkpoint_max_ns > total.checkpoint_max_ns)
+	    total.checkpoint_max_ns = cur[i].checkpoint_max_ns;
+
+	memcpy(&top[n_top], cur[i].top, cur[i].n_top * sizeof(top[0]));
+	n_top += cur[i].n_top;
+    }
+
+    printf("[%7.1fs] rooms %u, %.0f ticks/s, missed %llu (%.2f%%), %llu games, %llu migrations, tick avg %.1fus max %.1fus\n",
+	    elapsed_s, total.rooms, total.ticks / interval_s,
+	    (unsigned long long) total.missed, total.ticks ? 100.0 * total.missed / total.ticks : 0.0,
+	    (unsigned long long) total.games, (unsigned long long) total.migrated_out,
+	    total.ticks ? total.cost_total_ns / 1000.0 / total.ticks : 0.0, total.cost_max_ns / 1000.0);
+
+    if (total.checkpoints)
+	printf("    checkpoint: %llu rooms copied, copy avg %.1fus max %.1fus\n",
+		(unsigned long long) total.checkpoints, total.checkpoint_total_ns / 1000.0 / total.checkpoints,
+		total.checkpoint_max_ns / 1000.0);
+
+    printf("    load:");
+    for (u32 i=0; i<server->n_workers; i++)
+	printf(" w%u %.1f%% (%u)", i, SDL_AtomicGet(&server->workers[i].load) / 10000.0, cur[i].rooms);
+    printf("\n");
+
+    // selection of the overall most expensive out of every worker's top list
+    for (u32 k=0; k<TOP_ROOMS && k<n_top; k++) {
+	u32 best = k;
+	for (u32 j=k+1; j<n_top; j++)
+	    if (top[j].cost_avg_ns > top[best].cost_avg_ns)
+		best = j;
+
+	struct room_stats tmp = top[k];
+	top[k] = top[best];
+	top[best] = tmp;
+
+	print_room_stats(&top[k]);
+    }
+
+    memcpy(prev, cur, server->n_workers * sizeof(cur[0]));
+}
+
+
+struct grid_size {
+    u32 x, y;
+};
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s [options]\n"
+	    "  --rooms N        number of rooms to host (default 1000)\n"
+	    "  --workers N      worker threads (default: cpu count)\n"
+	    "  --snakes N       snakes per room (default 1)\n"
+	    "  --grid WxH,...   grid sizes, rooms cycle through them (default 20x20)\n"
+	    "  --rules R,...    rule variants, rooms cycle through them (default classic)\n"
+	    "                   R joins walls, growN and rocksN (N%% of cells) with +, e.g. walls+grow3\n"
+	    "  --tick-ms N      tick period of every room (default 50)\n"
+	    "  --slack-ms N     how late a tick may start before it counts as missed (default 5)\n"
+	    "  --report-ms N    time between reports (default 1000)\n"
+	    "  --seconds N      stop after N seconds, 0 runs forever (default 0)\n"
+	    "  --seed N         base seed of all rooms (default: time)\n"
+	    "  --checkpoint F   saves every room to F periodically, without stopping them\n"
+	    "  --checkpoint-s N seconds between checkpoints (default 60)\n"
+	    "  --resume F       starts with the rooms saved in checkpoint F instead of new ones,\n"
+	    "                   --rooms, --snakes, --grid and --rules are then taken from F\n",
+	    prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    u32 n_rooms = 1000;
+    u32 n_workers = SDL_GetCPUCount();
+    u32 n_snakes = 1;
+    u32 tick_ms = 50;
+    u32 slack_ms = 5;
+    u32 report_ms = 1000;
+    u32 seconds = 0;
+    u64 seed = time(NULL);
+    const char *checkpoint_path = NULL;
+    u32 checkpoint_s = 60;
+    const char *resume_path = NULL;
+
+    struct grid_size grids[MAX_GRIDS] = {{ GRID_WIDTH, GRID_HEIGHT }};
+    u32 n_grids = 1;
+
+    struct rule_spec rules[MAX_RULES] = {{ 0 }};
+    u32 n_rules = 1;
+
+    for (int i=1; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--rooms") == 0)
+	    n_rooms = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--workers") == 0)
+	    n_workers = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--snakes") == 0)
+	    n_snakes = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--tick-ms") == 0)
+	    tick_ms = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--slack-ms") == 0)
+	    slack_ms = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--report-ms") == 0)
+	    report_ms = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--seconds") == 0)
+	    seconds = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--seed") == 0)
+	    seed = strtoull(val, NULL, 10);
+	else if (strcmp(arg, "--checkpoint") == 0)
+	    checkpoint_path = val;
+	else if (strcmp(arg, "--checkpoint-s") == 0)
+	    checkpoint_s = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--resume") == 0)
+	    resume_path = val;
+	else if (strcmp(arg, "--grid") == 0) {
+	    n_grids = 0;
+	    const char *p = val;
+	    while (*p && n_grids < MAX_GRIDS) {
+		char *end;
+		grids[n_grids].x = strtoul(p, &end, 10);
+		if (*end != 'x')
+		    usage(argv[0]);
+		grids[n_grids].y = strtoul(end+1, &end, 10);
+		if (grids[n_grids].x == 0 || grids[n_grids].y == 0)
+		    usage(argv[0]);
+		n_grids++;
+		p = *end == ',' ? end+1 : end;
+	    }
+	} else if (strcmp(arg, "--rules") == 0) {
+	    n_rules = 0;
+	    const char *p = val;
+	    while (*p && n_rules < MAX_RULES) {
+		struct rule_spec *spec = &rules[n_rules++];
+		memset(spec, 0, sizeof(*spec));
+
+		while (*p && *p != ',') {
+		    char *end = (char *) p;
+		    if (strncmp(p, "classic", 7) == 0)
+			end += 7;
+		    else if (strncmp(p, "walls", 5) == 0) {
+			spec->walls = true;
+			end += 5;
+		    } else if (strncmp(p, "grow", 4) == 0)
+			spec->growth = strtoul(p+4, &end, 10);
+		    else if (strncmp(p, "rocks", 5) == 0) {
+			spec->rocks_pct = strtoul(p+5, &end, 10);
+			if (spec->rocks_pct >= 100)
+			    usage(argv[0]);
+		    }
+
+		    if (end == p || (*end != '+' && *end != ',' && *end))
+			usage(argv[0]);
+		    p = *end == '+' ? end+1 : end;
+		}
+		if (*p == ',')
+		    p++;
+	    }
+	} else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    if (n_workers == 0)
+	n_workers = 1;
+    if (n_workers > MAX_WORKERS)
+	n_workers = MAX_WORKERS;
+    if (n_snakes == 0 || tick_ms == 0 || report_ms == 0 || n_grids == 0 || n_rules == 0 || checkpoint_s == 0)
+	usage(argv[0]);
+
+    // with walls the starting body has to lie straight on the grid with a cell to spare ahead of it
+    for (u32 g=0; g<n_grids; g++) {
+	for (u32 r=0; r<n_rules; r++) {
+	    if (rules[r].walls && grids[g].x <= INITIAL_SNAKE_LEN && grids[g].y <= INITIAL_SNAKE_LEN) {
+		fprintf(stderr, "walls need a grid at least %u cells across, %ux%u is too small\n",
+			INITIAL_SNAKE_LEN + 1, grids[g].x, grids[g].y);
+		return EXIT_FAILURE;
+	    }
+	}
+    }
+
+    struct server *server = calloc(1, sizeof(*server));
+    assert(server);
+
+    server->n_workers = n_workers;
+    server->miss_slack_us = (u64) slack_ms * 1000;
+    server->report_us = (u64) report_ms * 1000;
+    SDL_AtomicSet(&server->running, 1);
+
+    struct worker_arg args[MAX_WORKERS];
+
+    // rooms start spread round robin with their first ticks staggered over one period
+    u64 start = now_us();
+
+    for (u32 i=0; i<n_workers; i++) {
+	struct worker *worker = &server->workers[i];
+
+	worker->index = i;
+	worker->lock = SDL_CreateMutex();
+	worker->wake = SDL_CreateCond();
+	if (!worker->lock || !worker->wake) {
+	    fprintf(stderr, "unable to create worker sync: %s\n", SDL_GetError());
+	    return EXIT_FAILURE;
+	}
+	SDL_AtomicSet(&worker->donate_to, -1);
+    }
+
+    struct checkpoint_reader resume;
+    u32 first_round = 0;
+
+    if (resume_path) {
+	if (!checkpoint_open(&resume, resume_path) || resume.n_records == 0) {
+	    fprintf(stderr, "unable to read checkpoint %s\n", resume_path);
+	    return EXIT_FAILURE;
+	}
+
+	n_rooms = resume.n_records;
+	first_round = resume.round;
+    }
+
+    for (u32 i=0; i<n_rooms; i++) {
+	struct room *room;
+
+	if (resume_path) {
+	    u32 size;
+	    const u8 *record = checkpoint_next(&resume, &size);
+
+	    room = record ? load_room(record, size, (u64) tick_ms * 1000) : NULL;
+	    if (!room) {
+		fprintf(stderr, "room %u of checkpoint %s is broken\n", i, resume_path);
+		return EXIT_FAILURE;
+	    }
+	} else {
+	    struct grid_size grid = grids[i % n_grids];
+	    room = create_room(i, n_snakes, grid.x, grid.y, &rules[i % n_rules], (u64) tick_ms * 1000, seed);
+	}
+
+	room->checkpoint_round = first_round;
+	room->deadline = start + (u64) i * room->tick_us / n_rooms;
+
+	struct worker *worker = &server->workers[i % n_workers];
+	room->next = worker->inbox;
+	worker->inbox = room;
+    }
+
+    if (resume_path)
+	checkpoint_close(&resume);
+
+    struct checkpoint_writer checkpoint;
+
+    if (checkpoint_path) {
+	if (!checkpoint_writer_start(&checkpoint, checkpoint_path, n_rooms, first_round)) {
+	    fprintf(stderr, "unable to start the checkpoint writer: %s\n", SDL_GetError());
+	    return EXIT_FAILURE;
+	}
+	server->checkpoint = &checkpoint;
+    }
+
+    for (u32 i=0; i<n_workers; i++) {
+	args[i].server = server;
+	args[i].worker = &server->workers[i];
+
+	char name[16];
+	snprintf(name, sizeof(name), "worker%u", i);
+
+	server->workers[i].thread = SDL_CreateThread(worker_main, name, &args[i]);
+	if (!server->workers[i].thread) {
+	    fprintf(stderr, "unable to create worker thread: %s\n", SDL_GetError());
+	    return EXIT_FAILURE;
+	}
+    }
+
+    if (resume_path)
+	printf("resuming %u rooms from checkpoint round %u on %u workers, %ums ticks\n",
+		n_rooms, first_round, n_workers, tick_ms);
+    else
+	printf("hosting %u rooms of %u snake%s on %u workers, %ums ticks\n",
+		n_rooms, n_snakes, n_snakes == 1 ? "" : "s", n_workers, tick_ms);
+
+    struct worker_stats prev[MAX_WORKERS] = {0};
+    u64 last_report = start;
+    u64 last_checkpoint = start;
+    u32 written_round = first_round;
+
+    // the main thread only balances and reports, and wakes up for that a few times per report
+    u32 balance_ms = report_ms / 4 ? report_ms / 4 : 1;
+
+    while (true) {
+	SDL_Delay(balance_ms);
+
+	u64 now = now_us();
+
+	balance(server);
+
+	if (now - last_report >= server->report_us) {
+	    report(server, prev, (now - start) / 1e6, (now - last_report) / 1e6);
+	    last_report = now;
+	}
+
+	// a round still being written delays the next one rather than piling up copies of every room
+	if (server->checkpoint && now - last_checkpoint >= (u64) checkpoint_s * 1000000 &&
+		checkpoint_start_round(server->checkpoint))
+	    last_checkpoint = now;
+
+	if (server->checkpoint && (u32) SDL_AtomicGet(&checkpoint.done_round) != written_round) {
+	    written_round = SDL_AtomicGet(&checkpoint.done_round);
+	    printf("    checkpoint round %u done\n", written_round);
+	}
+
+	if (seconds && now - start >= (u64) seconds * 1000000)
+	    break;
+    }
+
+    SDL_AtomicSet(&server->running, 0);
+
+    for (u32 i=0; i<n_workers; i++) {
+	struct worker *worker = &server->workers[i];
+
+	SDL_LockMutex(worker->lock);
+	SDL_CondSignal(worker->wake);
+	SDL_UnlockMutex(worker->lock);
+    }
+
+    for (u32 i=0; i<n_workers; i++)
+	SDL_WaitThread(server->workers[i].thread, NULL);
+
+    if (server->checkpoint)
+	checkpoint_writer_stop(server->checkpoint);
+
+    struct worker_stats zero[MAX_WORKERS] = {0};
+    u64 end = now_us();
+
+    printf("totals:\n");
+    report(server, zero, (end - start) / 1e6, (end - start) / 1e6);
+
+    // rooms that were still in flight between workers when they stopped
+    for (u32 i=0; i<n_workers; i++) {
+	struct worker *worker = &server->workers[i];
+
+	while (worker->inbox) {
+	    struct room *room = worker->inbox;
+	    worker->inbox = room->next;
+	    destroy_room(room);
+	}
+
+	SDL_DestroyCond(worker->wake);
+	SDL_DestroyMutex(worker->lock);
+    }
+
+    free(server);
+
+    return EXIT_SUCCESS;
+}
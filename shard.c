@@ -0,0 +1,794 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+
+#include "types.h"
+#include "snake.h"
+#include "bots.h"
+#include "hist.h"
+#include "net.h"
+#include "os.h"
+#include "wire.h"
+
+// runs a batch of games split into shards over worker processes
+// the coordinator spawns the local workers, hands out shards and merges what comes back,
+// a shard only counts once its worker said it is done, so a worker that crashes halfway just gets its shard run again
+// workers talk to the coordinator over a socket, so workers on other machines can join with --worker HOST:PORT
+//
+// every message is SHARD_FRAME_SIZE bytes, byte 0 is the type:
+//   hello   worker -> coordinator  u32 magic at 4, u32 worker id at 8 (SHARD_REMOTE_ID when not spawned by us)
+//   assign  coordinator -> worker  u32 shard at 4, u32 first game at 8, u32 games at 12, u32 bound_x at 16,
+//                                  u32 bound_y at 20, u64 seed at 24
+//   bye     coordinator -> worker
+//   result  worker -> coordinator  u32 shard at 4, u32 game at 8, u32 score at 12, u32 ticks at 16
+//   done    worker -> coordinator  u32 shard at 4, u32 games at 8, u64 cpu ns at 16
+
+
+#define SHARD_FRAME_SIZE 32
+#define SHARD_MAGIC 0x44524853
+#define SHARD_REMOTE_ID 0xFFFFFFFF
+
+#define MSG_HELLO 1
+#define MSG_ASSIGN 2
+#define MSG_BYE 3
+#define MSG_RESULT 4
+#define MSG_DONE 5
+
+#define MAX_SLOTS 256
+#define MAX_ATTEMPTS 3
+#define MAX_SPAWNS_PER_SLOT 8
+
+// results are sent in batches of this many frames
+#define RESULT_BATCH 64
+
+// connections that did not say hello yet, each gets this long to do it
+#define MAX_PENDING 64
+#define HELLO_TIMEOUT_NS 5000000000ull
+
+
+static u64 now_ns(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
+
+    return counter / freq * 1000000000 + counter % freq * 1000000000 / freq;
+}
+
+struct batch_stats {
+    u64 games, ticks, total_score, cpu_ns;
+    u32 max_score;
+    struct hist scores;
+    struct hist survival;
+};
+
+static void merge_stats(struct batch_stats *dst, const struct batch_stats *src) {
+    dst->games += src->games;
+    dst->ticks += src->ticks;
+    dst->total_score += src->total_score;
+    dst->cpu_ns += src->cpu_ns;
+    if (src->max_score > dst->max_score)
+	dst->max_score = src->max_score;
+
+    hist_merge(&dst->scores, &src->scores);
+    hist_merge(&dst->survival, &src->survival);
+}
+
+
+// worker side
+
+// blocks until a whole frame is in, false when the coordinator went away
+static bool recv_frame(net_socket sock, u8 *frame) {
+    u32 have = 0;
+
+    while (have < SHARD_FRAME_SIZE) {
+	s32 n = net_recv(sock, frame + have, SHARD_FRAME_SIZE - have);
+
+	if (n > 0) {
+	    have += n;
+	} else if (n == NET_WOULD_BLOCK) {
+	    bool ready;
+	    if (net_poll_readable(&sock, 1, &ready, -1) < 0)
+		return false;
+	} else {
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+static int run_worker(const char *address, u32 worker_id, u32 max_ticks, f64 chaos) {
+    if (!net_init())
+	return EXIT_FAILURE;
+
+    net_socket sock = net_connect(address);
+    if (sock == NET_INVALID_SOCKET) {
+	fprintf(stderr, "worker %u: unable to connect to %s: %s\n", worker_id, address, net_error());
+	return EXIT_FAILURE;
+    }
+
+    u8 frame[SHARD_FRAME_SIZE] = {0};
+    frame[0] = MSG_HELLO;
+    put_u32(frame + 4, SHARD_MAGIC);
+    put_u32(frame + 8, worker_id);
+
+    if (!net_send_all(sock, frame, SHARD_FRAME_SIZE, -1))
+	return EXIT_FAILURE;
+
+    u8 batch[RESULT_BATCH * SHARD_FRAME_SIZE];
+    srand(time(NULL) ^ worker_id);
+
+    while (recv_frame(sock, frame)) {
+	if (frame[0] == MSG_BYE)
+	    break;
+	if (frame[0] != MSG_ASSIGN)
+	    return EXIT_FAILURE;
+
+	u32 shard = get_u32(frame + 4);
+	u32 first_game = get_u32(frame + 8);
+	u32 games = get_u32(frame + 12);
+	u32 bound_x = get_u32(frame + 16);
+	u32 bound_y = get_u32(frame + 20);
+	u64 seed = get_u64(frame + 24);
+
+	u64 start = now_ns();
+	u32 in_batch = 0;
+
+	// for testing crash handling, dies somewhere in the middle of the shard
+	u32 crash_at = chaos > 0 && (f64) rand() / RAND_MAX < chaos ? rand() % games : games;
+
+	for (u32 i=0; i<games; i++) {
+	    if (i == crash_at)
+		abort();
+
+	    struct snake snake;
+	    init_snake(&snake, bound_x, bound_y, seed + first_game + i);
+
+	    u32 ticks = 0;
+	    while (!snake.died && ticks < max_ticks) {
+		snake.direction = bot_greedy(&snake);
+
+		// a cleared board ends the game, the move would never return
+		if (eats_last_free_cell(&snake))
+		    break;
+
+		move_snake(&snake);
+		ticks++;
+	    }
+
+	    u8 *result = batch + in_batch * SHARD_FRAME_SIZE;
+	    memset(result, 0, SHARD_FRAME_SIZE);
+	    result[0] = MSG_RESULT;
+	    put_u32(result + 4, shard);
+	    put_u32(result + 8, first_game + i);
+	    put_u32(result + 12, snake.score);
+	    put_u32(result + 16, ticks);
+
+	    free_snake(&snake);
+
+	    if (++in_batch == RESULT_BATCH) {
+		if (!net_send_all(sock, batch, in_batch * SHARD_FRAME_SIZE, -1))
+		    return EXIT_FAILURE;
+		in_batch = 0;
+	    }
+	}
+
+	u8 *done = batch + in_batch * SHARD_FRAME_SIZE;
+	memset(done, 0, SHARD_FRAME_SIZE);
+	done[0] = MSG_DONE;
+	put_u32(done + 4, shard);
+	put_u32(done + 8, games);
+	put_u64(done + 16, now_ns() - start);
+
+	if (!net_send_all(sock, batch, (in_batch + 1) * SHARD_FRAME_SIZE, -1))
+	    return EXIT_FAILURE;
+    }
+
+    net_close(sock);
+
+    return EXIT_SUCCESS;
+}
+
+
+// coordinator side
+
+struct shard {
+    u32 first_game;
+    u32 games;
+    u32 attempts;
+};
+
+struct slot {
+    bool used;
+    // false for workers that connected on their own, those are only ever lost by disconnecting
+    bool local;
+    bool process_running;
+    struct os_process process;
+    u32 spawns;
+
+    net_socket sock;
+    u8 buf[SHARD_FRAME_SIZE * RESULT_BATCH];
+    u32 len;
+
+    // shard being worked on or -1, with the results that came in for it so far
+    s32 shard;
+    u64 shard_started;
+    struct batch_stats partial;
+};
+
+// an accepted connection waiting for its hello, it sits in the poll set like a worker so nobody waits on it
+struct pending {
+    net_socket sock;
+    u8 frame[SHARD_FRAME_SIZE];
+    u32 len;
+    u64 deadline;
+};
+
+struct coordinator {
+    u32 n_shards;
+    struct shard *shards;
+
+    // shards waiting for a worker, requeued ones go on top
+    u32 *queue;
+    u32 queued;
+
+    u32 shards_done;
+    u32 shards_failed;
+    u32 crashes;
+
+    struct slot slots[MAX_SLOTS];
+    u32 n_local;
+
+    struct pending pending[MAX_PENDING];
+    u32 n_pending;
+
+    u32 bound_x, bound_y;
+    u64 seed;
+    u64 shard_timeout_ns;
+
+    char *worker_argv[16];
+
+    struct batch_stats total;
+};
+
+static void spawn_worker(struct coordinator *coord, u32 id) {
+    struct slot *slot = &coord->slots[id];
+
+    if (slot->spawns >= MAX_SPAWNS_PER_SLOT) {
+	fprintf(stderr, "worker %u: not respawning, it crashed too often\n", id);
+	return;
+    }
+
+    char id_str[16];
+    snprintf(id_str, sizeof(id_str), "%u", id);
+
+    // the id is the only argument that differs between workers
+    char *argv[16];
+    u32 i;
+    for (i=0; coord->worker_argv[i]; i++)
+	argv[i] = strcmp(coord->worker_argv[i], "ID") == 0 ? id_str : coord->worker_argv[i];
+    argv[i] = NULL;
+
+    if (!os_spawn(argv, &slot->process)) {
+	fprintf(stderr, "worker %u: unable to spawn\n", id);
+	return;
+    }
+
+    slot->spawns++;
+    slot->process_running = true;
+}
+
+static void requeue(struct coordinator *coord, u32 shard) {
+    if (++coord->shards[shard].attempts >= MAX_ATTEMPTS) {
+	fprintf(stderr, "shard %u failed %u times, giving up on it\n", shard, MAX_ATTEMPTS);
+	coord->shards_failed++;
+	return;
+    }
+
+    coord->queue[coord->queued++] = shard;
+}
+
+// forgets the worker's connection and anything it was doing, the process gets respawned once it is reaped
+static void lose_worker(struct coordinator *coord, u32 id, const char *why) {
+    struct slot *slot = &coord->slots[id];
+
+    if (slot->shard >= 0) {
+	fprintf(stderr, "worker %u lost (%s), rerunning shard %d\n", id, why, slot->shard);
+	coord->crashes++;
+	requeue(coord, slot->shard);
+    }
+
+    slot->shard = -1;
+    slot->len = 0;
+
+    if (slot->sock != NET_INVALID_SOCKET)
+	net_close(slot->sock);
+    slot->sock = NET_INVALID_SOCKET;
+
+    if (slot->local && slot->process_running)
+	os_process_kill(&slot->process);
+
+    if (!slot->local)
+	slot->used = false;
+}
+
+static void assign(struct coordinator *coord, u32 id) {
+    struct slot *slot = &coord->slots[id];
+
+    if (slot->sock == NET_INVALID_SOCKET || slot->shard >= 0 || coord->queued == 0)
+	return;
+
+    u32 shard = coord->queue[--coord->queued];
+
+    u8 frame[SHARD_FRAME_SIZE] = {0};
+    frame[0] = MSG_ASSIGN;
+    put_u32(frame + 4, shard);
+    put_u32(frame + 8, coord->shards[shard].first_game);
+    put_u32(frame + 12, coord->shards[shard].games);
+    put_u32(frame + 16, coord->bound_x);
+    put_u32(frame + 20, coord->bound_y);
+    put_u64(frame + 24, coord->seed);
+
+    slot->shard = shard;
+    slot->shard_started = now_ns();
+
+    memset(&slot->partial, 0, sizeof(slot->partial));
+
+    if (!net_send_all(slot->sock, frame, SHARD_FRAME_SIZE, 1000))
+	lose_worker(coord, id, "send failed");
+}
+
+static void handle_frame(struct coordinator *coord, u32 id, const u8 *frame) {
+    struct slot *slot = &coord->slots[id];
+    u32 shard = get_u32(frame + 4);
+
+    if ((frame[0] != MSG_RESULT && frame[0] != MSG_DONE) || slot->shard < 0 || shard != (u32) slot->shard) {
+	lose_worker(coord, id, "protocol error");
+	return;
+    }
+
+    if (frame[0] == MSG_RESULT) {
+	u32 score = get_u32(frame + 12);
+	u32 ticks = get_u32(frame + 16);
+
+	slot->partial.games++;
+	slot->partial.ticks += ticks;
+	slot->partial.total_score += score;
+	if (score > slot->partial.max_score)
+	    slot->partial.max_score = score;
+	hist_add(&slot->partial.scores, score);
+	hist_add(&slot->partial.survival, ticks);
+	return;
+    }
+
+    if (get_u32(frame + 8) != slot->partial.games || slot->partial.games != coord->shards[shard].games) {
+	lose_worker(coord, id, "incomplete shard");
+	return;
+    }
+
+    slot->partial.cpu_ns = get_u64(frame + 16);
+    merge_stats(&coord->total, &slot->partial);
+
+    slot->shard = -1;
+    coord->shards_done++;
+
+    assign(coord, id);
+}
+
+static void read_worker(struct coordinator *coord, u32 id) {
+    struct slot *slot = &coord->slots[id];
+
+    while (slot->sock != NET_INVALID_SOCKET) {
+	s32 n = net_recv(slot->sock, slot->buf + slot->len, sizeof(slot->buf) - slot->len);
+
+	if (n == NET_WOULD_BLOCK)
+	    return;
+	if (n <= 0) {
+	    lose_worker(coord, id, n == NET_CLOSED ? "connection closed" : net_error());
+	    return;
+	}
+
+	slot->len += n;
+
+	u32 used = 0;
+	while (slot->len - used >= SHARD_FRAME_SIZE && slot->sock != NET_INVALID_SOCKET) {
+	    handle_frame(coord, id, slot->buf + used);
+	    used += SHARD_FRAME_SIZE;
+	}
+
+	if (slot->sock == NET_INVALID_SOCKET)
+	    return;
+
+	memmove(slot->buf, slot->buf + used, slot->len - used);
+	slot->len -= used;
+    }
+}
+
+// gives a connection that sent its hello its slot
+static void greet(struct coordinator *coord, net_socket sock, const u8 *frame) {
+    if (frame[0] != MSG_HELLO || get_u32(frame + 4) != SHARD_MAGIC) {
+	net_close(sock);
+	return;
+    }
+
+    u32 id = get_u32(frame + 8);
+
+    if (id == SHARD_REMOTE_ID) {
+	for (id = coord->n_local; id < MAX_SLOTS && coord->slots[id].used; id++)
+	    ;
+
+	if (id == MAX_SLOTS) {
+	    net_close(sock);
+	    return;
+	}
+
+	coord->slots[id].used = true;
+	coord->slots[id].local = false;
+	printf("remote worker joined as %u\n", id);
+    } else if (id >= coord->n_local || coord->slots[id].sock != NET_INVALID_SOCKET) {
+	net_close(sock);
+	return;
+    }
+
+    struct slot *slot = &coord->slots[id];
+    slot->sock = sock;
+    slot->len = 0;
+    slot->shard = -1;
+
+    assign(coord, id);
+}
+
+static void accept_pending(struct coordinator *coord, net_socket sock) {
+    if (coord->n_pending == MAX_PENDING) {
+	net_close(sock);
+	return;
+    }
+
+    struct pending *pending = &coord->pending[coord->n_pending++];
+    pending->sock = sock;
+    pending->len = 0;
+    pending->deadline = now_ns() + HELLO_TIMEOUT_NS;
+}
+
+// the last pending connection takes the place of the one that goes
+static void drop_pending(struct coordinator *coord, u32 i) {
+    coord->pending[i] = coord->pending[--coord->n_pending];
+}
+
+static void read_pending(struct coordinator *coord, u32 i) {
+    struct pending *pending = &coord->pending[i];
+
+    while (pending->len < SHARD_FRAME_SIZE) {
+	s32 n = net_recv(pending->sock, pending->frame + pending->len, SHARD_FRAME_SIZE - pending->len);
+
+	if (n == NET_WOULD_BLOCK)
+	    return;
+	if (n <= 0) {
+	    net_close(pending->sock);
+	    drop_pending(coord, i);
+	    return;
+	}
+
+	pending->len += n;
+    }
+
+    struct pending hello = *pending;
+    drop_pending(coord, i);
+    greet(coord, hello.sock, hello.frame);
+}
+
+static void expire_pending(struct coordinator *coord) {
+    u64 now = now_ns();
+
+    for (u32 i=coord->n_pending; i>0; i--) {
+	if (now > coord->pending[i - 1].deadline) {
+	    net_close(coord->pending[i - 1].sock);
+	    drop_pending(coord, i - 1);
+	}
+    }
+}
+
+static void reap_workers(struct coordinator *coord) {
+    for (u32 i=0; i<coord->n_local; i++) {
+	struct slot *slot = &coord->slots[i];
+
+	int code;
+	if (!slot->process_running || !os_process_exited(&slot->process, &code))
+	    continue;
+
+	slot->process_running = false;
+
+	char why[32];
+	snprintf(why, sizeof(why), "exited with %d", code);
+	lose_worker(coord, i, why);
+
+	if (coord->shards_done + coord->shards_failed < coord->n_shards)
+	    spawn_worker(coord, i);
+    }
+}
+
+static void check_timeouts(struct coordinator *coord) {
+    u64 now = now_ns();
+
+    for (u32 i=0; i<MAX_SLOTS; i++) {
+	struct slot *slot = &coord->slots[i];
+
+	if (slot->used && slot->shard >= 0 && now - slot->shard_started > coord->shard_timeout_ns)
+	    lose_worker(coord, i, "shard timed out");
+    }
+}
+
+static void print_report(const struct coordinator *coord, f64 seconds) {
+    const struct batch_stats *t = &coord->total;
+
+    printf("%u/%u shards done, %u failed, %u worker crashes\n",
+	    coord->shards_done, coord->n_shards, coord->shards_failed, coord->crashes);
+    printf("%llu games in %.2fs (%.0f games/s, %.0f ticks/s), %.2f cpu s in workers\n",
+	    (unsigned long long) t->games, seconds, t->games / seconds, t->ticks / seconds, t->cpu_ns / 1e9);
+
+    if (!t->games)
+	return;
+
+    printf("score:    mean %.2f, p50 %llu, p90 %llu, p99 %llu, max %u\n",
+	    (f64) t->total_score / t->games,
+	    (unsigned long long) hist_percentile(&t->scores, 0.5),
+	    (unsigned long long) hist_percentile(&t->scores, 0.9),
+	    (unsigned long long) hist_percentile(&t->scores, 0.99), t->max_score);
+    printf("survival: mean %.1f ticks, p50 %llu, p90 %llu, p99 %llu, max %llu\n",
+	    (f64) t->ticks / t->games,
+	    (unsigned long long) hist_percentile(&t->survival, 0.5),
+	    (unsigned long long) hist_percentile(&t->survival, 0.9),
+	    (unsigned long long) hist_percentile(&t->survival, 0.99),
+	    (unsigned long long) t->survival.max);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s [options]\n"
+	    "  --workers N       local worker processes (default: cpu count)\n"
+	    "  --games N         games in total (default 100000)\n"
+	    "  --shard-size N    games per shard (default 1000)\n"
+	    "  --grid WxH        grid size (default 20x20)\n"
+	    "  --seed N          game i is played with seed N + i (default: time)\n"
+	    "  --max-ticks N     a game that lasts longer is cut off (default 100000)\n"
+	    "  --listen ADDR     where workers connect to (default tcp:127.0.0.1:0, any free port)\n"
+	    "  --timeout-s N     a shard taking longer than this is rerun elsewhere (default 60)\n"
+	    "  --chaos P         probability a worker crashes in a shard, to exercise recovery (default 0)\n"
+	    "worker mode, started by the coordinator or by hand on another machine:\n"
+	    "  %s --worker ADDR [--id N] [--max-ticks N] [--chaos P]\n",
+	    prog, prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    u32 n_workers = SDL_GetCPUCount();
+    u32 games = 100000;
+    u32 shard_size = 1000;
+    u32 max_ticks = 100000;
+    u32 timeout_s = 60;
+    u32 bound_x = GRID_WIDTH, bound_y = GRID_HEIGHT;
+    u64 seed = time(NULL);
+    const char *listen_address = "tcp:127.0.0.1:0";
+    const char *worker_address = NULL;
+    u32 worker_id = SHARD_REMOTE_ID;
+    const char *chaos_str = "0";
+
+    for (int i=1; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--workers") == 0)
+	    n_workers = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--games") == 0)
+	    games = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--shard-size") == 0)
+	    shard_size = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--max-ticks") == 0)
+	    max_ticks = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--timeout-s") == 0)
+	    timeout_s = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--seed") == 0)
+	    seed = strtoull(val, NULL, 10);
+	else if (strcmp(arg, "--listen") == 0)
+	    listen_address = val;
+	else if (strcmp(arg, "--worker") == 0)
+	    worker_address = val;
+	else if (strcmp(arg, "--id") == 0)
+	    worker_id = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--chaos") == 0)
+	    chaos_str = val;
+	else if (strcmp(arg, "--grid") == 0) {
+	    if (sscanf(val, "%ux%u", &bound_x, &bound_y) != 2)
+		usage(argv[0]);
+	} else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    if (worker_address)
+	return run_worker(worker_address, worker_id, max_ticks, atof(chaos_str));
+
+    if (n_workers == 0 || n_workers > MAX_SLOTS || games == 0 || shard_size == 0 || bound_x == 0 || bound_y == 0)
+	usage(argv[0]);
+
+    if (!net_init()) {
+	fprintf(stderr, "unable to initialize sockets\n");
+	return EXIT_FAILURE;
+    }
+
+    net_socket listener = net_listen(listen_address);
+    if (listener == NET_INVALID_SOCKET) {
+	fprintf(stderr, "unable to listen on %s: %s\n", listen_address, net_error());
+	return EXIT_FAILURE;
+    }
+
+    struct coordinator *coord = calloc(1, sizeof(*coord));
+    assert(coord);
+
+    coord->n_local = n_workers;
+    coord->bound_x = bound_x;
+    coord->bound_y = bound_y;
+    coord->seed = seed;
+    coord->shard_timeout_ns = (u64) timeout_s * 1000000000;
+
+    coord->n_shards = (games + shard_size - 1) / shard_size;
+    coord->shards = calloc(coord->n_shards, sizeof(*coord->shards));
+    coord->queue = malloc(coord->n_shards * sizeof(*coord->queue));
+    assert(coord->shards && coord->queue);
+
+    // queue is popped from the back, fill it reversed so shards go out in order
+    for (u32 i=0; i<coord->n_shards; i++) {
+	coord->shards[i].first_game = i * shard_size;
+	coord->shards[i].games = games - i * shard_size < shard_size ? games - i * shard_size : shard_size;
+	coord->queue[coord->n_shards - 1 - i] = i;
+    }
+    coord->queued = coord->n_shards;
+
+    char address[64];
+    snprintf(address, sizeof(address), "tcp:127.0.0.1:%u", net_local_port(listener));
+
+    char max_ticks_str[16];
+    snprintf(max_ticks_str, sizeof(max_ticks_str), "%u", max_ticks);
+
+    char *worker_argv[] = { argv[0], "--worker", address, "--id", "ID", "--max-ticks", max_ticks_str, "--chaos", (char *) chaos_str, NULL };
+    memcpy(coord->worker_argv, worker_argv, sizeof(worker_argv));
+
+    for (u32 i=0; i<MAX_SLOTS; i++) {
+	coord->slots[i].sock = NET_INVALID_SOCKET;
+	coord->slots[i].shard = -1;
+    }
+
+    for (u32 i=0; i<n_workers; i++) {
+	coord->slots[i].used = true;
+	coord->slots[i].local = true;
+	spawn_worker(coord, i);
+    }
+
+    printf("coordinating %u games in %u shards over %u workers on port %u\n",
+	    games, coord->n_shards, n_workers, net_local_port(listener));
+
+    u64 start = now_ns();
+
+    while (coord->shards_done + coord->shards_failed < coord->n_shards) {
+	net_socket socks[MAX_SLOTS + MAX_PENDING + 1];
+	u32 ids[MAX_SLOTS + MAX_PENDING + 1];
+	bool ready[MAX_SLOTS + MAX_PENDING + 1];
+	u32 n = 0;
+
+	socks[n++] = listener;
+	for (u32 i=0; i<MAX_SLOTS; i++) {
+	    if (coord->slots[i].sock != NET_INVALID_SOCKET) {
+		socks[n] = coord->slots[i].sock;
+		ids[n] = i;
+		n++;
+	    }
+	}
+
+	// pending connections come last, their ids are indices into coord->pending
+	u32 first_pending = n;
+	for (u32 i=0; i<coord->n_pending; i++) {
+	    socks[n] = coord->pending[i].sock;
+	    ids[n] = i;
+	    n++;
+	}
+
+	// the timeout is only there to notice exited processes and stuck shards
+	if (net_poll_readable(socks, n, ready, 100) < 0) {
+	    fprintf(stderr, "poll: %s\n", net_error());
+	    break;
+	}
+
+	for (u32 i=1; i<first_pending; i++)
+	    if (ready[i])
+		read_worker(coord, ids[i]);
+
+	// backwards, so a dropped connection is only ever replaced by one that was already looked at
+	for (u32 i=n; i>first_pending; i--)
+	    if (ready[i - 1])
+		read_pending(coord, ids[i - 1]);
+
+	if (ready[0]) {
+	    net_socket sock;
+	    while ((sock = net_accept(listener)) != NET_INVALID_SOCKET)
+		accept_pending(coord, sock);
+	}
+
+	expire_pending(coord);
+	reap_workers(coord);
+	check_timeouts(coord);
+
+	for (u32 i=0; i<MAX_SLOTS; i++)
+	    assign(coord, i);
+
+	bool any_alive = false;
+	for (u32 i=0; i<MAX_SLOTS; i++)
+	    if (coord->slots[i].process_running || coord->slots[i].sock != NET_INVALID_SOCKET)
+		any_alive = true;
+
+	if (!any_alive) {
+	    fprintf(stderr, "no workers left\n");
+	    break;
+	}
+    }
+
+    f64 seconds = (now_ns() - start) / 1e9;
+
+    u8 bye[SHARD_FRAME_SIZE] = { MSG_BYE };
+    for (u32 i=0; i<MAX_SLOTS; i++) {
+	struct slot *slot = &coord->slots[i];
+
+	if (slot->sock != NET_INVALID_SOCKET) {
+	    net_send_all(slot->sock, bye, SHARD_FRAME_SIZE, 1000);
+	    net_close(slot->sock);
+	}
+    }
+
+    for (u32 i=0; i<coord->n_pending; i++)
+	net_close(coord->pending[i].sock);
+
+    // give the workers a moment to leave on their own before making sure they do
+    for (u32 waited = 0; waited < 2000; waited += 10) {
+	bool any_running = false;
+
+	for (u32 i=0; i<n_workers; i++) {
+	    struct slot *slot = &coord->slots[i];
+	    if (slot->process_running && !os_process_exited(&slot->process, NULL))
+		any_running = true;
+	    else
+		slot->process_running = false;
+	}
+
+	if (!any_running)
+	    break;
+	SDL_Delay(10);
+    }
+
+    for (u32 i=0; i<n_workers; i++) {
+	struct slot *slot = &coord->slots[i];
+	if (slot->process_running) {
+	    os_process_kill(&slot->process);
+	    while (!os_process_exited(&slot->process, NULL))
+		SDL_Delay(1);
+	}
+    }
+
+    print_report(coord, seconds);
+
+    bool complete = coord->shards_done == coord->n_shards;
+
+    net_close(listener);
+    free(coord->queue);
+    free(coord->shards);
+    free(coord);
+
+    return complete ? EXIT_SUCCESS : EXIT_FAILURE;
+}
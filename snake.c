@@ -0,0 +1,482 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snake.h"
+
+// random spots tried for the starting body before set_rules looks at every one
+#define LAY_BODY_DRAWS 1024
+
+
+// splitmix64, small and good enough to give every game its own stream
+void seed_rng(struct rng *rng, u64 seed) {
+    assert(rng);
+
+    rng->state = seed;
+}
+
+u32 next_u32(struct rng *rng) {
+    assert(rng);
+
+    u64 z = (rng->state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z = z ^ (z >> 31);
+
+    return (u32) (z >> 32);
+}
+
+// returns u32 in the range [0, bound) preventing modulo bias
+u32 uniform_u32(struct rng *rng, u32 bound) {
+    assert(bound);
+
+    u32 v = next_u32(rng);
+
+    // 2^32 % bound computed without needing 64 bits
+    u32 threshold = -bound % bound;
+
+    while (v < threshold) {
+	v = next_u32(rng);
+    };
+    return v % bound;
+}
+
+
+// returns the position after moving pos in direction dir
+// but bounded in x direction by [0, bound_x) and in the y direction by [0, bound_y)
+// assumes dx < bound-x && dy < bound_x
+struct vec2 move_in_bounded_direction(struct vec2 pos, struct vec2 dir, u32 bound_x, u32 bound_y) {
+    struct vec2 new_pos;
+
+    new_pos.x = pos.x + dir.x;
+    if (new_pos.x < 0)
+	new_pos.x = bound_x + new_pos.x;
+    else if (new_pos.x >= bound_x)
+	new_pos.x = new_pos.x - bound_x;
+
+
+    new_pos.y = pos.y + dir.y;
+    if (new_pos.y < 0)
+	new_pos.y = bound_y + new_pos.y;
+    else if (new_pos.y >= bound_y)
+	new_pos.y = new_pos.y - bound_y;
+
+    return new_pos;
+}
+
+const struct vec2 DIRECTION_UP = {
+    .x = 0, .y = -1
+};
+const struct vec2 DIRECTION_DOWN = {
+    .x = 0, .y = 1
+};
+const struct vec2 DIRECTION_LEFT = {
+    .x = -1, .y = 0
+};
+const struct vec2 DIRECTION_RIGHT = {
+    .x = 1, .y = 0
+};
+
+struct vec2 directions[4] = {
+    { .x = 0, .y = -1 }, { .x = 0, .y = 1 }, { .x = -1, .y = 0 }, { .x = 1, .y = 0 }
+};
+
+u32 direction_index(struct vec2 dir) {
+    for (u32 i=0; i<4; i++)
+	if (VEC2S_EQUAL(dir, directions[i]))
+	    return i;
+
+    assert(false);
+    return 0;
+}
+
+// lays the starting body out straight behind head, moving in directions[dir]
+static void lay_body_at(struct snake *snake, struct vec2 head, u32 dir) {
+    snake->direction = directions[dir];
+
+    // directions come in opposite pairs, the tail is drawn in the opposite direction of the initial direction
+    struct vec2 tail_direction = directions[dir ^ 1];
+
+    snake->tail = NULL;
+
+    for (u32 i=0; i<INITIAL_SNAKE_LEN; i++) {
+	struct snake_piece *new_tail = malloc(sizeof(*new_tail));
+	assert(new_tail);
+
+	if (snake->tail) {
+	    new_tail->pos = move_in_bounded_direction(snake->tail->pos, tail_direction, snake->bound_x, snake->bound_y);
+
+	    new_tail->next = snake->tail;
+	    new_tail->prev = NULL;
+	    snake->tail->prev = new_tail;
+	    snake->tail = new_tail;
+	} else {
+	    new_tail->next = NULL;
+	    new_tail->prev = NULL;
+	    new_tail->pos = head;
+
+	    snake->head = snake->tail = new_tail;
+	}
+    }
+
+    snake->length = INITIAL_SNAKE_LEN;
+}
+
+// draws a direction and a spot for the head, in that order
+static void draw_body_spot(struct snake *snake, struct vec2 *head, u32 *dir) {
+    *dir = uniform_u32(&snake->rng, 4);
+    head->x = uniform_u32(&snake->rng, snake->bound_x);
+    head->y = uniform_u32(&snake->rng, snake->bound_y);
+}
+
+// draws a direction and a spot and lays the starting body out from it
+static void lay_body(struct snake *snake) {
+    struct vec2 head;
+    u32 dir;
+    draw_body_spot(snake, &head, &dir);
+    lay_body_at(snake, head, dir);
+}
+
+static void free_body(struct snake *snake) {
+    struct snake_piece *walk = snake->tail;
+    while (walk) {
+	struct snake_piece *next = walk->next;
+	free(walk);
+	walk = next;
+    }
+
+    snake->head = snake->tail = NULL;
+    snake->length = 0;
+}
+
+void init_snake(struct snake *snake, u32 bound_x, u32 bound_y, u64 seed) {
+    assert(snake);
+    assert(bound_x > 0 && bound_y > 0);
+
+    seed_rng(&snake->rng, seed);
+
+    snake->bound_x = bound_x;
+    snake->bound_y = bound_y;
+
+    lay_body(snake);
+
+    snake->occupied = NULL;
+    snake->obstacles = NULL;
+    init_occupancy(snake);
+
+    snake->food_pos.x = uniform_u32(&snake->rng, snake->bound_x);
+    snake->food_pos.y = uniform_u32(&snake->rng, snake->bound_y);
+
+    snake->score = 0;
+
+    snake->died = false;
+
+    set_rules(snake, &(struct rules) { 0 });
+}
+
+void free_snake(struct snake *snake) {
+    assert(snake);
+
+    free_body(snake);
+
+    free(snake->occupied);
+    snake->occupied = NULL;
+}
+
+void init_occupancy(struct snake *snake) {
+    assert(snake);
+
+    free(snake->occupied);
+
+    u64 n_words = ((u64) snake->bound_x * snake->bound_y + 63) / 64;
+
+    snake->occupied = calloc(n_words, sizeof(*snake->occupied));
+    assert(snake->occupied);
+    snake->stacked = 0;
+
+    // the obstacles become part of the bitmap, from then on a wall is just a cell that never empties
+    if (snake->obstacles)
+	memcpy(snake->occupied, snake->obstacles, n_words * sizeof(*snake->occupied));
+
+    for (struct snake_piece *walk = snake->tail; walk; walk = walk->next)
+	occupy_cell(snake, walk->pos);
+}
+
+void occupy_cell(struct snake *snake, struct vec2 pos) {
+    u32 cell = pos.y * snake->bound_x + pos.x;
+    u64 bit = 1ull << (cell % 64);
+
+    if (snake->occupied[cell / 64] & bit)
+	snake->stacked++;
+
+    snake->occupied[cell / 64] |= bit;
+}
+
+void vacate_cell(struct snake *snake, const struct snake_piece *piece) {
+    if (snake->stacked) {
+	for (struct snake_piece *walk = snake->tail; walk; walk = walk->next) {
+	    if (walk != piece && VEC2S_EQUAL(walk->pos, piece->pos)) {
+		snake->stacked--;
+		return;
+	    }
+	}
+    }
+
+    u32 cell = piece->pos.y * snake->bound_x + piece->pos.x;
+    snake->occupied[cell / 64] &= ~(1ull << (cell % 64));
+}
+
+// draws cells until it hits a free one, the same draws the list walking version made, just without the walk
+// obstacles are in the bitmap too, so food never lands on them
+// like before it never returns on a full board
+struct vec2 next_food_pos(struct snake *snake) {
+    assert(snake);
+
+    struct vec2 result;
+
+    do {
+	result.x = uniform_u32(&snake->rng, snake->bound_x);
+	result.y = uniform_u32(&snake->rng, snake->bound_y);
+    } while (cell_occupied(snake, result));
+
+    return result;
+}
+
+bool eats_last_free_cell(const struct snake *snake) {
+    assert(snake);
+
+    struct vec2 pos;
+    if (!next_head_pos(snake, snake->direction, &pos) || !VEC2S_EQUAL(pos, snake->food_pos))
+	return false;
+
+    u64 n_cells = (u64) snake->bound_x * snake->bound_y;
+    u64 food = (u64) pos.y * snake->bound_x + pos.x;
+
+    // eating keeps the tail, so the food needs a free cell other than its own to go to next,
+    // the scan stops at the first one and only gets far on a board that is nearly full
+    for (u64 w=0; w<(n_cells + 63) / 64; w++) {
+	u64 free_cells = ~snake->occupied[w];
+
+	if (w == food / 64)
+	    free_cells &= ~(1ull << (food % 64));
+	if (w == n_cells / 64)
+	    free_cells &= (1ull << (n_cells % 64)) - 1;
+
+	if (free_cells)
+	    return false;
+    }
+
+    return true;
+}
+
+// the one step function every kernel is made from, the rule arguments are constants in every call
+// so each kernel is compiled with only the code its rules need
+static inline __attribute__((always_inline))
+void step(struct snake *snake, const bool walls, const bool growth) {
+    struct vec2 pos;
+
+    if (walls) {
+	pos.x = snake->head->pos.x + snake->direction.x;
+	pos.y = snake->head->pos.y + snake->direction.y;
+
+	if ((u32) pos.x >= snake->bound_x || (u32) pos.y >= snake->bound_y) {
+	    snake->died = true;
+	    return;
+	}
+    } else {
+	pos = move_in_bounded_direction(snake->head->pos, snake->direction, snake->bound_x, snake->bound_y);
+    }
+
+    // body and obstacles in one test, the tail is still there on this tick so running into it kills as well
+    if (cell_occupied(snake, pos)) {
+	snake->died = true;
+	return;
+    }
+
+    bool ate = VEC2S_EQUAL(pos, snake->food_pos);
+
+    // eating always keeps the tail, growing more than one segment keeps it for a few more ticks
+    bool keep_tail = ate;
+    if (growth) {
+	if (ate)
+	    snake->pending_growth += snake->growth;
+	keep_tail = snake->pending_growth > 0;
+	if (keep_tail)
+	    snake->pending_growth--;
+    }
+
+    if (keep_tail) {
+	struct snake_piece *new_piece = malloc(sizeof(*new_piece));
+	assert(new_piece);
+
+	new_piece->pos = pos;
+	new_piece->next = NULL;
+	new_piece->prev = snake->head;
+	snake->head->next = new_piece;
+	snake->head = new_piece;
+	occupy_cell(snake, pos);
+
+	snake->length++;
+    } else {
+	// otherwise the tail piece becomes the new head, no allocation needed
+	struct snake_piece *piece = snake->tail;
+	vacate_cell(snake, piece);
+
+	if (piece != snake->head) {
+	    snake->tail = piece->next;
+	    snake->tail->prev = NULL;
+
+	    piece->prev = snake->head;
+	    snake->head->next = piece;
+	    snake->head = piece;
+	    piece->next = NULL;
+	}
+
+	piece->pos = pos;
+	occupy_cell(snake, pos);
+    }
+
+    // only placed once the new head is down and the tail is still there
+    if (ate) {
+	snake->score++;
+	snake->food_pos = next_food_pos(snake);
+    }
+}
+
+#define STEP_KERNEL(name, walls, growth) \
+    static void name(struct snake *snake) { step(snake, walls, growth); }
+
+STEP_KERNEL(step_classic, false, false)
+STEP_KERNEL(step_walls, true, false)
+STEP_KERNEL(step_growth, false, true)
+STEP_KERNEL(step_walls_growth, true, true)
+
+// indexed by walls | growth << 1, obstacles need no kernel of their own since they live in the bitmap
+static const step_fn step_kernels[4] = {
+    step_classic, step_walls, step_growth, step_walls_growth,
+};
+
+// a cell a piece cannot be on under rules, obstacles only, since the grid's edge is not a cell
+static bool blocked(const struct snake *snake, const struct rules *rules, struct vec2 pos) {
+    return rules->obstacles && cell_bit(rules->obstacles, snake->bound_x, pos);
+}
+
+// pos one step in dir, false if that is off the grid and the grid has walls
+static bool step_pos(const struct snake *snake, bool walls, struct vec2 pos, struct vec2 dir, struct vec2 *next) {
+    if (!walls) {
+	*next = move_in_bounded_direction(pos, dir, snake->bound_x, snake->bound_y);
+	return true;
+    }
+
+    next->x = pos.x + dir.x;
+    next->y = pos.y + dir.y;
+
+    return (u32) next->x < snake->bound_x && (u32) next->y < snake->bound_y;
+}
+
+// whether the body as it is can start a game under rules, it may be any body, not just a starting one
+// with walls it cannot reach over an edge and the head needs a cell to move to
+static bool body_fits(const struct snake *snake, const struct rules *rules) {
+    for (const struct snake_piece *walk = snake->tail; walk; walk = walk->next) {
+	if (blocked(snake, rules, walk->pos))
+	    return false;
+
+	// pieces on a plain grid are at most a cell apart, stacked ones share it
+	if (rules->walls && walk->next &&
+		(abs(walk->next->pos.x - walk->pos.x) > 1 || abs(walk->next->pos.y - walk->pos.y) > 1))
+	    return false;
+    }
+
+    struct vec2 ahead;
+    if (rules->walls)
+	return step_pos(snake, true, snake->head->pos, snake->direction, &ahead) && !blocked(snake, rules, ahead);
+
+    return true;
+}
+
+// whether a body laid by lay_body_at(snake, head, dir) would pass body_fits
+static bool body_fits_at(const struct snake *snake, const struct rules *rules, struct vec2 head, u32 dir) {
+    struct vec2 ahead;
+    if (rules->walls && (!step_pos(snake, true, head, directions[dir], &ahead) || blocked(snake, rules, ahead)))
+	return false;
+
+    struct vec2 pos = head;
+    for (u32 i=0; i<INITIAL_SNAKE_LEN; i++) {
+	if (blocked(snake, rules, pos))
+	    return false;
+	if (i + 1 < INITIAL_SNAKE_LEN && !step_pos(snake, rules->walls, pos, directions[dir ^ 1], &pos))
+	    return false;
+    }
+
+    return true;
+}
+
+// lays the body out again where it fits the rules, false if no straight run of the starting length does
+// spots are drawn the way lay_body draws them first, a map that is mostly walls then gets a scan of every spot
+static bool lay_body_clear(struct snake *snake, const struct rules *rules) {
+    struct vec2 head;
+    u32 dir;
+
+    for (u32 i=0; i<LAY_BODY_DRAWS; i++) {
+	draw_body_spot(snake, &head, &dir);
+	if (body_fits_at(snake, rules, head, dir)) {
+	    free_body(snake);
+	    lay_body_at(snake, head, dir);
+	    return true;
+	}
+    }
+
+    for (head.y=0; (u32) head.y<snake->bound_y; head.y++)
+	for (head.x=0; (u32) head.x<snake->bound_x; head.x++)
+	    for (dir=0; dir<4; dir++)
+		if (body_fits_at(snake, rules, head, dir)) {
+		    free_body(snake);
+		    lay_body_at(snake, head, dir);
+		    return true;
+		}
+
+    return false;
+}
+
+static void pick_step(struct snake *snake, const struct rules *rules) {
+    snake->walls = rules->walls;
+    snake->growth = rules->growth ? rules->growth : 1;
+
+    snake->step = step_kernels[snake->walls | (snake->growth > 1) << 1];
+}
+
+bool set_rules(struct snake *snake, const struct rules *rules) {
+    assert(snake);
+    assert(rules);
+
+    // the starting body is laid out for the classic rules, a body laid over an obstacle would clear it from the
+    // bitmap on its way out and with walls one reaching over an edge would be cut in two, so it starts somewhere else
+    bool moved = !body_fits(snake, rules);
+    if (moved && !lay_body_clear(snake, rules))
+	return false;
+
+    pick_step(snake, rules);
+    snake->pending_growth = 0;
+
+    if (!moved && snake->obstacles == rules->obstacles)
+	return true;
+
+    snake->obstacles = rules->obstacles;
+
+    init_occupancy(snake);
+
+    if (cell_occupied(snake, snake->food_pos))
+	snake->food_pos = next_food_pos(snake);
+
+    return true;
+}
+
+void resume_rules(struct snake *snake, const struct rules *rules) {
+    assert(snake);
+    assert(rules);
+
+    pick_step(snake, rules);
+
+    snake->obstacles = rules->obstacles;
+    init_occupancy(snake);
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+
+#define GRID_WIDTH 20
+#define GRID_HEIGHT 20
+
+#define INITIAL_SNAKE_LEN 10
+
+
+// every game owns its own generator so games can run on any thread and be reproduced from their seed
+struct rng {
+    u64 state;
+};
+
+void seed_rng(struct rng *rng, u64 seed);
+
+u32 next_u32(struct rng *rng);
+
+// returns u32 in the range [0, bound) preventing modulo bias
+u32 uniform_u32(struct rng *rng, u32 bound);
+
+
+struct vec2 {
+    s32 x, y;
+};
+
+// pieces form a doubly linked list, next goes towards the head and prev towards the tail
+struct snake_piece {
+    struct vec2 pos;
+    struct snake_piece *next;
+    struct snake_piece *prev;
+};
+
+#define VEC2S_EQUAL(v1, v2) ((v1.x) == (v2.x) && (v1.y) == (v2.y))
+
+extern const struct vec2 DIRECTION_UP;
+extern const struct vec2 DIRECTION_DOWN;
+extern const struct vec2 DIRECTION_LEFT;
+extern const struct vec2 DIRECTION_RIGHT;
+
+extern struct vec2 directions[4];
+
+// index of dir in directions, used wherever a direction has to fit in two bits
+u32 direction_index(struct vec2 dir);
+
+// returns the position after moving pos in direction dir
+// but bounded in x direction by [0, bound_x) and in the y direction by [0, bound_y)
+// assumes dx < bound-x && dy < bound_x
+struct vec2 move_in_bounded_direction(struct vec2 pos, struct vec2 dir, u32 bound_x, u32 bound_y);
+
+struct snake;
+
+// advances a snake by one tick, every combination of rules has its own, see set_rules
+typedef void (*step_fn)(struct snake *snake);
+
+// rule variants, the classic game wraps around the edges, grows by one per food and has no obstacles
+struct rules {
+    // moving off the grid kills instead of coming back in on the other side
+    bool walls;
+    // segments gained per food, 0 counts as 1
+    u32 growth;
+    // cells nothing can move into, one bit per cell laid out like snake->occupied, NULL for none
+    // copied into the occupancy bitmap, but has to outlive the snake since init_occupancy copies it again
+    const u64 *obstacles;
+};
+
+struct snake {
+    // snake head is where new position is placed, tail is where last position is removed
+    struct snake_piece *head, *tail;
+    u32 length;
+
+    struct vec2 direction;
+
+    u32 bound_x, bound_y;
+
+    struct vec2 food_pos;
+
+    u32 score;
+
+    bool died;
+
+    struct rng rng;
+
+    // one bit per cell, row major, set where a piece or an obstacle is, so collisions and food placement
+    // never walk the body
+    u64 *occupied;
+    // pieces sharing a cell with another piece, only the starting snake on a grid shorter than it can do that
+    // while there are any, a piece leaving a cell has to check whether the cell stays taken
+    u32 stacked;
+
+    // the rules the game was started with and the kernel compiled for them
+    step_fn step;
+    bool walls;
+    u32 growth;
+    const u64 *obstacles;
+    // segments still to grow from food already eaten, only used when growth is more than 1
+    u32 pending_growth;
+};
+
+static inline bool cell_bit(const u64 *bits, u32 bound_x, struct vec2 pos) {
+    u32 cell = pos.y * bound_x + pos.x;
+
+    return bits[cell / 64] >> (cell % 64) & 1;
+}
+
+static inline bool cell_occupied(const struct snake *snake, struct vec2 pos) {
+    return cell_bit(snake->occupied, snake->bound_x, pos);
+}
+
+// where the head ends up moving in dir, false if that is off the grid and the grid has walls
+static inline bool next_head_pos(const struct snake *snake, struct vec2 dir, struct vec2 *pos) {
+    if (!snake->walls) {
+	*pos = move_in_bounded_direction(snake->head->pos, dir, snake->bound_x, snake->bound_y);
+	return true;
+    }
+
+    pos->x = snake->head->pos.x + dir.x;
+    pos->y = snake->head->pos.y + dir.y;
+
+    return (u32) pos->x < snake->bound_x && (u32) pos->y < snake->bound_y;
+}
+
+// starts a classic game, set_rules can change that before the first move
+void init_snake(struct snake *snake, u32 bound_x, u32 bound_y, u64 seed);
+
+// picks the step kernel for rules and merges the obstacles into the occupancy bitmap, once per game before
+// the first move
+// a body or food lying on an obstacle is placed again, which draws from the game's generator, so is a body that
+// reaches over an edge of a grid with walls or has no cell ahead of its head
+// false when no straight run of INITIAL_SNAKE_LEN cells fits, the snake is then left as it was
+bool set_rules(struct snake *snake, const struct rules *rules);
+
+// like set_rules for a game already under way, e.g. restored from a checkpoint, nothing is placed again
+// and the pending growth is left alone
+void resume_rules(struct snake *snake, const struct rules *rules);
+
+// frees the snake's pieces, the snake itself can be initialized again afterwards
+void free_snake(struct snake *snake);
+
+// builds the occupancy bitmap from the pieces, for snakes put together by hand, e.g. decoded from the network
+void init_occupancy(struct snake *snake);
+
+// marks pos taken by a piece that was just put there
+void occupy_cell(struct snake *snake, struct vec2 pos);
+
+// marks the cell of a piece that is about to move or go away free, unless another piece shares it
+void vacate_cell(struct snake *snake, const struct snake_piece *piece);
+
+struct vec2 next_food_pos(struct snake *snake);
+
+// whether the next move eats the food on the last free cell, next_food_pos would never return after it,
+// so a game loop ends the game there instead, with the board cleared
+bool eats_last_free_cell(const struct snake *snake);
+
+static inline void move_snake(struct snake *snake) {
+    snake->step(snake);
+}
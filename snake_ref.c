@@ -0,0 +1,145 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "snake_ref.h"
+
+// the simulation as it was before it was optimized, kept word for word apart from the names
+// and from leaving the occupancy bitmap alone
+// verify plays it against the real one, so nothing in here should ever change
+
+
+void ref_init_snake(struct snake *snake, u32 bound_x, u32 bound_y, u64 seed) {
+    assert(snake);
+
+    snake->occupied = NULL;
+    snake->stacked = 0;
+    assert(bound_x > 0 && bound_y > 0);
+
+    seed_rng(&snake->rng, seed);
+
+    snake->bound_x = bound_x;
+    snake->bound_y = bound_y;
+
+    snake->direction = directions[uniform_u32(&snake->rng, 4)];
+
+
+    // want to draw the snake tail in the opposite direction of the initial direction
+    struct vec2 tail_direction;
+    struct vec2 dir = snake->direction;
+    if (VEC2S_EQUAL(dir, DIRECTION_UP))
+	tail_direction = DIRECTION_DOWN;
+    else if (VEC2S_EQUAL(dir, DIRECTION_DOWN))
+	tail_direction = DIRECTION_UP;
+    else if (VEC2S_EQUAL(dir, DIRECTION_LEFT))
+	tail_direction = DIRECTION_RIGHT;
+    else if (VEC2S_EQUAL(dir, DIRECTION_RIGHT))
+	tail_direction = DIRECTION_LEFT;
+    else
+	assert(false);
+
+
+    snake->tail = NULL;
+
+    for (u32 i=0; i<INITIAL_SNAKE_LEN; i++) {
+	struct snake_piece *new_tail = malloc(sizeof(*new_tail));
+	assert(new_tail);
+
+	if (snake->tail) {
+	    new_tail->pos = move_in_bounded_direction(snake->tail->pos, tail_direction, snake->bound_x, snake->bound_y);
+
+	    new_tail->next = snake->tail;
+	    new_tail->prev = NULL;
+	    snake->tail->prev = new_tail;
+	    snake->tail = new_tail;
+	} else {
+	    new_tail->next = NULL;
+	    new_tail->prev = NULL;
+	    new_tail->pos.x = uniform_u32(&snake->rng, snake->bound_x);
+	    new_tail->pos.y = uniform_u32(&snake->rng, snake->bound_y);
+
+	    snake->head = snake->tail = new_tail;
+	}
+    }
+
+    snake->length = INITIAL_SNAKE_LEN;
+
+    snake->food_pos.x = uniform_u32(&snake->rng, snake->bound_x);
+    snake->food_pos.y = uniform_u32(&snake->rng, snake->bound_y);
+
+    snake->score = 0;
+
+    snake->died = false;
+}
+
+static struct vec2 ref_next_food_pos(struct snake *snake) {
+    assert(snake);
+
+    struct vec2 result;
+
+    // This is a perfectly fine way to generate a piece without colliding with a snake piece
+    // Maybe it could be more reliable in face of a really long snake but there is no such use case now
+    bool pos_taken;
+
+    do {
+	pos_taken = false;
+
+	result.x = uniform_u32(&snake->rng, snake->bound_x);
+	result.y = uniform_u32(&snake->rng, snake->bound_y);
+
+	for (struct snake_piece *walk = snake->tail; walk; walk = walk->next)
+	    if (VEC2S_EQUAL(result, walk->pos)) {
+		pos_taken = true;
+		break;
+	    }
+
+    } while(pos_taken);
+
+    return result;
+}
+
+void ref_move_snake(struct snake *snake) {
+    assert(snake);
+
+    struct snake_piece *new_piece = malloc(sizeof(*new_piece));
+    assert(new_piece);
+
+    new_piece->next = NULL;
+    new_piece->prev = snake->head;
+
+    new_piece->pos = move_in_bounded_direction(snake->head->pos, snake->direction, snake->bound_x, snake->bound_y);
+
+    // if the snake's new head is in the same position as any of its other pieces, then we die
+    for (struct snake_piece *walk = snake->tail; walk; walk = walk->next) {
+	if (VEC2S_EQUAL(new_piece->pos, walk->pos)) {
+	    snake->died = true;
+	    free(new_piece);
+	    return;
+	}
+    }
+
+    snake->head->next = new_piece;
+    snake->head = new_piece;
+
+
+    // if the snake's head is on the food, we eat it, and make a new one
+    bool ate = false;
+    if (VEC2S_EQUAL(snake->head->pos, snake->food_pos)) {
+	ate = true;
+	snake->score++;
+
+	snake->food_pos = ref_next_food_pos(snake);
+    }
+
+
+    // only remove a tail piece if we have not just consumed food
+    // if we ate, this increases the length of the snake by 1
+    if (!ate) {
+	struct snake_piece *old_tail = snake->tail;
+	snake->tail = old_tail->next;
+	snake->tail->prev = NULL;
+
+	free(old_tail);
+    } else {
+	snake->length++;
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "snake.h"
+
+// reference implementation of the simulation: a plain linked list walk for collisions and food placement,
+// no occupancy bitmap, see verify.c
+// it works on struct snake and leaves snake->occupied NULL, free the snake with free_snake as usual
+
+void ref_init_snake(struct snake *snake, u32 bound_x, u32 bound_y, u64 seed);
+
+void ref_move_snake(struct snake *snake);
@@ -0,0 +1,197 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "spectrum.h"
+
+
+#define SPECTRUM_FRESH 4
+
+#define HALF (SPECTRUM_SIZE / 2)
+
+// the bars cover this range on a log scale
+#define LOWEST_HZ 40
+#define HIGHEST_HZ 16000
+
+// bars show this many decibels below full scale
+#define RANGE_DB 60
+// how far a bar falls per update
+#define FALL 0.04f
+
+void spectrum_buffer_init(struct spectrum_buffer *buffer) {
+    assert(buffer);
+
+    memset(buffer, 0, sizeof(*buffer));
+
+    // one block each, the fourth value of ready is never used
+    buffer->back = 0;
+    SDL_AtomicSet(&buffer->ready, 1);
+    buffer->front = 2;
+}
+
+void spectrum_feed(struct spectrum_buffer *buffer, const s16 *samples, u32 frames, u32 channels) {
+    assert(buffer);
+    assert(samples);
+    assert(channels > 0);
+
+    f32 scale = 1.0f / (32768.0f * channels);
+
+    for (u32 i=0; i<frames; i++) {
+	s32 sum = 0;
+	for (u32 c=0; c<channels; c++)
+	    sum += samples[i * channels + c];
+
+	buffer->history[buffer->pos] = sum * scale;
+	buffer->pos = (buffer->pos + 1) % SPECTRUM_SIZE;
+    }
+
+    // oldest sample first, in two straight copies
+    f32 *block = buffer->blocks[buffer->back];
+    memcpy(block, buffer->history + buffer->pos, (SPECTRUM_SIZE - buffer->pos) * sizeof(f32));
+    memcpy(block + SPECTRUM_SIZE - buffer->pos, buffer->history, buffer->pos * sizeof(f32));
+
+    buffer->back = SDL_AtomicSet(&buffer->ready, buffer->back | SPECTRUM_FRESH) & 3;
+}
+
+void spectrum_init(struct spectrum *spectrum, u32 n_bars) {
+    assert(spectrum);
+    assert(n_bars > 0 && n_bars <= SPECTRUM_MAX_BARS);
+
+    memset(spectrum, 0, sizeof(*spectrum));
+    spectrum->n_bars = n_bars;
+
+    // hann, so a tone does not smear over the whole spectrum
+    for (u32 i=0; i<SPECTRUM_SIZE; i++)
+	spectrum->window[i] = 0.5f - 0.5f * cosf(2 * M_PI * i / SPECTRUM_SIZE);
+
+    // twiddles of the full size, the half size fft uses every other one
+    for (u32 i=0; i<HALF; i++) {
+	spectrum->cos_table[i] = cosf(2 * M_PI * i / SPECTRUM_SIZE);
+	spectrum->sin_table[i] = -sinf(2 * M_PI * i / SPECTRUM_SIZE);
+    }
+
+    u32 bits = 0;
+    while ((1u << bits) < HALF)
+	bits++;
+
+    for (u32 i=0; i<HALF; i++) {
+	u32 r = 0;
+	for (u32 b=0; b<bits; b++)
+	    r |= (i >> b & 1) << (bits - 1 - b);
+	spectrum->bit_reverse[i] = r;
+    }
+}
+
+// log spaced bars for a sample rate, every bar gets at least one bin of its own
+static void place_bars(struct spectrum *spectrum, u32 freq) {
+    spectrum->freq = freq;
+
+    f32 lowest = LOWEST_HZ;
+    f32 highest = HIGHEST_HZ < freq / 2 ? HIGHEST_HZ : freq / 2;
+    u32 bin = 1;
+
+    for (u32 b=0; b<=spectrum->n_bars; b++) {
+	f32 hz = lowest * powf(highest / lowest, (f32) b / spectrum->n_bars);
+	u32 edge = hz * SPECTRUM_SIZE / freq;
+
+	if (edge < bin)
+	    edge = bin;
+	if (edge > HALF - 1)
+	    edge = HALF - 1;
+
+	spectrum->bar_bins[b] = edge;
+	bin = edge + 1;
+    }
+}
+
+// in place radix 2 over re and im, HALF points
+static void fft(struct spectrum *spectrum) {
+    f32 *re = spectrum->re, *im = spectrum->im;
+
+    for (u32 i=0; i<HALF; i++) {
+	u32 j = spectrum->bit_reverse[i];
+	if (i < j) {
+	    f32 t = re[i]; re[i] = re[j]; re[j] = t;
+	    t = im[i]; im[i] = im[j]; im[j] = t;
+	}
+    }
+
+    // every butterfly of a pass is independent, the inner loop walks the twiddles with a fixed stride
+    for (u32 size=2; size<=HALF; size*=2) {
+	u32 half = size / 2;
+	u32 stride = SPECTRUM_SIZE / size;
+
+	for (u32 start=0; start<HALF; start+=size) {
+	    for (u32 k=0; k<half; k++) {
+		f32 wr = spectrum->cos_table[k * stride], wi = spectrum->sin_table[k * stride];
+		u32 a = start + k, b = a + half;
+
+		f32 tr = re[b] * wr - im[b] * wi;
+		f32 ti = re[b] * wi + im[b] * wr;
+
+		re[b] = re[a] - tr;
+		im[b] = im[a] - ti;
+		re[a] += tr;
+		im[a] += ti;
+	    }
+	}
+    }
+}
+
+bool spectrum_update(struct spectrum *spectrum, struct spectrum_buffer *buffer) {
+    assert(spectrum);
+    assert(buffer);
+
+    if (!(SDL_AtomicGet(&buffer->ready) & SPECTRUM_FRESH))
+	return false;
+
+    buffer->front = SDL_AtomicSet(&buffer->ready, buffer->front) & 3;
+    const f32 *block = buffer->blocks[buffer->front];
+
+    u32 freq = SDL_AtomicGet(&buffer->freq);
+    if (freq == 0)
+	return false;
+    if (freq != spectrum->freq)
+	place_bars(spectrum, freq);
+
+    // even samples are the real part, odd ones the imaginary part
+    for (u32 i=0; i<HALF; i++) {
+	spectrum->re[i] = block[2 * i] * spectrum->window[2 * i];
+	spectrum->im[i] = block[2 * i + 1] * spectrum->window[2 * i + 1];
+    }
+
+    fft(spectrum);
+
+    // a full scale sine through the hann window peaks at SPECTRUM_SIZE / 4
+    f32 norm = 4.0f / SPECTRUM_SIZE;
+
+    for (u32 b=0; b<spectrum->n_bars; b++) {
+	f32 peak = 0;
+
+	// bin k of the real input out of bins k and HALF - k of the complex one
+	for (u32 k=spectrum->bar_bins[b]; k<spectrum->bar_bins[b + 1] || k == spectrum->bar_bins[b]; k++) {
+	    u32 m = HALF - k;
+	    f32 even_re = (spectrum->re[k] + spectrum->re[m]) / 2, even_im = (spectrum->im[k] - spectrum->im[m]) / 2;
+	    f32 odd_re = (spectrum->im[k] + spectrum->im[m]) / 2, odd_im = (spectrum->re[m] - spectrum->re[k]) / 2;
+	    f32 wr = spectrum->cos_table[k], wi = spectrum->sin_table[k];
+
+	    f32 xr = even_re + odd_re * wr - odd_im * wi;
+	    f32 xi = even_im + odd_re * wi + odd_im * wr;
+
+	    f32 power = xr * xr + xi * xi;
+	    if (power > peak)
+		peak = power;
+	}
+
+	f32 db = 10 * log10f(peak * norm * norm + 1e-12f);
+	f32 height = (db + RANGE_DB) / RANGE_DB;
+	if (height < 0)
+	    height = 0;
+	if (height > 1)
+	    height = 1;
+
+	spectrum->heights[b] = height > spectrum->heights[b] - FALL ? height : spectrum->heights[b] - FALL;
+    }
+
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SDL_atomic.h"
+
+#include "types.h"
+
+// a spectrum of the music for the hud
+//
+// the audio callback only feeds the latest samples into a triple buffer, which is a copy and an atomic swap
+// and never waits on anyone, the frame's spectrum job takes the newest block out of it, runs a real fft and
+// turns it into bar heights
+// a block that is never taken is simply overwritten by the next one
+
+#define SPECTRUM_SIZE 2048
+#define SPECTRUM_MAX_BARS 64
+
+// the audio thread's side and the hand off
+struct spectrum_buffer {
+    // the last SPECTRUM_SIZE samples mixed down to mono, a ring starting at pos
+    f32 history[SPECTRUM_SIZE];
+    u32 pos;
+
+    // the audio thread writes blocks[back] and swaps it with ready, the reader swaps front with ready
+    f32 blocks[3][SPECTRUM_SIZE];
+    u32 back, front;
+    // index of the newest block, with SPECTRUM_FRESH set until the reader takes it
+    SDL_atomic_t ready;
+
+    // sample rate of the device, set when it opens
+    SDL_atomic_t freq;
+};
+
+// the reader's side
+struct spectrum {
+    u32 n_bars;
+    u32 freq;
+
+    // first bin of every bar, and one past the last bin of the last one
+    u32 bar_bins[SPECTRUM_MAX_BARS + 1];
+    // 0 to 1, they fall back slowly instead of jumping
+    f32 heights[SPECTRUM_MAX_BARS];
+
+    f32 window[SPECTRUM_SIZE];
+
+    // the real fft is a complex one of half the size, laid out as separate real and imaginary arrays
+    f32 re[SPECTRUM_SIZE / 2], im[SPECTRUM_SIZE / 2];
+    f32 cos_table[SPECTRUM_SIZE / 2], sin_table[SPECTRUM_SIZE / 2];
+    u16 bit_reverse[SPECTRUM_SIZE / 2];
+};
+
+void spectrum_buffer_init(struct spectrum_buffer *buffer);
+
+// called by the audio thread for every block it plays, interleaved 16 bit samples
+void spectrum_feed(struct spectrum_buffer *buffer, const s16 *samples, u32 frames, u32 channels);
+
+void spectrum_init(struct spectrum *spectrum, u32 n_bars);
+
+// takes the newest block if there is one the reader has not seen, returns false otherwise
+bool spectrum_update(struct spectrum *spectrum, struct spectrum_buffer *buffer);
@@ -0,0 +1,205 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "term.h"
+#include "os.h"
+
+// ansi color numbers, 30 + color sets the foreground and 40 + color the background
+#define TERM_BLACK 0
+#define TERM_RED 1
+#define TERM_GREEN 2
+#define TERM_WHITE 7
+#define TERM_DEFAULT 9
+// not a color, means we do not know what the terminal is set to
+#define TERM_UNKNOWN 0xFF
+
+#define UPPER_HALF_BLOCK "\xe2\x96\x80"
+
+
+static void emit(struct term_renderer *term, const char *s, u32 len) {
+    if (term->out_len + len > term->out_cap) {
+	while (term->out_len + len > term->out_cap)
+	    term->out_cap *= 2;
+
+	term->out = realloc(term->out, term->out_cap);
+	assert(term->out);
+    }
+
+    memcpy(term->out + term->out_len, s, len);
+    term->out_len += len;
+}
+
+static void emit_str(struct term_renderer *term, const char *s) {
+    emit(term, s, strlen(s));
+}
+
+static void emit_move(struct term_renderer *term, u32 row, u32 col) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "\x1b[%u;%uH", row + 1, col + 1);
+    emit(term, buf, len);
+}
+
+// fg can be TERM_UNKNOWN when only the background matters, e.g. for a space
+static void emit_colors(struct term_renderer *term, u8 fg, u8 bg) {
+    bool set_fg = fg != TERM_UNKNOWN && fg != term->fg;
+    bool set_bg = bg != term->bg;
+
+    if (!set_fg && !set_bg)
+	return;
+
+    char buf[32];
+    int len;
+
+    if (set_fg && set_bg)
+	len = snprintf(buf, sizeof(buf), "\x1b[%u;%um", 30 + fg, 40 + bg);
+    else if (set_fg)
+	len = snprintf(buf, sizeof(buf), "\x1b[%um", 30 + fg);
+    else
+	len = snprintf(buf, sizeof(buf), "\x1b[%um", 40 + bg);
+
+    emit(term, buf, len);
+
+    if (set_fg)
+	term->fg = fg;
+    term->bg = bg;
+}
+
+void term_init(struct term_renderer *term, u32 width, u32 height, int fd) {
+    assert(term);
+    assert(width > 0 && height > 0);
+
+    memset(term, 0, sizeof(*term));
+
+    term->width = width;
+    term->height = height;
+    term->fd = fd;
+    term->rows = (height + 1) / 2;
+
+    term->cells = malloc(width * height);
+    assert(term->cells);
+    memset(term->cells, TERM_WHITE, width * height);
+
+    // nothing matches an impossible color pair, so the first frame draws everything
+    term->shadow = malloc(term->rows * width * sizeof(*term->shadow));
+    assert(term->shadow);
+    memset(term->shadow, 0xFF, term->rows * width * sizeof(*term->shadow));
+
+    // a full frame is at most a move, two colors and a glyph per character
+    term->out_cap = 64 + term->rows * width * 24;
+    term->out = malloc(term->out_cap);
+    assert(term->out);
+
+    term->fg = TERM_UNKNOWN;
+    term->bg = TERM_UNKNOWN;
+
+    os_enable_ansi(fd);
+
+    // hide the cursor and clear the screen, sent along with the first frame
+    emit_str(term, "\x1b[0m\x1b[?25l\x1b[2J");
+}
+
+void term_free(struct term_renderer *term) {
+    assert(term);
+
+    term->out_len = 0;
+    emit_str(term, "\x1b[0m");
+    emit_move(term, term->rows + 1, 0);
+    emit_str(term, "\n\x1b[?25h");
+    os_write_all(term->fd, term->out, term->out_len);
+
+    free(term->cells);
+    free(term->shadow);
+    free(term->out);
+    memset(term, 0, sizeof(*term));
+}
+
+void term_draw_snake(struct term_renderer *term, const struct snake *snake) {
+    assert(term);
+    assert(snake);
+    assert(snake->bound_x == term->width && snake->bound_y == term->height);
+
+    memset(term->cells, TERM_WHITE, term->width * term->height);
+
+    for (struct snake_piece *walk = snake->tail; walk; walk = walk->next)
+	term->cells[walk->pos.y * term->width + walk->pos.x] = TERM_BLACK;
+
+    term->cells[snake->head->pos.y * term->width + snake->head->pos.x] = TERM_GREEN;
+    term->cells[snake->food_pos.y * term->width + snake->food_pos.x] = TERM_RED;
+}
+
+void term_status(struct term_renderer *term, const char *text) {
+    assert(term);
+    assert(text);
+
+    if (strncmp(term->status, text, sizeof(term->status) - 1) == 0)
+	return;
+
+    strncpy(term->status, text, sizeof(term->status) - 1);
+    term->status_changed = true;
+}
+
+u32 term_present(struct term_renderer *term) {
+    assert(term);
+
+    u32 width = term->width;
+
+    // where the cursor is after the last glyph, a changed character right after it needs no move
+    u32 cursor_row = ~0u, cursor_col = ~0u;
+
+    for (u32 row=0; row<term->rows; row++) {
+	const u8 *top_cells = term->cells + 2 * row * width;
+	const u8 *bottom_cells = 2 * row + 1 < term->height ? top_cells + width : NULL;
+	u16 *shadow = term->shadow + row * width;
+
+	for (u32 x=0; x<width; x++) {
+	    u8 top = top_cells[x];
+	    u8 bottom = bottom_cells ? bottom_cells[x] : TERM_DEFAULT;
+	    u16 pair = top << 8 | bottom;
+
+	    if (shadow[x] == pair)
+		continue;
+	    shadow[x] = pair;
+
+	    if (row != cursor_row || x != cursor_col)
+		emit_move(term, row, x);
+
+	    // both halves the same color is just a space, which does not care about the foreground
+	    if (top == bottom) {
+		emit_colors(term, TERM_UNKNOWN, bottom);
+		emit(term, " ", 1);
+	    } else {
+		emit_colors(term, top, bottom);
+		emit_str(term, UPPER_HALF_BLOCK);
+	    }
+
+	    cursor_row = row;
+	    cursor_col = x + 1;
+	}
+    }
+
+    if (term->status_changed) {
+	emit_move(term, term->rows, 0);
+	emit_str(term, "\x1b[0m");
+	emit_str(term, term->status);
+	// clear whatever was left of a longer status
+	emit_str(term, "\x1b[K");
+
+	term->fg = TERM_DEFAULT;
+	term->bg = TERM_DEFAULT;
+	term->status_changed = false;
+    }
+
+    u32 len = term->out_len;
+    if (len == 0)
+	return 0;
+
+    os_write_all(term->fd, term->out, len);
+    term->out_len = 0;
+
+    term->frames++;
+    term->bytes += len;
+
+    return len;
+}
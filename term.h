@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "snake.h"
+
+// draws the grid into a terminal for hosts without a display, e.g. watching a game over ssh
+// every character is the upper half block, its foreground color is one cell and its background the cell
+// below, so a character covers two rows of the grid
+// the terminal's contents are kept in a shadow buffer and a frame only sends the characters that changed,
+// all of it in a single write
+
+struct term_renderer {
+    u32 width, height;
+    int fd;
+
+    // one color per grid cell, filled by term_draw_snake
+    u8 *cells;
+    // the top and bottom colors of every character as the terminal currently shows them
+    u16 *shadow;
+    u32 rows;
+
+    // escape sequences for the frame, kept between frames so it only ever grows a few times
+    char *out;
+    u32 out_len, out_cap;
+
+    // colors the terminal is currently set to, so runs of the same color do not repeat the escape
+    u8 fg, bg;
+
+    char status[128];
+    bool status_changed;
+
+    u64 frames;
+    u64 bytes;
+};
+
+// takes over the terminal on fd, hides the cursor and clears it
+void term_init(struct term_renderer *term, u32 width, u32 height, int fd);
+
+// puts the cursor below the grid and back to normal
+void term_free(struct term_renderer *term);
+
+void term_draw_snake(struct term_renderer *term, const struct snake *snake);
+
+// one line of text under the grid, e.g. the score, only sent when it changed
+void term_status(struct term_renderer *term, const char *text);
+
+// sends everything that changed since the last frame, returns the number of bytes written
+u32 term_present(struct term_renderer *term);
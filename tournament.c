@@ -0,0 +1,476 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+#include "SDL_thread.h"
+#include "SDL_atomic.h"
+
+#include "types.h"
+#include "snake.h"
+#include "bots.h"
+#include "pattern.h"
+#include "replay.h"
+#include "recorder.h"
+#include "scores.h"
+#include "os.h"
+
+// plays every bot on the same suite of seeded maps, spread over all cores
+// the suite is fixed by --seed so two runs of the same bots give the same numbers,
+// and any single match can be saved as a replay and played back in the game or checked with --replay
+
+
+#define MAX_GRIDS 16
+#define MAX_THREADS 256
+
+struct grid_size {
+    u32 x, y;
+};
+
+struct match {
+    const struct bot_info *bot;
+    struct grid_size grid;
+    u64 seed;
+
+    u32 score;
+    u32 ticks;
+    bool died;
+    u64 decisions;
+    u64 decide_ns;
+    bool replay_failed;
+};
+
+struct tournament {
+    struct match *matches;
+    u32 n_matches;
+    SDL_atomic_t next_match;
+
+    u32 max_ticks;
+    const char *replay_dir;
+    // writes the replays so the matches never wait on a file
+    struct recorder recorder;
+};
+
+
+static u64 now_ns(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
+
+    return counter / freq * 1000000000 + counter % freq * 1000000000 / freq;
+}
+
+static void replay_path(const struct tournament *t, const struct match *match, char *path, u32 size) {
+    snprintf(path, size, "%s/%s_%ux%u_%llu.snkr", t->replay_dir, match->bot->name,
+	    match->grid.x, match->grid.y, (unsigned long long) match->seed);
+}
+
+static void play_match(struct tournament *t, struct match *match) {
+    struct snake snake;
+    init_snake(&snake, match->grid.x, match->grid.y, match->seed);
+
+    struct recording *recording = NULL;
+    if (t->replay_dir) {
+	char path[1024];
+	replay_path(t, match, path, sizeof(path));
+
+	recording = recorder_begin(&t->recorder, path, match->grid.x, match->grid.y, match->seed, match->bot->name);
+    }
+
+    while (!snake.died && match->ticks < t->max_ticks) {
+	u64 start = now_ns();
+	struct vec2 dir = match->bot->decide(&snake);
+	match->decide_ns += now_ns() - start;
+	match->decisions++;
+
+	// bots are trusted to not turn around, the keyboard rule is not enforced here
+	snake.direction = dir;
+
+	// the match ends with the board cleared, the move is left out of the replay since playing it would not end
+	if (eats_last_free_cell(&snake))
+	    break;
+
+	if (recording)
+	    recording_record(recording, dir);
+
+	move_snake(&snake);
+	match->ticks++;
+    }
+
+    match->score = snake.score;
+    match->died = snake.died;
+
+    // replay_failed is only set once the io thread is done with it, which is before anyone reads it
+    if (recording)
+	recorder_finish(recording, snake.score, &match->replay_failed);
+
+    free_snake(&snake);
+}
+
+static int tournament_thread(void *data) {
+    struct tournament *t = data;
+
+    while (true) {
+	u32 i = SDL_AtomicAdd(&t->next_match, 1);
+	if (i >= t->n_matches)
+	    break;
+
+	play_match(t, &t->matches[i]);
+    }
+
+    return 0;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    u32 x = *(const u32 *) a, y = *(const u32 *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_report(const struct tournament *t, const struct bot_info **bots, u32 n_bots,
+	const struct grid_size *grids, u32 n_grids, f64 seconds) {
+    u64 total_decisions = 0;
+    for (u32 i=0; i<t->n_matches; i++)
+	total_decisions += t->matches[i].decisions;
+
+    printf("%u matches in %.2fs, %.0f decisions/s over all threads\n\n", t->n_matches, seconds, total_decisions / seconds);
+
+    printf("%-12s %8s %10s %8s %6s %12s %8s %14s\n",
+	    "bot", "matches", "avg score", "median", "best", "avg survival", "died", "decisions/s");
+
+    u32 *scores = malloc(t->n_matches * sizeof(*scores));
+    assert(scores);
+
+    for (u32 b=0; b<n_bots; b++) {
+	u32 n = 0, best = 0, died = 0;
+	u64 total_score = 0, total_ticks = 0, decisions = 0, decide_ns = 0;
+
+	for (u32 i=0; i<t->n_matches; i++) {
+	    const struct match *m = &t->matches[i];
+	    if (m->bot != bots[b])
+		continue;
+
+	    scores[n++] = m->score;
+	    total_score += m->score;
+	    total_ticks += m->ticks;
+	    decisions += m->decisions;
+	    decide_ns += m->decide_ns;
+	    died += m->died;
+	    if (m->score > best)
+		best = m->score;
+	}
+
+	if (n == 0)
+	    continue;
+
+	qsort(scores, n, sizeof(*scores), compare_u32);
+
+	printf("%-12s %8u %10.2f %8u %6u %12.1f %7.1f%% %14.0f\n",
+		bots[b]->name, n, (f64) total_score / n, scores[n / 2], best, (f64) total_ticks / n,
+		100.0 * died / n, decide_ns ? decisions * 1e9 / decide_ns : 0.0);
+    }
+
+    free(scores);
+
+    if (n_grids < 2)
+	return;
+
+    printf("\navg score per grid\n%-12s", "bot");
+    for (u32 g=0; g<n_grids; g++) {
+	char name[32];
+	snprintf(name, sizeof(name), "%ux%u", grids[g].x, grids[g].y);
+	printf(" %10s", name);
+    }
+    printf("\n");
+
+    for (u32 b=0; b<n_bots; b++) {
+	printf("%-12s", bots[b]->name);
+
+	for (u32 g=0; g<n_grids; g++) {
+	    u64 total = 0, n = 0;
+
+	    for (u32 i=0; i<t->n_matches; i++) {
+		const struct match *m = &t->matches[i];
+		if (m->bot == bots[b] && m->grid.x == grids[g].x && m->grid.y == grids[g].y) {
+		    total += m->score;
+		    n++;
+		}
+	    }
+
+	    printf(" %10.2f", n ? (f64) total / n : 0.0);
+	}
+	printf("\n");
+    }
+}
+
+static bool write_csv(const struct tournament *t, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file)
+	return false;
+
+    fprintf(file, "bot,grid_x,grid_y,seed,score,ticks,died,decisions,decide_ns\n");
+
+    for (u32 i=0; i<t->n_matches; i++) {
+	const struct match *m = &t->matches[i];
+
+	fprintf(file, "%s,%u,%u,%llu,%u,%u,%d,%llu,%llu\n", m->bot->name, m->grid.x, m->grid.y,
+		(unsigned long long) m->seed, m->score, m->ticks, m->died,
+		(unsigned long long) m->decisions, (unsigned long long) m->decide_ns);
+    }
+
+    return fclose(file) == 0;
+}
+
+// every match in the order they were set up, which is the same for the same options
+static bool write_scores(const struct tournament *t, const char *path) {
+    // too big for the stack
+    static struct score_store store;
+
+    if (!scores_open(&store, path))
+	return false;
+
+    u64 now = time(NULL);
+    bool ok = true;
+
+    for (u32 i=0; i<t->n_matches && ok; i++) {
+	const struct match *m = &t->matches[i];
+
+	struct score_entry entry = {
+	    .score = m->score,
+	    .ticks = m->ticks,
+	    .seed = m->seed,
+	    .time = now,
+	};
+
+	if (t->replay_dir && !m->replay_failed) {
+	    char path[1024];
+	    replay_path(t, m, path, sizeof(path));
+	    score_set_replay(&entry, path);
+	}
+
+	ok = scores_add(&store, &entry);
+    }
+
+    ok = ok && scores_flush(&store);
+    scores_close(&store);
+
+    return ok;
+}
+
+static int check_replay(const char *path) {
+    struct replay replay;
+
+    if (!replay_load(&replay, path)) {
+	fprintf(stderr, "unable to load replay %s\n", path);
+	return EXIT_FAILURE;
+    }
+
+    if (replay.map_hash) {
+	fprintf(stderr, "%s was played on a map, only the game itself plays it back with --map\n", path);
+	replay_free(&replay);
+	return EXIT_FAILURE;
+    }
+
+    struct snake snake;
+    bool ok = replay_verify(&replay, &snake);
+
+    printf("%s: bot %s, %ux%u, seed %llu, %u ticks, recorded score %u, replayed score %u%s\n",
+	    path, replay.bot, replay.bound_x, replay.bound_y, (unsigned long long) replay.seed,
+	    replay.ticks, replay.score, snake.score, ok ? "" : " MISMATCH");
+
+    free_snake(&snake);
+    replay_free(&replay);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s [options]\n"
+	    "  --bots A,B,...    bots to play (default: all of them)\n"
+	    "  --maps N          seeded maps per grid size (default 200)\n"
+	    "  --grid WxH,...    grid sizes in the suite (default 20x20)\n"
+	    "  --seed N          map i is seeded with N + i (default 1)\n"
+	    "  --threads N       worker threads (default: cpu count)\n"
+	    "  --max-ticks N     matches are cut off after this many ticks (default 100000)\n"
+	    "  --replays DIR     save a replay of every match into DIR\n"
+	    "  --csv FILE        write every match result to FILE\n"
+	    "  --scores FILE     add every match to the leaderboard in FILE, see leaderboard\n"
+	    "  --patterns FILE   table from patgen for the pattern bot (default: worked out on the spot)\n"
+	    "  --replay FILE     play back a saved match and check it against its recorded result\n",
+	    prog);
+    fprintf(stderr, "bots:");
+    for (u32 i=0; i<n_builtin_bots; i++)
+	fprintf(stderr, " %s", builtin_bots[i].name);
+    fprintf(stderr, "\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    const struct bot_info *bots[64];
+    u32 n_bots = 0;
+
+    struct grid_size grids[MAX_GRIDS] = {{ GRID_WIDTH, GRID_HEIGHT }};
+    u32 n_grids = 1;
+
+    u32 maps = 200;
+    u64 seed = 1;
+    u32 n_threads = SDL_GetCPUCount();
+    const char *csv = NULL;
+    const char *patterns = NULL;
+    const char *scores = NULL;
+
+    struct tournament t = {0};
+    t.max_ticks = 100000;
+
+    for (int i=1; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--replay") == 0)
+	    return check_replay(val);
+	else if (strcmp(arg, "--maps") == 0)
+	    maps = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--seed") == 0)
+	    seed = strtoull(val, NULL, 10);
+	else if (strcmp(arg, "--threads") == 0)
+	    n_threads = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--max-ticks") == 0)
+	    t.max_ticks = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--replays") == 0)
+	    t.replay_dir = val;
+	else if (strcmp(arg, "--csv") == 0)
+	    csv = val;
+	else if (strcmp(arg, "--scores") == 0)
+	    scores = val;
+	else if (strcmp(arg, "--patterns") == 0)
+	    patterns = val;
+	else if (strcmp(arg, "--bots") == 0) {
+	    char names[1024];
+	    snprintf(names, sizeof(names), "%s", val);
+
+	    for (char *name = strtok(names, ","); name; name = strtok(NULL, ",")) {
+		const struct bot_info *bot = find_bot(name);
+		if (!bot || n_bots == 64) {
+		    fprintf(stderr, "unknown bot %s\n", name);
+		    usage(argv[0]);
+		}
+		bots[n_bots++] = bot;
+	    }
+	} else if (strcmp(arg, "--grid") == 0) {
+	    n_grids = 0;
+	    const char *p = val;
+	    while (*p && n_grids < MAX_GRIDS) {
+		char *end;
+		grids[n_grids].x = strtoul(p, &end, 10);
+		if (*end != 'x')
+		    usage(argv[0]);
+		grids[n_grids].y = strtoul(end+1, &end, 10);
+		if (grids[n_grids].x == 0 || grids[n_grids].y == 0)
+		    usage(argv[0]);
+		n_grids++;
+		p = *end == ',' ? end+1 : end;
+	    }
+	} else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    if (n_bots == 0)
+	for (u32 i=0; i<n_builtin_bots; i++)
+	    bots[n_bots++] = &builtin_bots[i];
+
+    if (n_threads == 0)
+	n_threads = 1;
+    if (n_threads > MAX_THREADS)
+	n_threads = MAX_THREADS;
+    if (maps == 0 || n_grids == 0 || t.max_ticks == 0)
+	usage(argv[0]);
+
+    // mapped for the whole run, the workers' bots read it
+    struct os_mapped_file pattern_file = {0};
+    if (patterns) {
+	const u8 *entries = os_map_file(patterns, &pattern_file) ? pattern_parse(pattern_file.data, pattern_file.size) : NULL;
+	if (!entries) {
+	    fprintf(stderr, "unable to load pattern table %s\n", patterns);
+	    return 1;
+	}
+	pattern_set_table(entries);
+    }
+
+    t.n_matches = n_bots * n_grids * maps;
+    t.matches = calloc(t.n_matches, sizeof(*t.matches));
+    assert(t.matches);
+
+    // matches of one map are next to each other so every bot is on the same footing at any point of the run
+    u32 m = 0;
+    for (u32 g=0; g<n_grids; g++)
+	for (u32 i=0; i<maps; i++)
+	    for (u32 b=0; b<n_bots; b++) {
+		t.matches[m].bot = bots[b];
+		t.matches[m].grid = grids[g];
+		t.matches[m].seed = seed + i;
+		m++;
+	    }
+
+    printf("%u bots x %u grid%s x %u maps on %u threads\n", n_bots, n_grids, n_grids == 1 ? "" : "s", maps, n_threads);
+
+    if (t.replay_dir && !recorder_start(&t.recorder)) {
+	fprintf(stderr, "unable to start the replay recorder: %s\n", SDL_GetError());
+	return EXIT_FAILURE;
+    }
+
+    SDL_Thread *threads[MAX_THREADS];
+    u64 start = now_ns();
+
+    for (u32 i=0; i<n_threads; i++) {
+	threads[i] = SDL_CreateThread(tournament_thread, "tournament", &t);
+	if (!threads[i]) {
+	    fprintf(stderr, "unable to create thread: %s\n", SDL_GetError());
+	    return EXIT_FAILURE;
+	}
+    }
+
+    for (u32 i=0; i<n_threads; i++)
+	SDL_WaitThread(threads[i], NULL);
+
+    u64 end = now_ns();
+    f64 seconds = (end - start) / 1e9;
+
+    // how far the io thread was behind the matches
+    if (t.replay_dir)
+	recorder_stop(&t.recorder);
+    f64 drain_ms = (now_ns() - end) / 1e6;
+
+    print_report(&t, bots, n_bots, grids, n_grids, seconds);
+
+    if (t.replay_dir)
+	printf("\nreplays on disk %.1fms after the last match\n", drain_ms);
+
+    u32 replay_failures = 0;
+    for (u32 i=0; i<t.n_matches; i++)
+	replay_failures += t.matches[i].replay_failed;
+    if (replay_failures)
+	fprintf(stderr, "unable to save %u replays into %s\n", replay_failures, t.replay_dir);
+
+    if (csv && !write_csv(&t, csv))
+	fprintf(stderr, "unable to write %s\n", csv);
+
+    if (scores && !write_scores(&t, scores))
+	fprintf(stderr, "unable to write %s\n", scores);
+
+    free(t.matches);
+
+    if (patterns) {
+	pattern_set_table(NULL);
+	os_unmap_file(&pattern_file);
+    }
+
+    return EXIT_SUCCESS;
+}
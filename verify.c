@@ -0,0 +1,419 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+#include "SDL_atomic.h"
+
+#include "types.h"
+#include "snake.h"
+#include "snake_ref.h"
+#include "bots.h"
+#include "replay.h"
+
+// plays the optimized simulation and the reference one in snake_ref.c side by side on the same seeds and
+// inputs, and compares everything about the two snakes after every tick
+// the first tick where they differ is narrowed down to a short replay of the game, see minimize()
+//
+// games are random grid sizes, half of them steered by the greedy bot with some noise so snakes get long,
+// half by a random walk that also runs into itself a lot
+
+
+#define MAX_THREADS 256
+#define MAX_SAVED 16
+
+struct game_input {
+    u32 bound_x, bound_y;
+    u64 seed;
+
+    // direction index of every tick
+    u8 *dirs;
+    u32 ticks;
+};
+
+struct verify {
+    u64 games;
+    u64 seed;
+    u32 max_ticks;
+    const char *out_dir;
+
+    SDL_atomic_t next_game;
+    SDL_atomic_t done;
+    SDL_atomic_t divergences;
+
+    // ticks played per thread, summed at the end
+    u64 ticks[MAX_THREADS];
+    SDL_atomic_t next_thread;
+
+    SDL_mutex *report_lock;
+    u32 saved;
+};
+
+
+static u64 now_ns(void) {
+    u64 counter = SDL_GetPerformanceCounter();
+    u64 freq = SDL_GetPerformanceFrequency();
+
+    return counter / freq * 1000000000 + counter % freq * 1000000000 / freq;
+}
+
+static u32 popcount64(u64 v) {
+    u32 n = 0;
+    for (; v; v &= v - 1)
+	n++;
+    return n;
+}
+
+// false and a description of the first difference if the snakes are not the same
+static bool compare(const struct snake *a, const struct snake *ref, char *what, u32 what_size) {
+    if (a->died != ref->died) {
+	snprintf(what, what_size, "died %d, reference %d", a->died, ref->died);
+	return false;
+    }
+    if (a->score != ref->score || a->length != ref->length) {
+	snprintf(what, what_size, "score %u length %u, reference %u %u", a->score, a->length, ref->score, ref->length);
+	return false;
+    }
+    if (!VEC2S_EQUAL(a->direction, ref->direction)) {
+	snprintf(what, what_size, "direction %u, reference %u", direction_index(a->direction),
+		direction_index(ref->direction));
+	return false;
+    }
+    if (!VEC2S_EQUAL(a->food_pos, ref->food_pos)) {
+	snprintf(what, what_size, "food %d,%d, reference %d,%d", a->food_pos.x, a->food_pos.y,
+		ref->food_pos.x, ref->food_pos.y);
+	return false;
+    }
+    if (a->rng.state != ref->rng.state) {
+	snprintf(what, what_size, "rng state differs");
+	return false;
+    }
+
+    const struct snake_piece *pa = a->tail, *pr = ref->tail;
+    u32 i = 0;
+
+    for (; pa && pr; pa = pa->next, pr = pr->next, i++) {
+	if (!VEC2S_EQUAL(pa->pos, pr->pos)) {
+	    snprintf(what, what_size, "piece %u at %d,%d, reference %d,%d", i, pa->pos.x, pa->pos.y, pr->pos.x, pr->pos.y);
+	    return false;
+	}
+	if ((pa->next && pa->next->prev != pa) || (pa == a->head) != (pr == ref->head)) {
+	    snprintf(what, what_size, "piece %u is linked wrong", i);
+	    return false;
+	}
+	if (!cell_occupied(a, pa->pos)) {
+	    snprintf(what, what_size, "piece %u at %d,%d is missing from the bitmap", i, pa->pos.x, pa->pos.y);
+	    return false;
+	}
+    }
+
+    if (pa || pr) {
+	snprintf(what, what_size, "body ends after %u pieces, reference does not", i);
+	return false;
+    }
+
+    // and nothing else is in the bitmap
+    u32 bits = 0;
+    u32 words = ((u64) a->bound_x * a->bound_y + 63) / 64;
+    for (u32 w=0; w<words; w++)
+	bits += popcount64(a->occupied[w]);
+
+    if (bits != a->length - a->stacked) {
+	snprintf(what, what_size, "%u cells marked for %u pieces", bits, a->length - a->stacked);
+	return false;
+    }
+
+    return true;
+}
+
+// plays ticks of input on both, returns the tick after which they first differ or -1 if they never do
+// a game stops early once a snake dies or is about to fill the board, which neither version survives
+static s64 run_pair(const struct game_input *input, u32 ticks, char *what, u32 what_size, u32 *played) {
+    struct snake a, ref;
+    init_snake(&a, input->bound_x, input->bound_y, input->seed);
+    ref_init_snake(&ref, input->bound_x, input->bound_y, input->seed);
+
+    s64 diverged = -1;
+    u32 tick = 0;
+
+    if (!compare(&a, &ref, what, what_size)) {
+	diverged = 0;
+	goto done;
+    }
+
+    for (tick = 0; tick < ticks && !ref.died; tick++) {
+	struct vec2 dir = directions[input->dirs[tick]];
+
+	struct vec2 next = move_in_bounded_direction(ref.head->pos, dir, ref.bound_x, ref.bound_y);
+	if (VEC2S_EQUAL(next, ref.food_pos) && ref.length + 1 >= ref.bound_x * ref.bound_y)
+	    break;
+
+	a.direction = dir;
+	ref.direction = dir;
+	move_snake(&a);
+	ref_move_snake(&ref);
+
+	if (!compare(&a, &ref, what, what_size)) {
+	    diverged = tick;
+	    break;
+	}
+    }
+
+done:
+    if (played)
+	*played = tick;
+
+    free_snake(&a);
+    free_snake(&ref);
+
+    return diverged;
+}
+
+// the inputs of game index, either recorded from a noisy greedy bot or a random walk
+static void make_game(struct verify *v, u64 index, struct game_input *input) {
+    struct rng rng;
+    seed_rng(&rng, v->seed * 0x9E3779B97F4A7C15ull + index);
+
+    // mostly small grids, which fill up and wrap a lot, sometimes big ones
+    u32 max_bound = uniform_u32(&rng, 8) == 0 ? 256 : 40;
+    input->bound_x = 2 + uniform_u32(&rng, max_bound - 1);
+    input->bound_y = 2 + uniform_u32(&rng, max_bound - 1);
+    input->seed = ((u64) next_u32(&rng) << 32) | next_u32(&rng);
+    input->ticks = v->max_ticks;
+
+    bool greedy = uniform_u32(&rng, 2);
+
+    struct snake snake;
+    init_snake(&snake, input->bound_x, input->bound_y, input->seed);
+
+    u32 dir = direction_index(snake.direction);
+
+    for (u32 tick=0; tick<input->ticks; tick++) {
+	if (greedy && !snake.died) {
+	    dir = direction_index(bot_greedy(&snake));
+	    if (uniform_u32(&rng, 20) == 0)
+		dir = uniform_u32(&rng, 4);
+
+	    snake.direction = directions[dir];
+
+	    struct vec2 next = move_in_bounded_direction(snake.head->pos, snake.direction, snake.bound_x, snake.bound_y);
+	    if (!(VEC2S_EQUAL(next, snake.food_pos) && snake.length + 1 >= snake.bound_x * snake.bound_y))
+		move_snake(&snake);
+	} else if (uniform_u32(&rng, 4) == 0) {
+	    dir = uniform_u32(&rng, 4);
+	}
+
+	input->dirs[tick] = dir;
+    }
+
+    free_snake(&snake);
+}
+
+// shrinks a diverging input: cut it off at the divergence, then replace ever smaller runs of ticks with
+// going straight on for as long as the two versions still disagree somewhere
+static u32 minimize(struct game_input *input, u32 ticks) {
+    char what[256];
+    u8 *trial = malloc(ticks);
+    assert(trial);
+
+    for (u32 chunk = ticks / 2; chunk >= 1; chunk /= 2) {
+	for (u32 start = 0; start < ticks; start += chunk) {
+	    memcpy(trial, input->dirs, ticks);
+
+	    u32 end = start + chunk < ticks ? start + chunk : ticks;
+	    bool changed = false;
+	    for (u32 i=start; i<end; i++) {
+		u8 straight = i > 0 ? trial[i-1] : trial[i];
+		changed |= trial[i] != straight;
+		trial[i] = straight;
+	    }
+
+	    if (!changed)
+		continue;
+
+	    u8 *dirs = input->dirs;
+	    input->dirs = trial;
+	    s64 diverged = run_pair(input, ticks, what, sizeof(what), NULL);
+	    input->dirs = dirs;
+
+	    if (diverged >= 0) {
+		ticks = diverged + 1;
+		memcpy(input->dirs, trial, ticks);
+	    }
+	}
+    }
+
+    free(trial);
+
+    return ticks;
+}
+
+static void report_divergence(struct verify *v, u64 index, struct game_input *input, s64 diverged) {
+    char what[256];
+    u32 ticks = diverged + 1;
+
+    run_pair(input, ticks, what, sizeof(what), NULL);
+    ticks = minimize(input, ticks);
+
+    char reduced[256];
+    run_pair(input, ticks, reduced, sizeof(reduced), NULL);
+
+    SDL_LockMutex(v->report_lock);
+
+    printf("game %llu on %ux%u seed %llu diverged at tick %lld: %s\n", (unsigned long long) index,
+	    input->bound_x, input->bound_y, (unsigned long long) input->seed, (long long) diverged, what);
+    printf("    reduced to %u ticks: %s\n", ticks, reduced);
+
+    if (v->out_dir && v->saved < MAX_SAVED) {
+	struct replay replay;
+	replay_init(&replay, input->bound_x, input->bound_y, input->seed, "verify");
+	for (u32 i=0; i<ticks; i++)
+	    replay_record(&replay, directions[input->dirs[i]]);
+
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/diverge_%ux%u_%llu.snkr", v->out_dir, input->bound_x, input->bound_y,
+		(unsigned long long) input->seed);
+
+	if (replay_save(&replay, path))
+	    printf("    saved %s\n", path);
+	else
+	    fprintf(stderr, "unable to save %s\n", path);
+
+	replay_free(&replay);
+	v->saved++;
+    }
+
+    SDL_UnlockMutex(v->report_lock);
+}
+
+static int verify_thread(void *data) {
+    struct verify *v = data;
+    u32 thread = SDL_AtomicAdd(&v->next_thread, 1);
+
+    struct game_input input;
+    input.dirs = malloc(v->max_ticks);
+    assert(input.dirs);
+
+    char what[256];
+
+    while (true) {
+	u64 index = (u32) SDL_AtomicAdd(&v->next_game, 1);
+	if (index >= v->games)
+	    break;
+
+	make_game(v, index, &input);
+
+	u32 played;
+	s64 diverged = run_pair(&input, input.ticks, what, sizeof(what), &played);
+	v->ticks[thread] += played;
+
+	if (diverged >= 0) {
+	    SDL_AtomicAdd(&v->divergences, 1);
+	    report_divergence(v, index, &input, diverged);
+	}
+
+	SDL_AtomicAdd(&v->done, 1);
+    }
+
+    free(input.dirs);
+
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s [options]\n"
+	    "  --games N         games to play (default 100000)\n"
+	    "  --seed N          seed of the whole run (default 1)\n"
+	    "  --threads N       worker threads (default: cpu count)\n"
+	    "  --max-ticks N     ticks per game at most (default 5000)\n"
+	    "  --out DIR         save a reduced replay of every divergence into DIR\n",
+	    prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    struct verify v = {0};
+    v.games = 100000;
+    v.seed = 1;
+    v.max_ticks = 5000;
+    u32 n_threads = SDL_GetCPUCount();
+
+    for (int i=1; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--games") == 0)
+	    v.games = strtoull(val, NULL, 10);
+	else if (strcmp(arg, "--seed") == 0)
+	    v.seed = strtoull(val, NULL, 10);
+	else if (strcmp(arg, "--threads") == 0)
+	    n_threads = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--max-ticks") == 0)
+	    v.max_ticks = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--out") == 0)
+	    v.out_dir = val;
+	else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    if (n_threads == 0)
+	n_threads = 1;
+    if (n_threads > MAX_THREADS)
+	n_threads = MAX_THREADS;
+    // the game counter is an SDL_atomic_t
+    if (v.max_ticks == 0 || v.games > 0x7FFFFFFF)
+	usage(argv[0]);
+
+    v.report_lock = SDL_CreateMutex();
+    if (!v.report_lock) {
+	fprintf(stderr, "unable to create mutex: %s\n", SDL_GetError());
+	return EXIT_FAILURE;
+    }
+
+    SDL_Thread *threads[MAX_THREADS];
+    u64 start = now_ns();
+
+    for (u32 i=0; i<n_threads; i++) {
+	threads[i] = SDL_CreateThread(verify_thread, "verify", &v);
+	if (!threads[i]) {
+	    fprintf(stderr, "unable to create thread: %s\n", SDL_GetError());
+	    return EXIT_FAILURE;
+	}
+    }
+
+    // progress while the threads work
+    while ((u64) SDL_AtomicGet(&v.done) < v.games) {
+	SDL_Delay(1000);
+	printf("%d/%llu games, %d divergences\n", SDL_AtomicGet(&v.done), (unsigned long long) v.games,
+		SDL_AtomicGet(&v.divergences));
+	fflush(stdout);
+    }
+
+    for (u32 i=0; i<n_threads; i++)
+	SDL_WaitThread(threads[i], NULL);
+
+    u64 ticks = 0;
+    for (u32 i=0; i<n_threads; i++)
+	ticks += v.ticks[i];
+
+    f64 seconds = (now_ns() - start) / 1e9;
+    u32 divergences = SDL_AtomicGet(&v.divergences);
+
+    printf("%llu games, %llu ticks in %.1fs, %u divergences\n", (unsigned long long) v.games,
+	    (unsigned long long) ticks, seconds, divergences);
+
+    SDL_DestroyMutex(v.report_lock);
+
+    return divergences ? EXIT_FAILURE : EXIT_SUCCESS;
+}
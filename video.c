@@ -0,0 +1,287 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "video.h"
+#include "wire.h"
+
+// y4m levels for the two palette colors, chroma is always neutral
+static const u8 luma[2] = { 235, 16 };
+
+// gif wants at least two bits per code, so the two colors come with two unused ones
+#define LZW_MIN_CODE_SIZE 2
+#define LZW_CLEAR (1 << LZW_MIN_CODE_SIZE)
+#define LZW_END (LZW_CLEAR + 1)
+#define LZW_MAX_CODES 4096
+
+struct lzw {
+    // child[code][color] is the code for code's string plus color, 0 if there is none yet
+    u16 child[LZW_MAX_CODES][1 << LZW_MIN_CODE_SIZE];
+    u32 next_code;
+    u32 code_size;
+
+    u32 bits;
+    u32 n_bits;
+
+    // data goes out in sub-blocks of at most 255 bytes, block[0] is the length
+    u8 block[256];
+};
+
+
+static void lzw_flush_block(struct lzw *lzw, FILE *file) {
+    if (lzw->block[0] == 0)
+	return;
+
+    fwrite(lzw->block, 1, lzw->block[0] + 1, file);
+    lzw->block[0] = 0;
+}
+
+static void lzw_put_byte(struct lzw *lzw, FILE *file, u8 byte) {
+    lzw->block[++lzw->block[0]] = byte;
+
+    if (lzw->block[0] == 255)
+	lzw_flush_block(lzw, file);
+}
+
+static void lzw_put_code(struct lzw *lzw, FILE *file, u32 code) {
+    lzw->bits |= code << lzw->n_bits;
+    lzw->n_bits += lzw->code_size;
+
+    while (lzw->n_bits >= 8) {
+	lzw_put_byte(lzw, file, lzw->bits & 0xFF);
+	lzw->bits >>= 8;
+	lzw->n_bits -= 8;
+    }
+}
+
+static void lzw_reset(struct lzw *lzw) {
+    memset(lzw->child, 0, sizeof(lzw->child));
+    lzw->next_code = LZW_END + 1;
+    lzw->code_size = LZW_MIN_CODE_SIZE + 1;
+}
+
+// encodes the rectangle x, y, w, h of a frame as one gif image data section
+static void lzw_encode(struct lzw *lzw, FILE *file, const u8 *pixels, u32 stride, u32 x, u32 y, u32 w, u32 h) {
+    lzw->bits = 0;
+    lzw->n_bits = 0;
+    lzw->block[0] = 0;
+
+    fputc(LZW_MIN_CODE_SIZE, file);
+
+    lzw_reset(lzw);
+    lzw_put_code(lzw, file, LZW_CLEAR);
+
+    u32 prefix = pixels[y * stride + x];
+    bool first = true;
+
+    for (u32 row=y; row<y+h; row++) {
+	const u8 *line = pixels + row * stride;
+
+	for (u32 col=x; col<x+w; col++) {
+	    if (first) {
+		first = false;
+		continue;
+	    }
+
+	    u8 color = line[col];
+	    u16 code = lzw->child[prefix][color];
+
+	    if (code) {
+		prefix = code;
+		continue;
+	    }
+
+	    lzw_put_code(lzw, file, prefix);
+
+	    // decoders switch to a wider code as soon as the table reaches a power of two,
+	    // so we have to as well
+	    if (lzw->next_code < LZW_MAX_CODES) {
+		if (lzw->next_code == 1u << lzw->code_size)
+		    lzw->code_size++;
+		lzw->child[prefix][color] = lzw->next_code++;
+	    } else {
+		lzw_put_code(lzw, file, LZW_CLEAR);
+		lzw_reset(lzw);
+	    }
+
+	    prefix = color;
+	}
+    }
+
+    lzw_put_code(lzw, file, prefix);
+    lzw_put_code(lzw, file, LZW_END);
+
+    if (lzw->n_bits > 0)
+	lzw_put_byte(lzw, file, lzw->bits);
+
+    lzw_flush_block(lzw, file);
+    fputc(0, file);
+}
+
+static bool ends_with(const char *s, const char *suffix) {
+    size_t len = strlen(s), suffix_len = strlen(suffix);
+
+    return len >= suffix_len && strcmp(s + len - suffix_len, suffix) == 0;
+}
+
+bool video_open(struct video_writer *video, const char *path, u32 width, u32 height, u32 fps) {
+    assert(video);
+    assert(path);
+    assert(width > 0 && height > 0 && fps > 0);
+
+    memset(video, 0, sizeof(*video));
+
+    if (ends_with(path, ".y4m"))
+	video->format = VIDEO_Y4M;
+    else if (ends_with(path, ".gif"))
+	video->format = VIDEO_GIF;
+    else
+	return false;
+
+    // gif sizes are 16 bit
+    if (video->format == VIDEO_GIF && (width > 0xFFFF || height > 0xFFFF))
+	return false;
+
+    video->file = fopen(path, "wb");
+    if (!video->file)
+	return false;
+
+    video->width = width;
+    video->height = height;
+    video->fps = fps;
+
+    video->plane = malloc(width * height);
+    assert(video->plane);
+
+    if (video->format == VIDEO_Y4M) {
+	// 4:2:0 chroma planes are half size in both directions, rounded up
+	video->chroma_size = 2 * ((width + 1) / 2) * ((height + 1) / 2);
+	video->chroma = malloc(video->chroma_size);
+	assert(video->chroma);
+	memset(video->chroma, 128, video->chroma_size);
+
+	fprintf(video->file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, fps);
+    } else {
+	video->lzw = malloc(sizeof(*video->lzw));
+	assert(video->lzw);
+
+	u8 header[13 + 6];
+	memcpy(header, "GIF89a", 6);
+	put_u16(header + 6, width);
+	put_u16(header + 8, height);
+	// global color table of two entries
+	header[10] = 0x80;
+	header[11] = VIDEO_WHITE;
+	header[12] = 0;
+	memcpy(header + 13, "\xFF\xFF\xFF\x00\x00\x00", 6);
+	fwrite(header, 1, sizeof(header), video->file);
+
+	// loop forever
+	fwrite("\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00", 1, 19, video->file);
+    }
+
+    return true;
+}
+
+static void write_gif_frame(struct video_writer *video, const u8 *pixels) {
+    u32 width = video->width, height = video->height;
+    const u8 *prev = video->plane;
+
+    // only the bounding box of what changed is encoded, the rest of the previous frame stays on screen
+    u32 min_x = width, min_y = height, max_x = 0, max_y = 0;
+
+    if (video->frames == 0) {
+	min_x = min_y = 0;
+	max_x = width - 1;
+	max_y = height - 1;
+    } else {
+	for (u32 y=0; y<height; y++) {
+	    const u8 *line = pixels + y * width, *prev_line = prev + y * width;
+
+	    if (memcmp(line, prev_line, width) == 0)
+		continue;
+
+	    if (y < min_y)
+		min_y = y;
+	    max_y = y;
+
+	    for (u32 x=0; x<width; x++) {
+		if (line[x] != prev_line[x]) {
+		    if (x < min_x)
+			min_x = x;
+		    if (x > max_x)
+			max_x = x;
+		}
+	    }
+	}
+
+	// nothing changed, a single unchanged pixel still holds the frame's delay
+	if (min_y > max_y) {
+	    min_x = max_x = 0;
+	    min_y = max_y = 0;
+	}
+    }
+
+    // centiseconds, spread so the total stays right when 100 is not a multiple of fps
+    u32 delay = (video->frames + 1) * 100 / video->fps - video->frames * 100 / video->fps;
+
+    // graphic control extension, disposal 1 keeps the frame for the next one to draw over
+    u8 control[8] = { 0x21, 0xF9, 4, 1 << 2, 0, 0, 0, 0 };
+    put_u16(control + 4, delay);
+    fwrite(control, 1, sizeof(control), video->file);
+
+    u8 descriptor[10];
+    descriptor[0] = 0x2C;
+    put_u16(descriptor + 1, min_x);
+    put_u16(descriptor + 3, min_y);
+    put_u16(descriptor + 5, max_x - min_x + 1);
+    put_u16(descriptor + 7, max_y - min_y + 1);
+    descriptor[9] = 0;
+    fwrite(descriptor, 1, sizeof(descriptor), video->file);
+
+    lzw_encode(video->lzw, video->file, pixels, width, min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+
+    memcpy(video->plane, pixels, width * height);
+}
+
+bool video_write_frame(struct video_writer *video, const u8 *pixels) {
+    assert(video && video->file);
+    assert(pixels);
+
+    if (video->format == VIDEO_Y4M) {
+	u32 size = video->width * video->height;
+	for (u32 i=0; i<size; i++)
+	    video->plane[i] = luma[pixels[i]];
+
+	fwrite("FRAME\n", 1, 6, video->file);
+	fwrite(video->plane, 1, size, video->file);
+	fwrite(video->chroma, 1, video->chroma_size, video->file);
+    } else {
+	write_gif_frame(video, pixels);
+    }
+
+    video->frames++;
+
+    return !ferror(video->file);
+}
+
+bool video_close(struct video_writer *video) {
+    assert(video);
+
+    if (!video->file)
+	return false;
+
+    if (video->format == VIDEO_GIF)
+	fputc(0x3B, video->file);
+
+    bool ok = !ferror(video->file);
+    ok = fclose(video->file) == 0 && ok;
+
+    free(video->plane);
+    free(video->chroma);
+    free(video->lzw);
+    memset(video, 0, sizeof(*video));
+
+    return ok;
+}
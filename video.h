@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "types.h"
+
+// writes frames of palette indices as a y4m video or an animated gif
+// the game only has two colors, VIDEO_WHITE and VIDEO_BLACK, which keeps the gif's lzw tables tiny
+//
+// y4m is uncompressed 4:2:0, meant to be piped into a real encoder, e.g. ffmpeg -i clip.y4m clip.mp4
+// gif frames only cover the rectangle that changed since the previous frame
+
+#define VIDEO_WHITE 0
+#define VIDEO_BLACK 1
+
+enum video_format {
+    VIDEO_Y4M,
+    VIDEO_GIF,
+};
+
+struct lzw;
+
+struct video_writer {
+    FILE *file;
+    enum video_format format;
+    u32 width, height;
+    u32 fps;
+
+    // y4m: luma plane and the constant chroma planes, gif: the previous frame
+    u8 *plane;
+    u8 *chroma;
+    u32 chroma_size;
+
+    struct lzw *lzw;
+
+    u64 frames;
+};
+
+// the format comes from the extension of path, .y4m or .gif
+bool video_open(struct video_writer *video, const char *path, u32 width, u32 height, u32 fps);
+
+// pixels is width * height palette indices
+bool video_write_frame(struct video_writer *video, const u8 *pixels);
+
+// finishes the file, returns false if anything failed to write
+bool video_close(struct video_writer *video);
@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SDL.h"
+#include "SDL_timer.h"
+
+#include "types.h"
+#include "snake.h"
+#include "bots.h"
+#include "replay.h"
+#include "term.h"
+
+// plays a bot game or a replay in the terminal, for machines without a display
+// e.g. `ssh box ./watch --replay best.snkr`
+
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+	    "usage: %s [options]\n"
+	    "  --bot NAME        bot to watch (default greedy)\n"
+	    "  --grid WxH        grid size, two rows per terminal line (default 20x20)\n"
+	    "  --seed N          map seed (default: time)\n"
+	    "  --tick-ms N       time between ticks (default 50)\n"
+	    "  --replay FILE     watch a saved game instead of a bot\n",
+	    prog);
+    fprintf(stderr, "bots:");
+    for (u32 i=0; i<n_builtin_bots; i++)
+	fprintf(stderr, " %s", builtin_bots[i].name);
+    fprintf(stderr, "\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    const struct bot_info *bot = find_bot("greedy");
+    u32 bound_x = GRID_WIDTH, bound_y = GRID_HEIGHT;
+    u64 seed = time(NULL);
+    u32 tick_ms = 50;
+    const char *replay_path = NULL;
+
+    for (int i=1; i<argc; i++) {
+	const char *arg = argv[i];
+	const char *val = i+1 < argc ? argv[i+1] : NULL;
+
+	if (!val)
+	    usage(argv[0]);
+
+	if (strcmp(arg, "--seed") == 0)
+	    seed = strtoull(val, NULL, 10);
+	else if (strcmp(arg, "--tick-ms") == 0)
+	    tick_ms = strtoul(val, NULL, 10);
+	else if (strcmp(arg, "--replay") == 0)
+	    replay_path = val;
+	else if (strcmp(arg, "--bot") == 0) {
+	    bot = find_bot(val);
+	    if (!bot) {
+		fprintf(stderr, "unknown bot %s\n", val);
+		usage(argv[0]);
+	    }
+	} else if (strcmp(arg, "--grid") == 0) {
+	    char *end;
+	    bound_x = strtoul(val, &end, 10);
+	    if (*end != 'x')
+		usage(argv[0]);
+	    bound_y = strtoul(end+1, NULL, 10);
+	    if (bound_x == 0 || bound_y == 0)
+		usage(argv[0]);
+	} else
+	    usage(argv[0]);
+
+	i++;
+    }
+
+    struct snake snake;
+    struct replay replay;
+
+    if (replay_path) {
+	if (!replay_load(&replay, replay_path)) {
+	    fprintf(stderr, "unable to load replay %s\n", replay_path);
+	    return EXIT_FAILURE;
+	}
+	if (replay.map_hash) {
+	    fprintf(stderr, "%s was played on a map, only the game itself plays it back with --map\n", replay_path);
+	    return EXIT_FAILURE;
+	}
+	replay_start(&replay, &snake);
+    } else {
+	init_snake(&snake, bound_x, bound_y, seed);
+    }
+
+    struct term_renderer term;
+    term_init(&term, snake.bound_x, snake.bound_y, 1);
+
+    const char *name = replay_path ? replay.bot : bot->name;
+    u32 tick = 0;
+    u32 max_frame = 0;
+
+    while (!snake.died) {
+	char status[128];
+	snprintf(status, sizeof(status), "%s  score %u  tick %u", name, snake.score, tick);
+	term_status(&term, status);
+
+	term_draw_snake(&term, &snake);
+	u32 bytes = term_present(&term);
+	if (bytes > max_frame)
+	    max_frame = bytes;
+
+	if (replay_path) {
+	    if (tick == replay.ticks)
+		break;
+	    snake.direction = replay_direction(&replay, tick);
+	} else {
+	    snake.direction = bot->decide(&snake);
+	}
+
+	move_snake(&snake);
+	tick++;
+
+	SDL_Delay(tick_ms);
+    }
+
+    u64 frames = term.frames, bytes = term.bytes;
+    term_free(&term);
+
+    printf("%s after %u ticks, score %u\n", snake.died ? "died" : "replay over", tick, snake.score);
+    printf("%llu frames, %.0f bytes per frame on average, %u at most\n", (unsigned long long) frames,
+	    frames ? (f64) bytes / frames : 0.0, max_frame);
+
+    free_snake(&snake);
+    if (replay_path)
+	replay_free(&replay);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "types.h"
+
+// little endian encoding shared by everything that talks over a socket or writes files other machines read
+
+
+static inline void put_u16(u8 *buf, u16 v) {
+    buf[0] = v;
+    buf[1] = v >> 8;
+}
+
+static inline void put_u32(u8 *buf, u32 v) {
+    buf[0] = v;
+    buf[1] = v >> 8;
+    buf[2] = v >> 16;
+    buf[3] = v >> 24;
+}
+
+static inline u16 get_u16(const u8 *buf) {
+    return buf[0] | buf[1] << 8;
+}
+
+static inline u32 get_u32(const u8 *buf) {
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | (u32) buf[3] << 24;
+}
+
+static inline void put_u64(u8 *buf, u64 v) {
+    put_u32(buf, v);
+    put_u32(buf + 4, v >> 32);
+}
+
+static inline u64 get_u64(const u8 *buf) {
+    return get_u32(buf) | (u64) get_u32(buf + 4) << 32;
+}